@@ -407,6 +407,51 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     return tb->tc.ptr;
 }
 
+/**
+ * helper_lookup_tb_ptr_ret: quick check for next tb after a return
+ * @env: current cpu state
+ *
+ * As for helper_lookup_tb_ptr, but first try the prediction at
+ * the top of the shadow return stack.  The prediction is only
+ * used if it matches the current cpu state exactly, so that a
+ * mismatched call/return pair only costs the regular lookup.
+ */
+const void *HELPER(lookup_tb_ptr_ret)(CPUArchState *env)
+{
+    CPUState *cpu = env_cpu(env);
+    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    unsigned i = jc->ret_top-- & TB_RET_STACK_MASK;
+    TranslationBlock *tb;
+
+    cpu->neg.can_do_io = true;
+
+    TCGTBCPUState s = cpu->cc->tcg_ops->get_tb_cpu_state(cpu);
+    s.cflags = curr_cflags(cpu);
+
+    if (check_for_breakpoints(cpu, s.pc, &s.cflags)) {
+        cpu_loop_exit(cpu);
+    }
+
+    tb = qatomic_read(&jc->ret_stack[i].tb);
+    qatomic_set(&jc->ret_stack[i].tb, NULL);
+    if (!(tb &&
+          jc->ret_stack[i].pc == s.pc &&
+          tb->cs_base == s.cs_base &&
+          tb->flags == s.flags &&
+          tb_cflags(tb) == s.cflags)) {
+        tb = tb_lookup(cpu, s);
+        if (tb == NULL) {
+            return tcg_code_gen_epilogue;
+        }
+    }
+
+    if (qemu_loglevel_mask(CPU_LOG_TB_CPU | CPU_LOG_EXEC)) {
+        log_cpu_exec(s.pc, cpu, tb);
+    }
+
+    return tb->tc.ptr;
+}
+
 /* Return the current PC from CPU, which may be cached in TB. */
 static vaddr log_pc(CPUState *cpu, const TranslationBlock *tb)
 {
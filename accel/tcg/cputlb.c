@@ -160,6 +160,9 @@ static void tb_jmp_cache_clear_page(CPUState *cpu, vaddr page_addr)
     for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
         qatomic_set(&jc->array[i0 + i].tb, NULL);
     }
+
+    /* The return stack is small; do not bother matching the page. */
+    tb_ret_stack_clear(jc);
 }
 
 /**
@@ -15,6 +15,10 @@
 #define TB_JMP_CACHE_BITS 12
 #define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
 
+#define TB_RET_STACK_BITS 4
+#define TB_RET_STACK_SIZE (1 << TB_RET_STACK_BITS)
+#define TB_RET_STACK_MASK (TB_RET_STACK_SIZE - 1)
+
 /*
  * Invalidated in parallel; all accesses to 'tb' must be atomic.
  * A valid entry is read/written by a single CPU, therefore there is
@@ -28,6 +32,26 @@ typedef struct CPUJumpCache {
         TranslationBlock *tb;
         vaddr pc;
     } array[TB_JMP_CACHE_SIZE];
+
+    /*
+     * Shadow return address stack, filled by translator_push_return_hint()
+     * and consumed by tcg_gen_lookup_and_goto_ptr_ret().  Only used as
+     * a prediction: an entry is accepted only if it matches the current
+     * cpu state exactly, as for the jump cache above.  The stack wraps
+     * around on overflow, dropping the oldest entry.
+     */
+    struct {
+        TranslationBlock *tb;
+        vaddr pc;
+    } ret_stack[TB_RET_STACK_SIZE];
+    unsigned ret_top;
 } CPUJumpCache;
 
+static inline void tb_ret_stack_clear(CPUJumpCache *jc)
+{
+    for (int i = 0; i < TB_RET_STACK_SIZE; i++) {
+        qatomic_set(&jc->ret_stack[i].tb, NULL);
+    }
+}
+
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
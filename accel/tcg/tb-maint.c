@@ -910,6 +910,11 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
             }
+            for (int i = 0; i < TB_RET_STACK_SIZE; i++) {
+                if (qatomic_read(&jc->ret_stack[i].tb) == tb) {
+                    qatomic_set(&jc->ret_stack[i].tb, NULL);
+                }
+            }
         }
     }
 }
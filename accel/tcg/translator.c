@@ -20,6 +20,7 @@
 #include "internal-common.h"
 #include "disas/disas.h"
 #include "tb-internal.h"
+#include "tb-hash.h"
 
 static void set_can_do_io(DisasContextBase *db, bool val)
 {
@@ -119,6 +120,139 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
     return translator_is_same_page(db, dest);
 }
 
+/* As tb_jmp_cache_hash_func(), for a pc known only at runtime. */
+static void gen_tb_jmp_cache_hash(TCGv_i64 ret, TCGv_i64 pc)
+{
+    TCGv_i64 t = tcg_temp_new_i64();
+
+#ifdef CONFIG_SOFTMMU
+    int shift = TARGET_PAGE_BITS - TB_JMP_PAGE_BITS;
+
+    tcg_gen_shri_i64(t, pc, shift);
+    tcg_gen_xor_i64(t, t, pc);
+    tcg_gen_shri_i64(ret, t, shift);
+    tcg_gen_andi_i64(ret, ret, TB_JMP_PAGE_MASK);
+    tcg_gen_andi_i64(t, t, TB_JMP_ADDR_MASK);
+    tcg_gen_or_i64(ret, ret, t);
+#else
+    tcg_gen_shri_i64(t, pc, TB_JMP_CACHE_BITS);
+    tcg_gen_xor_i64(t, t, pc);
+    tcg_gen_andi_i64(ret, t, TB_JMP_CACHE_SIZE - 1);
+#endif
+}
+
+void translator_push_return_hint(DisasContextBase *db, TCGv_i64 ret_addr)
+{
+    TCGv_ptr jc, entry, slot;
+    TCGv_i64 tb, pc;
+    TCGv_i32 top;
+
+    /* The entries are accessed as i64 below. */
+    QEMU_BUILD_BUG_ON(sizeof(vaddr) != sizeof(uint64_t));
+    QEMU_BUILD_BUG_ON(sizeof(TranslationBlock *) != sizeof(uint64_t));
+
+    if (tb_cflags(db->tb) & CF_NO_GOTO_PTR) {
+        return;
+    }
+
+    jc = tcg_temp_new_ptr();
+    tcg_gen_ld_ptr(jc, tcg_env,
+                   offsetof(CPUState, tb_jmp_cache) - sizeof(CPUState));
+
+    /* The TB cached for ret_addr in the jump cache, if any */
+    pc = tcg_temp_new_i64();
+    gen_tb_jmp_cache_hash(pc, ret_addr);
+    tcg_gen_muli_i64(pc, pc, sizeof_field(CPUJumpCache, array[0]));
+    entry = tcg_temp_new_ptr();
+    tcg_gen_trunc_i64_ptr(entry, pc);
+    tcg_gen_add_ptr(entry, entry, jc);
+
+    tb = tcg_temp_new_i64();
+    tcg_gen_ld_i64(tb, entry, offsetof(CPUJumpCache, array[0].tb));
+    tcg_gen_ld_i64(pc, entry, offsetof(CPUJumpCache, array[0].pc));
+    tcg_gen_movcond_i64(TCG_COND_NE, tb, pc, ret_addr,
+                        tcg_constant_i64(0), tb);
+
+    /* Push ret_addr and the TB, if it matched */
+    top = tcg_temp_new_i32();
+    tcg_gen_ld_i32(top, jc, offsetof(CPUJumpCache, ret_top));
+    tcg_gen_addi_i32(top, top, 1);
+    tcg_gen_st_i32(top, jc, offsetof(CPUJumpCache, ret_top));
+    tcg_gen_andi_i32(top, top, TB_RET_STACK_MASK);
+    tcg_gen_muli_i32(top, top, sizeof_field(CPUJumpCache, ret_stack[0]));
+    slot = tcg_temp_new_ptr();
+    tcg_gen_ext_i32_ptr(slot, top);
+    tcg_gen_add_ptr(slot, slot, jc);
+
+    tcg_gen_st_i64(ret_addr, slot, offsetof(CPUJumpCache, ret_stack[0].pc));
+    tcg_gen_st_i64(tb, slot, offsetof(CPUJumpCache, ret_stack[0].tb));
+}
+
+void translator_lookup_and_goto_ptr_ret(DisasContextBase *db, TCGv_i64 pc)
+{
+    const TranslationBlock *cur = db->tb;
+    uint32_t cflags = tb_cflags(cur);
+    TCGLabel *miss;
+    TCGv_ptr jc, slot, ptr;
+    TCGv_i64 tb, t;
+    TCGv_i32 top, t32;
+
+    /*
+     * Without a helper the cpu state is not read back, so the prediction
+     * is checked against this TB instead.  That needs the cflags of this
+     * TB to be those that curr_cflags() returns, which is not the case
+     * for one-off TBs and pages with breakpoints.
+     */
+    if (cflags & (CF_COUNT_MASK | CF_NO_GOTO_PTR | CF_SINGLE_STEP |
+                  CF_MEMI_ONLY | CF_NOIRQ | CF_BP_PAGE)) {
+        tcg_gen_lookup_and_goto_ptr_ret();
+        return;
+    }
+
+    jc = tcg_temp_new_ptr();
+    tcg_gen_ld_ptr(jc, tcg_env,
+                   offsetof(CPUState, tb_jmp_cache) - sizeof(CPUState));
+
+    /* Pop the prediction */
+    top = tcg_temp_new_i32();
+    t32 = tcg_temp_new_i32();
+    tcg_gen_ld_i32(top, jc, offsetof(CPUJumpCache, ret_top));
+    tcg_gen_subi_i32(t32, top, 1);
+    tcg_gen_st_i32(t32, jc, offsetof(CPUJumpCache, ret_top));
+    tcg_gen_andi_i32(top, top, TB_RET_STACK_MASK);
+    tcg_gen_muli_i32(top, top, sizeof_field(CPUJumpCache, ret_stack[0]));
+    slot = tcg_temp_new_ptr();
+    tcg_gen_ext_i32_ptr(slot, top);
+    tcg_gen_add_ptr(slot, slot, jc);
+
+    tb = tcg_temp_new_i64();
+    t = tcg_temp_new_i64();
+    tcg_gen_ld_i64(tb, slot, offsetof(CPUJumpCache, ret_stack[0].tb));
+    tcg_gen_ld_i64(t, slot, offsetof(CPUJumpCache, ret_stack[0].pc));
+    tcg_gen_st_i64(tcg_constant_i64(0), slot,
+                   offsetof(CPUJumpCache, ret_stack[0].tb));
+
+    /* Accept it only if it is what the lookup would have found */
+    miss = gen_new_label();
+    tcg_gen_brcondi_i64(TCG_COND_EQ, tb, 0, miss);
+    tcg_gen_brcond_i64(TCG_COND_NE, t, pc, miss);
+
+    ptr = tcg_temp_new_ptr();
+    tcg_gen_trunc_i64_ptr(ptr, tb);
+    tcg_gen_ld_i64(t, ptr, offsetof(TranslationBlock, cs_base));
+    tcg_gen_brcondi_i64(TCG_COND_NE, t, cur->cs_base, miss);
+    tcg_gen_ld_i32(t32, ptr, offsetof(TranslationBlock, flags));
+    tcg_gen_brcondi_i32(TCG_COND_NE, t32, cur->flags, miss);
+    tcg_gen_ld_i32(t32, ptr, offsetof(TranslationBlock, cflags));
+    tcg_gen_brcondi_i32(TCG_COND_NE, t32, cflags, miss);
+
+    tcg_gen_ld_ptr(ptr, ptr, offsetof(TranslationBlock, tc.ptr));
+    tcg_gen_goto_ptr(ptr);
+
+    gen_set_label(miss);
+    tcg_gen_lookup_and_goto_ptr();
+}
+
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
                      vaddr pc, void *host_pc, const TranslatorOps *ops,
                      DisasContextBase *db, TCGType addr_type)
@@ -24,6 +24,7 @@
 #include "tcg/tcg.h"
 #include "qemu/bitops.h"
 #include "qemu/rcu.h"
+#include "qemu/seqlock.h"
 #include "accel/tcg/cpu-ldst-common.h"
 #include "accel/tcg/cpu-loop.h"
 #include "accel/tcg/helper-retaddr.h"
@@ -168,6 +169,14 @@ typedef struct PageFlagsNode {
 
 static IntervalTreeRoot pageflags_root;
 
+/*
+ * All modifications of pageflags_root, including in-place updates of
+ * PageFlagsNode.flags, are made with mmap_lock held and bracketed by
+ * pageflags_seq.  This lets lockless readers detect that a lookup
+ * raced with an update, instead of taking mmap_lock to confirm it.
+ */
+static QemuSeqLock pageflags_seq;
+
 static PageFlagsNode *pageflags_find(vaddr start, vaddr last)
 {
     IntervalTreeNode *n;
@@ -240,26 +249,29 @@ void page_dump(FILE *f)
 int page_get_flags(vaddr address)
 {
     PageFlagsNode *p;
+    unsigned seq;
+    int flags;
 
     RCU_READ_LOCK_GUARD();
 
+    if (have_mmap_lock()) {
+        p = pageflags_find(address, address);
+        return p ? p->flags : 0;
+    }
+
     /*
      * See util/interval-tree.c re lockless lookups: no false positives but
-     * there are false negatives.  If we find nothing, retry with the mmap
-     * lock acquired.
+     * there are false negatives.  Those, and in-place updates of the flags,
+     * only happen while the tree is being modified, so retry until the
+     * lookup did not race with a writer.
      */
-    p = pageflags_find(address, address);
-    if (p) {
-        return p->flags;
-    }
-    if (have_mmap_lock()) {
-        return 0;
-    }
+    do {
+        seq = seqlock_read_begin(&pageflags_seq);
+        p = pageflags_find(address, address);
+        flags = p ? qatomic_read(&p->flags) : 0;
+    } while (seqlock_read_retry(&pageflags_seq, seq));
 
-    mmap_lock();
-    p = pageflags_find(address, address);
-    mmap_unlock();
-    return p ? p->flags : 0;
+    return flags;
 }
 
 /* A subroutine of page_set_flags: insert a new node for [start,last]. */
@@ -319,8 +331,8 @@ static void pageflags_create_merge(vaddr start, vaddr last, int flags)
 }
 
 /* A subroutine of page_set_flags: add flags to [start,last]. */
-static bool pageflags_set_clear(vaddr start, vaddr last,
-                                int set_flags, int clear_flags)
+static bool do_pageflags_set_clear(vaddr start, vaddr last,
+                                   int set_flags, int clear_flags)
 {
     PageFlagsNode *p;
     vaddr p_start, p_last;
@@ -459,6 +471,18 @@ static bool pageflags_set_clear(vaddr start, vaddr last,
     return inval_tb;
 }
 
+static bool pageflags_set_clear(vaddr start, vaddr last,
+                                int set_flags, int clear_flags)
+{
+    bool inval_tb;
+
+    assert_memory_lock();
+    seqlock_write_begin(&pageflags_seq);
+    inval_tb = do_pageflags_set_clear(start, last, set_flags, clear_flags);
+    seqlock_write_end(&pageflags_seq);
+    return inval_tb;
+}
+
 void page_set_flags(vaddr start, vaddr last, int set_flags, int clear_flags)
 {
     /*
@@ -497,6 +521,7 @@ bool page_check_range(vaddr start, vaddr len, int flags)
 {
     vaddr last;
     int locked;  /* tri-state: =0: unlocked, +1: global, -1: local */
+    unsigned seq;
     bool ret;
 
     if (len == 0) {
@@ -511,6 +536,7 @@ bool page_check_range(vaddr start, vaddr len, int flags)
     RCU_READ_LOCK_GUARD();
 
     locked = have_mmap_lock();
+    seq = seqlock_read_begin(&pageflags_seq);
     while (true) {
         PageFlagsNode *p = pageflags_find(start, last);
         int missing;
@@ -518,9 +544,14 @@ bool page_check_range(vaddr start, vaddr len, int flags)
         if (!p) {
             if (!locked) {
                 /*
-                 * Lockless lookups have false negatives.
-                 * Retry with the lock held.
+                 * Lockless lookups have false negatives, but only
+                 * while racing with a writer.  Otherwise the region
+                 * really is unmapped and there is no need to lock.
                  */
+                if (!seqlock_read_retry(&pageflags_seq, seq)) {
+                    ret = false;
+                    break;
+                }
                 mmap_lock();
                 locked = -1;
                 p = pageflags_find(start, last);
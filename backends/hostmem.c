@@ -23,7 +23,9 @@
 #include "qemu/mmap-alloc.h"
 #include "qemu/madvise.h"
 #include "qemu/cutils.h"
+#include "qemu/timer.h"
 #include "hw/core/qdev.h"
+#include "trace.h"
 
 #ifdef CONFIG_NUMA
 #include <numaif.h>
@@ -223,6 +225,105 @@ static void host_memory_backend_set_dump(Object *obj, bool value, Error **errp)
     backend->dump = value;
 }
 
+/* The host nodes @backend is bound to, as a list for node-affinity */
+static char *host_memory_backend_get_bound_nodes(HostMemoryBackend *backend)
+{
+    GString *nodes = g_string_new(NULL);
+    unsigned long node;
+
+    if (backend->policy == HOST_MEM_POLICY_DEFAULT) {
+        return g_string_free(nodes, false);
+    }
+
+    node = find_first_bit(backend->host_nodes, MAX_NODES);
+    while (node < MAX_NODES) {
+        g_string_append_printf(nodes, "%s%lu", nodes->len ? "," : "", node);
+        node = find_next_bit(backend->host_nodes, MAX_NODES, node + 1);
+    }
+    return g_string_free(nodes, false);
+}
+
+/*
+ * Without an explicit prealloc-context, create the preallocation threads
+ * from a temporary thread context bound to the CPUs of the host @nodes the
+ * memory is bound to, so that the pages are touched by node-local CPUs.
+ * The threads get the CPUs of @nodes instead of the affinity inherited
+ * from QEMU, e.g. through taskset.
+ * Returns NULL if the memory is not bound or the affinity can't be set,
+ * e.g. because the nodes have no CPUs or QEMU is not allowed to change
+ * its affinity.
+ */
+static Object *host_memory_backend_numa_context(const char *name,
+                                                const char *nodes)
+{
+#ifdef CONFIG_NUMA
+    Error *local_err = NULL;
+    Object *obj;
+
+    if (!*nodes) {
+        return NULL;
+    }
+
+    obj = object_new(TYPE_THREAD_CONTEXT);
+    if (!object_property_parse(obj, "node-affinity", nodes, &local_err) ||
+        !user_creatable_complete(USER_CREATABLE(obj), &local_err)) {
+        trace_host_memory_backend_numa_context_failed(name, nodes,
+                                            error_get_pretty(local_err));
+        error_free(local_err);
+        object_unref(obj);
+        return NULL;
+    }
+    trace_host_memory_backend_numa_context(name, nodes);
+    return obj;
+#else
+    return NULL;
+#endif
+}
+
+static bool host_memory_backend_do_prealloc(HostMemoryBackend *backend,
+                                            bool async, Error **errp)
+{
+    int fd = memory_region_get_fd(&backend->mr);
+    void *ptr = memory_region_get_ram_ptr(&backend->mr);
+    uint64_t sz = memory_region_size(&backend->mr);
+    ThreadContext *tc = backend->prealloc_context;
+    g_autofree char *name = host_memory_backend_get_name(backend);
+    g_autofree char *nodes = host_memory_backend_get_bound_nodes(backend);
+    Object *numa_tc = NULL;
+    int64_t start, ns;
+    bool ret;
+
+    /* Only bother when threads run in parallel or in the background */
+    if (!tc && (backend->prealloc_threads > 1 || async)) {
+        numa_tc = host_memory_backend_numa_context(name, nodes);
+        if (numa_tc) {
+            tc = THREAD_CONTEXT(numa_tc);
+        }
+    }
+
+    /*
+     * Asynchronous preallocation completes in qemu_finish_async_prealloc_mem(),
+     * whose qemu_prealloc_mem_done trace event can be matched by @ptr.
+     */
+    trace_host_memory_backend_prealloc(name, nodes, ptr, sz,
+                                       backend->prealloc_threads, async);
+    start = get_clock();
+    ret = qemu_prealloc_mem(fd, ptr, sz, backend->prealloc_threads, tc,
+                            async, errp);
+    if (ret && !async) {
+        ns = MAX(get_clock() - start, 1);
+        trace_host_memory_backend_prealloc_done(name, nodes, sz,
+                                                ns / SCALE_MS,
+                                                sz * 1000 / ns);
+    }
+
+    /* The threads have been created, so the context can go away */
+    if (numa_tc) {
+        object_unref(numa_tc);
+    }
+    return ret;
+}
+
 static bool host_memory_backend_get_prealloc(Object *obj, Error **errp)
 {
     HostMemoryBackend *backend = MEMORY_BACKEND(obj);
@@ -246,12 +347,7 @@ static void host_memory_backend_set_prealloc(Object *obj, bool value,
     }
 
     if (value && !backend->prealloc) {
-        int fd = memory_region_get_fd(&backend->mr);
-        void *ptr = memory_region_get_ram_ptr(&backend->mr);
-        uint64_t sz = memory_region_size(&backend->mr);
-
-        if (!qemu_prealloc_mem(fd, ptr, sz, backend->prealloc_threads,
-                               backend->prealloc_context, false, errp)) {
+        if (!host_memory_backend_do_prealloc(backend, false, errp)) {
             return;
         }
         backend->prealloc = true;
@@ -424,11 +520,8 @@ host_memory_backend_memory_complete(UserCreatable *uc, Error **errp)
      * This is necessary to guarantee memory is allocated with
      * specified NUMA policy in place.
      */
-    if (backend->prealloc && !qemu_prealloc_mem(memory_region_get_fd(&backend->mr),
-                                                ptr, sz,
-                                                backend->prealloc_threads,
-                                                backend->prealloc_context,
-                                                async, errp)) {
+    if (backend->prealloc &&
+        !host_memory_backend_do_prealloc(backend, async, errp)) {
         return;
     }
 }
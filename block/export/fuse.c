@@ -47,10 +47,22 @@
 #include <linux/fs.h>
 #endif
 
+#ifdef CONFIG_FUSE_IO_URING
+#include <liburing.h>
+#include <sys/sysinfo.h>
+#endif
+
 /* Prevent overly long bounce buffer allocations */
 #define FUSE_MAX_READ_BYTES (MIN(BDRV_REQUEST_MAX_BYTES, 1 * 1024 * 1024))
 #define FUSE_MAX_WRITE_BYTES (64 * 1024)
 
+/*
+ * Number of FUSE-over-io_uring entries registered for each of the kernel's
+ * (per-CPU) request queues.  Every entry holds a payload buffer of
+ * FUSE_MAX_WRITE_BYTES, so keep this small.
+ */
+#define FUSE_URING_QUEUE_DEPTH 4
+
 typedef struct FuseRequestInHeader {
     struct fuse_in_header common;
     /* All supported requests */
@@ -114,12 +126,45 @@ QEMU_BUILD_BUG_ON(sizeof(((FuseRequestInHeaderBuf *)0)->head) +
                   sizeof(FuseRequestInHeader));
 
 typedef struct FuseExport FuseExport;
+typedef struct FuseQueue FuseQueue;
+typedef struct FuseUringEnt FuseUringEnt;
+
+#ifdef CONFIG_FUSE_IO_URING
+/*
+ * The part of the request header after fuse_in_header must fit into the op_in
+ * area of FUSE-over-io_uring entries.
+ */
+QEMU_BUILD_BUG_ON(sizeof(FuseRequestInHeader) - sizeof(struct fuse_in_header) >
+                  FUSE_URING_OP_IN_OUT_SZ);
+
+/*
+ * One FUSE-over-io_uring ring entry, registered with the kernel for one of its
+ * per-CPU request queues.  The kernel places a request's headers in
+ * *req_header and its data (e.g. WRITE data) in *payload; the response is
+ * returned the same way when committing the entry, which also makes it
+ * available for the next request.  Thus, no data needs to be copied between
+ * the ring and the block layer.
+ */
+struct FuseUringEnt {
+    FuseQueue *q;
+
+    /* Index of the kernel queue (i.e. CPU) this entry belongs to */
+    uint16_t qid;
+
+    struct fuse_uring_req_header *req_header;
+    /* Allocated via blk_blockalign(), exp->uring_payload_size bytes */
+    void *payload;
+
+    /* Describes *req_header and *payload for FUSE_IO_URING_CMD_REGISTER */
+    struct iovec iov[2];
+};
+#endif
 
 /*
  * One FUSE "queue", representing one FUSE FD from which requests are fetched
  * and processed.  Each queue is tied to an AioContext.
  */
-typedef struct FuseQueue {
+struct FuseQueue {
     FuseExport *exp;
 
     AioContext *ctx;
@@ -140,7 +185,18 @@ typedef struct FuseQueue {
      * via blk_blockalign() and thus need to be freed via qemu_vfree().
      */
     void *req_write_data_cached;
-} FuseQueue;
+
+#ifdef CONFIG_FUSE_IO_URING
+    /*
+     * FUSE-over-io_uring ring and its entries, serving the kernel queues
+     * qid % exp->num_queues == (index of this queue).  Only used in ctx.
+     */
+    struct io_uring ring;
+    bool ring_set_up;
+    FuseUringEnt *uring_ents;
+    int num_uring_ents;
+#endif
+};
 
 struct FuseExport {
     BlockExport common;
@@ -172,6 +228,15 @@ struct FuseExport {
     /* Whether allow_other was used as a mount option or not */
     bool allow_other;
 
+#ifdef CONFIG_FUSE_IO_URING
+    /* Whether to offer FUSE_OVER_IO_URING to the kernel */
+    bool io_uring;
+    /* Number of kernel queues (one per CPU); 0 until FUSE_INIT enabled it */
+    int uring_nr_qids;
+    /* Size of all FuseUringEnt.payload buffers */
+    size_t uring_payload_size;
+#endif
+
     /* All atomic */
     mode_t st_mode;
     uid_t st_uid;
@@ -202,7 +267,11 @@ static bool is_regular_file(const char *path, Error **errp);
 static void read_from_fuse_fd(void *opaque);
 static void coroutine_fn
 fuse_co_process_request(FuseQueue *q, const FuseRequestInHeader *in_hdr,
-                        const void *data_buffer);
+                        const void *data_buffer, FuseUringEnt *ent);
+#ifdef CONFIG_FUSE_IO_URING
+static void fuse_uring_handle_cqes(void *opaque);
+static void fuse_uring_start(FuseExport *exp);
+#endif
 static int fuse_write_err(int fd, const struct fuse_in_header *in_hdr, int err);
 
 static void fuse_inc_in_flight(FuseExport *exp)
@@ -237,6 +306,14 @@ static void fuse_attach_handlers(FuseExport *exp)
         aio_set_fd_handler(exp->queues[i].ctx, exp->queues[i].fuse_fd,
                            read_from_fuse_fd, NULL, NULL, NULL,
                            &exp->queues[i]);
+#ifdef CONFIG_FUSE_IO_URING
+        if (exp->queues[i].ring_set_up) {
+            aio_set_fd_handler(exp->queues[i].ctx,
+                               exp->queues[i].ring.ring_fd,
+                               fuse_uring_handle_cqes, NULL, NULL, NULL,
+                               &exp->queues[i]);
+        }
+#endif
     }
     exp->fd_handler_set_up = true;
 }
@@ -249,6 +326,13 @@ static void fuse_detach_handlers(FuseExport *exp)
     for (int i = 0; i < exp->num_queues; i++) {
         aio_set_fd_handler(exp->queues[i].ctx, exp->queues[i].fuse_fd,
                            NULL, NULL, NULL, NULL, NULL);
+#ifdef CONFIG_FUSE_IO_URING
+        if (exp->queues[i].ring_set_up) {
+            aio_set_fd_handler(exp->queues[i].ctx,
+                               exp->queues[i].ring.ring_fd,
+                               NULL, NULL, NULL, NULL, NULL);
+        }
+#endif
     }
     exp->fd_handler_set_up = false;
 }
@@ -381,6 +465,9 @@ static int fuse_export_create(BlockExport *blk_exp,
     exp->mountpoint = g_strdup(args->mountpoint);
     exp->writable = blk_exp_args->writable;
     exp->growable = args->growable;
+#ifdef CONFIG_FUSE_IO_URING
+    exp->io_uring = !args->has_io_uring || args->io_uring;
+#endif
 
     /* set default */
     if (!args->has_allow_other) {
@@ -745,7 +832,7 @@ static void coroutine_fn co_read_from_fuse_fd(void *opaque)
         release_write_data_buffer(q, &data_buffer);
     }
 
-    fuse_co_process_request(q, in_hdr, data_buffer);
+    fuse_co_process_request(q, in_hdr, data_buffer, NULL);
 
 no_request:
     release_write_data_buffer(q, &data_buffer);
@@ -798,7 +885,6 @@ static void fuse_export_delete(BlockExport *blk_exp)
         }
         qemu_vfree(q->req_write_data_cached);
     }
-    g_free(exp->queues);
 
     if (exp->fuse_session) {
         if (exp->mounted) {
@@ -808,6 +894,27 @@ static void fuse_export_delete(BlockExport *blk_exp)
         fuse_session_destroy(exp->fuse_session);
     }
 
+#ifdef CONFIG_FUSE_IO_URING
+    /*
+     * Only now that the connection is gone can the kernel no longer access
+     * the ring entries' buffers.
+     */
+    for (int i = 0; i < exp->num_queues; i++) {
+        FuseQueue *q = &exp->queues[i];
+
+        if (!q->ring_set_up) {
+            continue;
+        }
+        io_uring_queue_exit(&q->ring);
+        for (int j = 0; j < q->num_uring_ents; j++) {
+            g_free(q->uring_ents[j].req_header);
+            qemu_vfree(q->uring_ents[j].payload);
+        }
+        g_free(q->uring_ents);
+    }
+#endif
+    g_free(exp->queues);
+
     g_free(exp->mountpoint);
 }
 
@@ -886,9 +993,20 @@ fuse_co_init(FuseExport *exp, struct fuse_init_out *out,
 
     if (!using_old_fuse_init_in(in)) {
         /* The flags2 flags must be shifted down by 32 bits. */
-        const uint32_t supported_flags2 = FUSE_DIRECT_IO_ALLOW_MMAP >> 32;
+        uint32_t supported_flags2 = FUSE_DIRECT_IO_ALLOW_MMAP >> 32;
         /* flags2 is only considered if FUSE_INIT_EXT is set. */
         supported_flags = supported_flags | FUSE_INIT_EXT;
+#ifdef CONFIG_FUSE_IO_URING
+        if (exp->io_uring && (in->flags2 & (FUSE_OVER_IO_URING >> 32))) {
+            supported_flags2 |= FUSE_OVER_IO_URING >> 32;
+            /*
+             * Ring entries' payload buffers are sized for max_write, so have
+             * the kernel apply our max_pages to reads, too, instead of its
+             * (possibly larger) default
+             */
+            supported_flags |= FUSE_MAX_PAGES;
+        }
+#endif
         flags2 = in->flags2 & supported_flags2;
     }
 
@@ -1100,10 +1218,13 @@ fuse_co_open(FuseExport *exp, struct fuse_open_out *out)
  * data from the block device into that buffer.
  * Returns the buffer (read) size on success, and -errno on error.
  * Note: If the returned size is 0, *bufptr will be set to NULL.
- * After use, *bufptr must be freed via qemu_vfree().
+ * If @dest is not NULL, the data is read into that buffer (which must hold at
+ * least @size bytes) instead of a newly allocated one.  Otherwise, after use,
+ * *bufptr must be freed via qemu_vfree().
  */
 static ssize_t coroutine_fn GRAPH_RDLOCK
-fuse_co_read(FuseExport *exp, void **bufptr, uint64_t offset, uint32_t size)
+fuse_co_read(FuseExport *exp, void **bufptr, uint64_t offset, uint32_t size,
+             void *dest)
 {
     int64_t blk_len;
     void *buf;
@@ -1133,14 +1254,16 @@ fuse_co_read(FuseExport *exp, void **bufptr, uint64_t offset, uint32_t size)
         size = blk_len - offset;
     }
 
-    buf = qemu_try_blockalign(blk_bs(exp->common.blk), size);
+    buf = dest ?: qemu_try_blockalign(blk_bs(exp->common.blk), size);
     if (!buf) {
         return -ENOMEM;
     }
 
     ret = blk_co_pread(exp->common.blk, offset, size, buf, 0);
     if (ret < 0) {
-        qemu_vfree(buf);
+        if (!dest) {
+            qemu_vfree(buf);
+        }
         return ret;
     }
 
@@ -1501,12 +1624,256 @@ static int fuse_write_buf_response(int fd,
     return 0;
 }
 
+#ifdef CONFIG_FUSE_IO_URING
+/**
+ * Prepare an SQE that passes @ent to the kernel with the given command.
+ * Does not submit it.
+ */
+static void fuse_uring_prep_cmd(FuseUringEnt *ent, uint32_t cmd_op,
+                                uint64_t commit_id)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&ent->q->ring);
+    struct fuse_uring_cmd_req *req;
+
+    /* The SQ has room for all entries */
+    assert(sqe);
+
+    /* IORING_SETUP_SQE128: The command area extends into the second half */
+    memset(sqe, 0, 2 * sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = ent->q->fuse_fd;
+    sqe->cmd_op = cmd_op;
+    if (cmd_op == FUSE_IO_URING_CMD_REGISTER) {
+        sqe->addr = (uintptr_t)ent->iov;
+        sqe->len = ARRAY_SIZE(ent->iov);
+    }
+
+    req = (struct fuse_uring_cmd_req *)sqe->cmd;
+    req->qid = ent->qid;
+    req->commit_id = commit_id;
+
+    io_uring_sqe_set_data(sqe, ent);
+}
+
+static void fuse_uring_submit(FuseQueue *q)
+{
+    int ret = io_uring_submit(&q->ring);
+
+    if (ret < 0) {
+        error_report("Failed to submit FUSE-over-io_uring commands: %s",
+                     strerror(-ret));
+    }
+}
+
+/**
+ * Return a response through a ring entry and make the entry available for the
+ * next request.
+ *
+ * The response is built like for fuse_write_response(), i.e. *out_hdr is
+ * followed by the request-specific response data, unless @out_data is given,
+ * which then must point to the entry's payload buffer.
+ */
+static void fuse_uring_send_response(FuseUringEnt *ent,
+                                     const FuseRequestOutHeader *out_hdr,
+                                     const void *out_data)
+{
+    struct fuse_uring_ent_in_out *ent_in_out =
+        &ent->req_header->ring_ent_in_out;
+    size_t payload_len = out_hdr->common.len - sizeof(out_hdr->common);
+
+    memcpy(ent->req_header->in_out, &out_hdr->common,
+           sizeof(out_hdr->common));
+    if (out_data) {
+        assert(out_data == ent->payload);
+    } else {
+        memcpy(ent->payload, (const char *)out_hdr + sizeof(out_hdr->common),
+               payload_len);
+    }
+    ent_in_out->payload_sz = payload_len;
+
+    fuse_uring_prep_cmd(ent, FUSE_IO_URING_CMD_COMMIT_AND_FETCH,
+                        ent_in_out->commit_id);
+    fuse_uring_submit(ent->q);
+}
+
+/**
+ * Process the request the kernel has placed in a ring entry.
+ * Takes a FuseUringEnt pointer in `opaque`.
+ *
+ * Assumes the export's in-flight counter has already been incremented.
+ */
+static void coroutine_fn co_process_uring_ent(void *opaque)
+{
+    FuseUringEnt *ent = opaque;
+    FuseExport *exp = ent->q->exp;
+    struct fuse_uring_req_header *req_header = ent->req_header;
+    uint32_t payload_len = req_header->ring_ent_in_out.payload_sz;
+    FuseRequestInHeader in_hdr;
+    ssize_t op_hdr_len;
+
+    memcpy(&in_hdr.common, req_header->in_out, sizeof(in_hdr.common));
+
+    op_hdr_len = req_op_hdr_len(&in_hdr);
+    if (op_hdr_len < 0 || payload_len > FUSE_MAX_WRITE_BYTES) {
+        FuseRequestOutHeader out_hdr = {
+            .common = {
+                .len = sizeof(out_hdr.common),
+                .error = op_hdr_len < 0 ? op_hdr_len : -EINVAL,
+                .unique = in_hdr.common.unique,
+            },
+        };
+
+        fuse_uring_send_response(ent, &out_hdr, NULL);
+        goto out;
+    }
+    memcpy((char *)&in_hdr + sizeof(in_hdr.common), req_header->op_in,
+           op_hdr_len);
+
+    /*
+     * Describe the request as if it had been read from the FUSE FD, so that
+     * fuse_co_process_request() can validate it the same way
+     */
+    in_hdr.common.len = sizeof(in_hdr.common) + op_hdr_len + payload_len;
+
+    fuse_co_process_request(ent->q, &in_hdr, ent->payload, ent);
+
+out:
+    fuse_dec_in_flight(exp);
+}
+
+/**
+ * Process all available completions on a queue's ring.
+ * (To be used as a handler for when the ring FD becomes readable.)
+ * Takes a FuseQueue pointer in `opaque`.
+ */
+static void fuse_uring_handle_cqes(void *opaque)
+{
+    FuseQueue *q = opaque;
+    struct io_uring_cqe *cqe;
+
+    while (io_uring_peek_cqe(&q->ring, &cqe) == 0) {
+        FuseUringEnt *ent = io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        Coroutine *co;
+
+        io_uring_cqe_seen(&q->ring, cqe);
+
+        if (unlikely(res < 0)) {
+            /* The entry is gone; ENOTCONN and ECANCELED mean unmounting */
+            if (res != -ENOTCONN && res != -ECANCELED) {
+                error_report("FUSE-over-io_uring command failed: %s",
+                             strerror(-res));
+            }
+            continue;
+        }
+
+        if (unlikely(qatomic_read(&q->exp->halted))) {
+            continue;
+        }
+
+        co = qemu_coroutine_create(co_process_uring_ent, ent);
+        /* Decremented by co_process_uring_ent() */
+        fuse_inc_in_flight(q->exp);
+        qemu_coroutine_enter(co);
+    }
+}
+
+/**
+ * Set up a queue's ring and register its entries with the kernel.  Runs in
+ * the queue's AioContext.
+ * Takes a FuseQueue pointer in `opaque`.
+ *
+ * The kernel only starts using FUSE-over-io_uring once entries have been
+ * registered for all of its queues; until then (or forever, if this fails for
+ * some queue), requests continue to be read from the FUSE FD.
+ */
+static void fuse_uring_setup_queue_bh(void *opaque)
+{
+    FuseQueue *q = opaque;
+    FuseExport *exp = q->exp;
+    int index = q - exp->queues;
+    int num_ents = 0;
+    int ret;
+
+    for (int qid = index; qid < exp->uring_nr_qids; qid += exp->num_queues) {
+        num_ents += FUSE_URING_QUEUE_DEPTH;
+    }
+    if (num_ents == 0 || qatomic_read(&exp->halted)) {
+        goto out;
+    }
+
+    ret = io_uring_queue_init(num_ents, &q->ring, IORING_SETUP_SQE128);
+    if (ret < 0) {
+        error_report("Failed to set up FUSE-over-io_uring (%s), falling back "
+                     "to reading requests from the FUSE FD", strerror(-ret));
+        goto out;
+    }
+
+    q->uring_ents = g_new0(FuseUringEnt, num_ents);
+    q->num_uring_ents = num_ents;
+    for (int i = 0; i < num_ents; i++) {
+        FuseUringEnt *ent = &q->uring_ents[i];
+
+        *ent = (FuseUringEnt) {
+            .q = q,
+            .qid = index + (i / FUSE_URING_QUEUE_DEPTH) * exp->num_queues,
+            .req_header = g_new0(struct fuse_uring_req_header, 1),
+            .payload = blk_blockalign(exp->common.blk,
+                                      exp->uring_payload_size),
+        };
+        ent->iov[0] = (struct iovec) {
+            ent->req_header, sizeof(*ent->req_header)
+        };
+        ent->iov[1] = (struct iovec) { ent->payload, exp->uring_payload_size };
+
+        fuse_uring_prep_cmd(ent, FUSE_IO_URING_CMD_REGISTER, 0);
+    }
+    q->ring_set_up = true;
+
+    if (exp->fd_handler_set_up) {
+        aio_set_fd_handler(q->ctx, q->ring.ring_fd, fuse_uring_handle_cqes,
+                           NULL, NULL, NULL, q);
+    }
+    fuse_uring_submit(q);
+
+out:
+    fuse_dec_in_flight(exp);
+}
+
+/**
+ * Called once the kernel has accepted FUSE_OVER_IO_URING in FUSE_INIT: Set up
+ * the rings of all queues in their respective AioContexts.
+ */
+static void fuse_uring_start(FuseExport *exp)
+{
+    if (exp->uring_nr_qids) {
+        return;
+    }
+
+    /* Like libfuse, assume that the kernel has one queue per configured CPU */
+    exp->uring_nr_qids = get_nprocs_conf();
+    /* The kernel requires at least max_pages (see fuse_co_init()) pages */
+    exp->uring_payload_size = ROUND_UP(FUSE_MAX_WRITE_BYTES,
+                                       qemu_real_host_page_size());
+
+    for (int i = 0; i < exp->num_queues; i++) {
+        /* Decremented by fuse_uring_setup_queue_bh() */
+        fuse_inc_in_flight(exp);
+        aio_bh_schedule_oneshot(exp->queues[i].ctx, fuse_uring_setup_queue_bh,
+                                &exp->queues[i]);
+    }
+}
+#endif /* CONFIG_FUSE_IO_URING */
+
 /**
  * Process a FUSE request, incl. writing the response.
+ *
+ * If @ent is not NULL, the request was received through that
+ * FUSE-over-io_uring entry, and the response is returned through it, too.
  */
 static void coroutine_fn
 fuse_co_process_request(FuseQueue *q, const FuseRequestInHeader *in_hdr,
-                        const void *data_buffer)
+                        const void *data_buffer, FuseUringEnt *ent)
 {
     FuseRequestOutHeader out_hdr;
     FuseExport *exp = q->exp;
@@ -1543,7 +1910,11 @@ fuse_co_process_request(FuseQueue *q, const FuseRequestInHeader *in_hdr,
 
     case FUSE_FORGET:
     case FUSE_BATCH_FORGET:
-        /* These have no response, and there is nothing we need to do */
+        /*
+         * These have no response, and there is nothing we need to do.  (The
+         * kernel only sends them through the FUSE FD, so we never need to
+         * return a ring entry here.)
+         */
         return;
 
     case FUSE_GETATTR:
@@ -1559,7 +1930,19 @@ fuse_co_process_request(FuseQueue *q, const FuseRequestInHeader *in_hdr,
 
     case FUSE_READ: {
         const struct fuse_read_in *in = &in_hdr->read;
-        ret = fuse_co_read(exp, &out_data_buffer, in->offset, in->size);
+        void *dest = NULL;
+
+#ifdef CONFIG_FUSE_IO_URING
+        if (ent) {
+            /* Read directly into the payload buffer */
+            if (in->size > exp->uring_payload_size) {
+                ret = -EINVAL;
+                break;
+            }
+            dest = ent->payload;
+        }
+#endif
+        ret = fuse_co_read(exp, &out_data_buffer, in->offset, in->size, dest);
         break;
     }
 
@@ -1579,7 +1962,9 @@ fuse_co_process_request(FuseQueue *q, const FuseRequestInHeader *in_hdr,
         /*
          * co_read_from_fuse_fd() has checked that in_hdr->len matches the
          * number of bytes read, which cannot exceed the max_write value we set
-         * (FUSE_MAX_WRITE_BYTES).  So we know that FUSE_MAX_WRITE_BYTES >=
+         * (FUSE_MAX_WRITE_BYTES).  (co_process_uring_ent() has set
+         * in_hdr->len accordingly after checking the payload length against
+         * the same limit.)  So we know that FUSE_MAX_WRITE_BYTES >=
          * in_hdr->len >= in->size + X, so this assertion must hold.
          */
         assert(in->size <= FUSE_MAX_WRITE_BYTES);
@@ -1632,12 +2017,27 @@ fuse_co_process_request(FuseQueue *q, const FuseRequestInHeader *in_hdr,
         };
     }
 
+#ifdef CONFIG_FUSE_IO_URING
+    if (ent) {
+        fuse_uring_send_response(ent, &out_hdr, out_data_buffer);
+        return;
+    }
+#endif
+
     if (out_data_buffer) {
         fuse_write_buf_response(q->fuse_fd, &out_hdr.common, out_data_buffer);
         qemu_vfree(out_data_buffer);
     } else {
         fuse_write_response(q->fuse_fd, &out_hdr);
     }
+
+#ifdef CONFIG_FUSE_IO_URING
+    if (in_hdr->common.opcode == FUSE_INIT && ret >= 0 &&
+        (out_hdr.init.flags2 & (FUSE_OVER_IO_URING >> 32))) {
+        /* The kernel accepts ring entries once it has processed the reply */
+        fuse_uring_start(exp);
+    }
+#endif
 }
 
 const BlockExportDriver blk_exp_fuse = {
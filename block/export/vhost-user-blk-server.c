@@ -337,18 +337,15 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
 
     if (vu_opts->has_num_queues) {
         num_queues = vu_opts->num_queues;
+    } else if (multithread) {
+        /* One virtqueue per IOThread */
+        num_queues = MIN(mt_count, UINT16_MAX);
     }
     if (num_queues == 0) {
         error_setg(errp, "num-queues must be greater than 0");
         return -EINVAL;
     }
 
-    if (multithread) {
-        error_setg(errp,
-                   "vhost-user-blk export does not support multi-threading");
-        return -EINVAL;
-    }
-
     vexp->handler.blk = exp->blk;
     vexp->handler.serial = g_strdup("vhost_user_blk");
     vexp->handler.logical_block_size = logical_block_size;
@@ -370,6 +367,11 @@ static int vu_blk_exp_create(BlockExport *exp, BlockExportOptions *opts,
         return -EADDRNOTAVAIL;
     }
 
+    if (multithread) {
+        vhost_user_server_set_queue_ctxs(&vexp->vu_server, multithread,
+                                         mt_count);
+    }
+
     return 0;
 }
 
@@ -81,6 +81,7 @@ this code that are retained.
 
 #include "qemu/osdep.h"
 #include <math.h>
+#include <float.h>
 #include "qemu/bitops.h"
 #include "fpu/softfloat.h"
 #include "fpu/softfloat-parts.h"
@@ -237,6 +238,24 @@ static inline bool can_use_fpu(const float_status *s)
                   get_float_rounding_mode(s) == float_round_nearest_even);
 }
 
+/*
+ * Hardfloat for floatx80 requires a host long double with the same format,
+ * i.e. x86, with the x87 precision control left at its default of 64 bits.
+ * This is not the case on Windows, where the default is 53 bits.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32) && \
+    LDBL_MANT_DIG == 64 && !QEMU_NO_HARDFLOAT
+# define QEMU_HARDFLOAT_FX80 1
+#else
+# define QEMU_HARDFLOAT_FX80 0
+#endif
+
+static inline bool can_use_fpu_fx80(const float_status *s)
+{
+    return QEMU_HARDFLOAT_FX80 && can_use_fpu(s) &&
+           get_floatx80_rounding_precision(s) == floatx80_precision_x;
+}
+
 /*
  * Hardfloat generation functions. Each operation can have two flavors:
  * either using softfloat primitives (e.g. float32_is_zero_or_normal) for
@@ -259,13 +278,21 @@ typedef union {
     double h;
 } union_float64;
 
+typedef union {
+    floatx80 s;
+    long double h;
+} union_floatx80;
+
 typedef bool (*f32_check_fn)(union_float32 a, union_float32 b);
 typedef bool (*f64_check_fn)(union_float64 a, union_float64 b);
+typedef bool (*fx80_check_fn)(union_floatx80 a, union_floatx80 b);
 
 typedef float32 (*soft_f32_op2_fn)(float32 a, float32 b, float_status *s);
 typedef float64 (*soft_f64_op2_fn)(float64 a, float64 b, float_status *s);
+typedef floatx80 (*soft_fx80_op2_fn)(floatx80 a, floatx80 b, float_status *s);
 typedef float   (*hard_f32_op2_fn)(float a, float b);
 typedef double  (*hard_f64_op2_fn)(double a, double b);
+typedef long double (*hard_fx80_op2_fn)(long double a, long double b);
 
 /* 2-input is-zero-or-normal */
 static inline bool f32_is_zon2(union_float32 a, union_float32 b)
@@ -397,6 +424,58 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * Unlike for float32/64, pseudo-denormals and unnormals must not reach
+ * the host FPU, so check the explicit integer bit as well.
+ */
+static inline bool fx80_is_zon(union_floatx80 a)
+{
+    int exp = a.s.high & 0x7fff;
+
+    if (exp == 0) {
+        return a.s.low == 0;
+    }
+    return exp != 0x7fff && (a.s.low >> 63);
+}
+
+static inline bool fx80_is_zon2(union_floatx80 a, union_floatx80 b)
+{
+    return fx80_is_zon(a) && fx80_is_zon(b);
+}
+
+static inline floatx80
+floatx80_gen2(floatx80 xa, floatx80 xb, float_status *s,
+              hard_fx80_op2_fn hard, soft_fx80_op2_fn soft,
+              fx80_check_fn pre, fx80_check_fn post)
+{
+    union_floatx80 ua, ub, ur;
+
+    ua.s = xa;
+    ub.s = xb;
+
+    if (unlikely(!can_use_fpu_fx80(s))) {
+        goto soft;
+    }
+    if (unlikely(!pre(ua, ub))) {
+        goto soft;
+    }
+
+    ur.h = hard(ua.h, ub.h);
+    /*
+     * The encoding of the default infinity is target-specific,
+     * so let softfloat handle overflow as well as underflow.
+     */
+    if (unlikely(isinf(ur.h))) {
+        goto soft;
+    } else if (unlikely(fabsl(ur.h) <= LDBL_MIN) && post(ua, ub)) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft(xa, xb, s);
+}
+
 /* Simple helpers for checking if, or what kind of, NaN we have */
 static inline __attribute__((unused)) bool is_nan(FloatClass c)
 {
@@ -1802,16 +1881,45 @@ floatx80_addsub(floatx80 a, floatx80 b, float_status *status, bool subtract)
     return floatx80_round_pack_canonical(&pa, status);
 }
 
-floatx80 floatx80_add(floatx80 a, floatx80 b, float_status *status)
+static floatx80 soft_fx80_add(floatx80 a, floatx80 b, float_status *status)
 {
     return floatx80_addsub(a, b, status, false);
 }
 
-floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
+static floatx80 soft_fx80_sub(floatx80 a, floatx80 b, float_status *status)
 {
     return floatx80_addsub(a, b, status, true);
 }
 
+static long double hard_fx80_add(long double a, long double b)
+{
+    return a + b;
+}
+
+static long double hard_fx80_sub(long double a, long double b)
+{
+    return a - b;
+}
+
+static bool fx80_addsubmul_post(union_floatx80 a, union_floatx80 b)
+{
+    return !(floatx80_is_zero(a.s) && floatx80_is_zero(b.s));
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_add(floatx80 a, floatx80 b, float_status *status)
+{
+    return floatx80_gen2(a, b, status, hard_fx80_add, soft_fx80_add,
+                         fx80_is_zon2, fx80_addsubmul_post);
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_sub(floatx80 a, floatx80 b, float_status *status)
+{
+    return floatx80_gen2(a, b, status, hard_fx80_sub, soft_fx80_sub,
+                         fx80_is_zon2, fx80_addsubmul_post);
+}
+
 /*
  * Multiplication
  */
@@ -1898,8 +2006,8 @@ float128_mul(float128 a, float128 b, float_status *status)
     return float128_round_pack_canonical(&pr, status);
 }
 
-floatx80 QEMU_FLATTEN
-floatx80_mul(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_fx80_mul(floatx80 a, floatx80 b, float_status *status)
 {
     FloatParts128 pa, pb;
 
@@ -1912,6 +2020,18 @@ floatx80_mul(floatx80 a, floatx80 b, float_status *status)
     return floatx80_round_pack_canonical(&pa, status);
 }
 
+static long double hard_fx80_mul(long double a, long double b)
+{
+    return a * b;
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_mul(floatx80 a, floatx80 b, float_status *status)
+{
+    return floatx80_gen2(a, b, status, hard_fx80_mul, soft_fx80_mul,
+                         fx80_is_zon2, fx80_addsubmul_post);
+}
+
 /*
  * Fused multiply-add
  */
@@ -2293,7 +2413,8 @@ float128_div(float128 a, float128 b, float_status *status)
     return float128_round_pack_canonical(&pr, status);
 }
 
-floatx80 floatx80_div(floatx80 a, floatx80 b, float_status *status)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_fx80_div(floatx80 a, floatx80 b, float_status *status)
 {
     FloatParts128 pa, pb;
 
@@ -2306,6 +2427,28 @@ floatx80 floatx80_div(floatx80 a, floatx80 b, float_status *status)
     return floatx80_round_pack_canonical(&pa, status);
 }
 
+static long double hard_fx80_div(long double a, long double b)
+{
+    return a / b;
+}
+
+static bool fx80_div_pre(union_floatx80 a, union_floatx80 b)
+{
+    return fx80_is_zon(a) && fx80_is_zon(b) && !floatx80_is_zero(b.s);
+}
+
+static bool fx80_div_post(union_floatx80 a, union_floatx80 b)
+{
+    return !floatx80_is_zero(a.s);
+}
+
+floatx80 QEMU_FLATTEN
+floatx80_div(floatx80 a, floatx80 b, float_status *status)
+{
+    return floatx80_gen2(a, b, status, hard_fx80_div, soft_fx80_div,
+                         fx80_div_pre, fx80_div_post);
+}
+
 /*
  * Remainder
  */
@@ -4458,7 +4601,8 @@ float128 QEMU_FLATTEN float128_sqrt(float128 a, float_status *status)
     return float128_round_pack_canonical(&p, status);
 }
 
-floatx80 floatx80_sqrt(floatx80 a, float_status *s)
+static floatx80 QEMU_SOFTFLOAT_ATTR
+soft_fx80_sqrt(floatx80 a, float_status *s)
 {
     FloatParts128 p;
 
@@ -4469,6 +4613,24 @@ floatx80 floatx80_sqrt(floatx80 a, float_status *s)
     return floatx80_round_pack_canonical(&p, s);
 }
 
+floatx80 QEMU_FLATTEN floatx80_sqrt(floatx80 xa, float_status *s)
+{
+    union_floatx80 ua, ur;
+
+    ua.s = xa;
+    if (unlikely(!can_use_fpu_fx80(s))) {
+        goto soft;
+    }
+    if (unlikely(!fx80_is_zon(ua) || floatx80_is_neg(ua.s))) {
+        goto soft;
+    }
+    ur.h = sqrtl(ua.h);
+    return ur.s;
+
+ soft:
+    return soft_fx80_sqrt(ua.s, s);
+}
+
 /*
  * log2
  */
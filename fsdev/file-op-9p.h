@@ -103,6 +103,7 @@ typedef struct FsDriverEntry {
     mode_t dmode;
     /* temporary storage for parse_opts only */
     uint32_t max_xattr;
+    uint32_t cache_timeout;
 } FsDriverEntry;
 
 struct FsContext {
@@ -182,6 +183,19 @@ struct FileOperations {
                     V9fsPath *newdir, const char *new_name);
     int (*unlinkat)(FsContext *ctx, V9fsPath *dir, const char *name, int flags);
     bool (*has_valid_file_handle)(int fid_type, V9fsFidOpenState *fs);
+
+    /*
+     * Optional coroutine variants, called directly from the 9p request
+     * coroutine instead of on a worker thread. They return a negative errno
+     * on failure; -ENOTSUP means the request could not be submitted this way
+     * and the synchronous callback above is used instead.
+     */
+    int coroutine_fn (*co_lstat)(FsContext *, V9fsPath *, struct stat *);
+    ssize_t coroutine_fn (*co_preadv)(FsContext *, V9fsFidOpenState *,
+                                      const struct iovec *, int, off_t);
+    ssize_t coroutine_fn (*co_pwritev)(FsContext *, V9fsFidOpenState *,
+                                       const struct iovec *, int, off_t);
+    int coroutine_fn (*co_fsync)(FsContext *, int, V9fsFidOpenState *, int);
 };
 
 #endif
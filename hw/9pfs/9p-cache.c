@@ -0,0 +1,222 @@
+/*
+ * 9p metadata and directory entry cache
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Not so fast! You might want to read the 9p developer docs first:
+ * https://wiki.qemu.org/Documentation/9p
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "9p.h"
+#include "9p-util.h"
+#include "trace.h"
+
+/*
+ * Upper bounds for the amount of cached entries; once reached the respective
+ * table is simply emptied, which is good enough for a cache whose entries
+ * expire after a short time anyway.
+ */
+#define V9FS_CACHE_MAX_STATS    16384
+#define V9FS_CACHE_MAX_DIRENTS  1024
+
+typedef struct V9fsCacheStat {
+    int64_t expire;
+    struct stat st;
+} V9fsCacheStat;
+
+/* Both key and value of the dirents table */
+typedef struct V9fsCacheDirents {
+    char *path;
+    off_t offset;
+    int32_t maxsize;
+    bool dostat;
+    int64_t expire;
+    int32_t size;
+    V9fsDirEnt *entries;
+} V9fsCacheDirents;
+
+static guint v9fs_cache_dirents_hash(gconstpointer key)
+{
+    const V9fsCacheDirents *d = key;
+
+    return g_str_hash(d->path) ^ (guint)d->offset ^
+           (guint)((uint64_t)d->offset >> 32) ^ d->maxsize ^ d->dostat;
+}
+
+static gboolean v9fs_cache_dirents_equal(gconstpointer a, gconstpointer b)
+{
+    const V9fsCacheDirents *da = a, *db = b;
+
+    return da->offset == db->offset && da->maxsize == db->maxsize &&
+           da->dostat == db->dostat && !strcmp(da->path, db->path);
+}
+
+static void v9fs_cache_dirents_free(gpointer data)
+{
+    V9fsCacheDirents *d = data;
+
+    v9fs_free_dirents(d->entries);
+    g_free(d->path);
+    g_free(d);
+}
+
+static V9fsDirEnt *v9fs_cache_dirents_dup(V9fsDirEnt *e)
+{
+    V9fsDirEnt *head = NULL, **tail = &head;
+
+    for (; e; e = e->next) {
+        V9fsDirEnt *copy = g_new0(V9fsDirEnt, 1);
+
+        copy->dent = qemu_dirent_dup(e->dent);
+        if (e->st) {
+            copy->st = g_memdup2(e->st, sizeof(*e->st));
+        }
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return head;
+}
+
+static int64_t v9fs_cache_now(void)
+{
+    return qemu_clock_get_ms(QEMU_CLOCK_REALTIME);
+}
+
+void v9fs_cache_init(V9fsCache *cache, uint32_t timeout)
+{
+    cache->timeout = timeout;
+    cache->generation = 0;
+    if (!timeout) {
+        return;
+    }
+    cache->stats = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                         g_free, g_free);
+    cache->dirents = g_hash_table_new_full(v9fs_cache_dirents_hash,
+                                           v9fs_cache_dirents_equal,
+                                           v9fs_cache_dirents_free, NULL);
+}
+
+void v9fs_cache_cleanup(V9fsCache *cache)
+{
+    if (cache->stats) {
+        g_hash_table_destroy(cache->stats);
+        cache->stats = NULL;
+    }
+    if (cache->dirents) {
+        g_hash_table_destroy(cache->dirents);
+        cache->dirents = NULL;
+    }
+    cache->timeout = 0;
+}
+
+/*
+ * Drop all cached entries. Must be called whenever the export may have been
+ * modified; results of requests that were in flight at that point are not
+ * inserted afterwards.
+ */
+void v9fs_cache_flush(V9fsCache *cache)
+{
+    if (!v9fs_cache_enabled(cache)) {
+        return;
+    }
+    cache->generation++;
+    g_hash_table_remove_all(cache->stats);
+    g_hash_table_remove_all(cache->dirents);
+    trace_v9fs_cache_flush(cache->generation);
+}
+
+bool v9fs_cache_get_stat(V9fsCache *cache, V9fsPath *path,
+                         struct stat *stbuf)
+{
+    V9fsCacheStat *entry;
+
+    if (!v9fs_cache_enabled(cache)) {
+        return false;
+    }
+    entry = g_hash_table_lookup(cache->stats, path->data);
+    if (!entry) {
+        return false;
+    }
+    if (entry->expire <= v9fs_cache_now()) {
+        g_hash_table_remove(cache->stats, path->data);
+        return false;
+    }
+    *stbuf = entry->st;
+    return true;
+}
+
+void v9fs_cache_put_stat(V9fsCache *cache, uint64_t generation,
+                         V9fsPath *path, const struct stat *stbuf)
+{
+    V9fsCacheStat *entry;
+
+    if (!v9fs_cache_enabled(cache) || generation != cache->generation) {
+        return;
+    }
+    if (g_hash_table_size(cache->stats) >= V9FS_CACHE_MAX_STATS) {
+        g_hash_table_remove_all(cache->stats);
+    }
+    entry = g_new(V9fsCacheStat, 1);
+    entry->expire = v9fs_cache_now() + cache->timeout;
+    entry->st = *stbuf;
+    g_hash_table_replace(cache->stats, g_strdup(path->data), entry);
+}
+
+/*
+ * Returns the cached response size and a private copy of the cached entries
+ * in @entries (to be freed with v9fs_free_dirents()), or -1 on a miss.
+ */
+int32_t v9fs_cache_get_dirents(V9fsCache *cache, V9fsPath *path,
+                               off_t offset, int32_t maxsize, bool dostat,
+                               struct V9fsDirEnt **entries)
+{
+    V9fsCacheDirents key = {
+        .path = path->data,
+        .offset = offset,
+        .maxsize = maxsize,
+        .dostat = dostat,
+    };
+    V9fsCacheDirents *d;
+
+    if (!v9fs_cache_enabled(cache)) {
+        return -1;
+    }
+    d = g_hash_table_lookup(cache->dirents, &key);
+    if (!d) {
+        return -1;
+    }
+    if (d->expire <= v9fs_cache_now()) {
+        g_hash_table_remove(cache->dirents, d);
+        return -1;
+    }
+    *entries = v9fs_cache_dirents_dup(d->entries);
+    return d->size;
+}
+
+void v9fs_cache_put_dirents(V9fsCache *cache, uint64_t generation,
+                            V9fsPath *path, off_t offset, int32_t maxsize,
+                            bool dostat, int32_t size,
+                            struct V9fsDirEnt *entries)
+{
+    V9fsCacheDirents *d;
+
+    if (!v9fs_cache_enabled(cache) || generation != cache->generation) {
+        return;
+    }
+    if (g_hash_table_size(cache->dirents) >= V9FS_CACHE_MAX_DIRENTS) {
+        g_hash_table_remove_all(cache->dirents);
+    }
+    d = g_new0(V9fsCacheDirents, 1);
+    d->path = g_strdup(path->data);
+    d->offset = offset;
+    d->maxsize = maxsize;
+    d->dostat = dostat;
+    d->expire = v9fs_cache_now() + cache->timeout;
+    d->size = size;
+    d->entries = v9fs_cache_dirents_dup(entries);
+    g_hash_table_replace(cache->dirents, d, d);
+}
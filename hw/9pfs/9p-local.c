@@ -20,6 +20,7 @@
 #include "9p-local.h"
 #include "9p-xattr.h"
 #include "9p-util.h"
+#include "coth.h"
 #include "fsdev/qemu-fsdev.h"   /* local_ops */
 #include <arpa/inet.h>
 #include <pwd.h>
@@ -35,6 +36,9 @@
 #include <libgen.h>
 #ifdef CONFIG_LINUX
 #include <linux/fs.h>
+#ifdef HAVE_IO_URING_PREP_OPENAT2
+#include <linux/openat2.h>
+#endif
 #ifdef CONFIG_LINUX_MAGIC_H
 #include <linux/magic.h>
 #endif
@@ -1539,6 +1543,14 @@ static int local_parse_opts(QemuOpts *opts, FsDriverEntry *fse, Error **errp)
     }
     fse->max_xattr = val;
 
+    val = qemu_opt_get_number(opts, "cache_timeout", 0);
+    if (val > UINT32_MAX) {
+        error_setg(errp, "cache_timeout value '%s' too large",
+                   qemu_opt_get(opts, "cache_timeout"));
+        return -1;
+    }
+    fse->cache_timeout = val;
+
     if (!sec_model) {
         error_setg(errp, "security_model property not set");
         error_append_security_model_hint(errp);
@@ -1621,6 +1633,212 @@ static bool local_has_valid_file_handle(int fid_type, V9fsFidOpenState *fs)
         (fid_type == P9_FID_DIR && fs->dir.stream != NULL);
 }
 
+#ifdef CONFIG_LINUX_IO_URING
+/*
+ * Requests below are submitted through the io_uring of the AioContext the 9p
+ * request coroutine runs in, which saves the round trip to a worker thread
+ * that v9fs_co_run_in_worker() costs for every single syscall.
+ */
+typedef struct {
+    int fd;
+    const struct iovec *iov;
+    int iovcnt;
+    off_t offset;
+} LocalUringRW;
+
+static void local_uring_prep_readv(struct io_uring_sqe *sqe, void *opaque)
+{
+    LocalUringRW *rw = opaque;
+
+    io_uring_prep_readv(sqe, rw->fd, rw->iov, rw->iovcnt, rw->offset);
+}
+
+static void local_uring_prep_writev(struct io_uring_sqe *sqe, void *opaque)
+{
+    LocalUringRW *rw = opaque;
+
+    io_uring_prep_writev(sqe, rw->fd, rw->iov, rw->iovcnt, rw->offset);
+}
+
+static ssize_t coroutine_fn local_co_preadv(FsContext *ctx,
+                                            V9fsFidOpenState *fs,
+                                            const struct iovec *iov,
+                                            int iovcnt, off_t offset)
+{
+    LocalUringRW rw = {
+        .fd = fs->fd,
+        .iov = iov,
+        .iovcnt = iovcnt,
+        .offset = offset,
+    };
+    int ret;
+
+    if (!aio_has_io_uring()) {
+        return -ENOTSUP;
+    }
+    ret = v9fs_co_uring_submit(local_uring_prep_readv, &rw);
+    return ret == -EAGAIN ? -ENOTSUP : ret;
+}
+
+static ssize_t coroutine_fn local_co_pwritev(FsContext *ctx,
+                                             V9fsFidOpenState *fs,
+                                             const struct iovec *iov,
+                                             int iovcnt, off_t offset)
+{
+    LocalUringRW rw = {
+        .fd = fs->fd,
+        .iov = iov,
+        .iovcnt = iovcnt,
+        .offset = offset,
+    };
+    int ret;
+
+    /* writeout=immediate needs the sync_file_range() in local_pwritev() */
+    if (!aio_has_io_uring() ||
+        ctx->export_flags & V9FS_IMMEDIATE_WRITEOUT) {
+        return -ENOTSUP;
+    }
+    ret = v9fs_co_uring_submit(local_uring_prep_writev, &rw);
+    return ret == -EAGAIN ? -ENOTSUP : ret;
+}
+
+typedef struct {
+    int fd;
+    unsigned flags;
+} LocalUringFsync;
+
+static void local_uring_prep_fsync(struct io_uring_sqe *sqe, void *opaque)
+{
+    LocalUringFsync *req = opaque;
+
+    io_uring_prep_fsync(sqe, req->fd, req->flags);
+}
+
+static int coroutine_fn local_co_fsync(FsContext *ctx, int fid_type,
+                                       V9fsFidOpenState *fs, int datasync)
+{
+    LocalUringFsync req = {
+        .fd = local_fid_fd(fid_type, fs),
+        .flags = datasync ? IORING_FSYNC_DATASYNC : 0,
+    };
+
+    if (!aio_has_io_uring()) {
+        return -ENOTSUP;
+    }
+    if (req.fd == -1) {
+        return -EBADF;
+    }
+    return v9fs_co_uring_submit(local_uring_prep_fsync, &req);
+}
+
+#ifdef HAVE_IO_URING_PREP_OPENAT2
+typedef struct {
+    int dirfd;
+    const char *path;
+    struct open_how how;
+} LocalUringOpen;
+
+static void local_uring_prep_openat2(struct io_uring_sqe *sqe, void *opaque)
+{
+    LocalUringOpen *req = opaque;
+
+    io_uring_prep_openat2(sqe, req->dirfd, req->path, &req->how);
+}
+
+typedef struct {
+    int dirfd;
+    const char *name;
+    struct statx stx;
+} LocalUringStatx;
+
+static void local_uring_prep_statx(struct io_uring_sqe *sqe, void *opaque)
+{
+    LocalUringStatx *req = opaque;
+
+    io_uring_prep_statx(sqe, req->dirfd, req->name, AT_SYMLINK_NOFOLLOW,
+                        STATX_BASIC_STATS, &req->stx);
+}
+
+static void local_statx_to_stat(const struct statx *stx, struct stat *stbuf)
+{
+    memset(stbuf, 0, sizeof(*stbuf));
+    stbuf->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    stbuf->st_ino = stx->stx_ino;
+    stbuf->st_mode = stx->stx_mode;
+    stbuf->st_nlink = stx->stx_nlink;
+    stbuf->st_uid = stx->stx_uid;
+    stbuf->st_gid = stx->stx_gid;
+    stbuf->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    stbuf->st_size = stx->stx_size;
+    stbuf->st_blksize = stx->stx_blksize;
+    stbuf->st_blocks = stx->stx_blocks;
+    stbuf->st_atim.tv_sec = stx->stx_atime.tv_sec;
+    stbuf->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+    stbuf->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+    stbuf->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    stbuf->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+    stbuf->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+/*
+ * Same as local_lstat() for the passthrough and none security models, where
+ * the attributes come from the inode alone. The parent directory is resolved
+ * in a single openat2() with RESOLVE_NO_SYMLINKS | RESOLVE_BENEATH, which
+ * gives the same guarantees as the component-wise walk done by
+ * local_opendir_nofollow().
+ */
+static int coroutine_fn local_co_lstat(FsContext *fs_ctx, V9fsPath *fs_path,
+                                       struct stat *stbuf)
+{
+    LocalData *data = fs_ctx->private;
+    g_autofree char *dirpath = NULL;
+    g_autofree char *name = NULL;
+    LocalUringOpen open_req;
+    LocalUringStatx statx_req;
+    int dirfd, ret;
+
+    if (!aio_has_io_uring() ||
+        fs_ctx->export_flags & (V9FS_SM_MAPPED | V9FS_SM_MAPPED_FILE)) {
+        return -ENOTSUP;
+    }
+
+    dirpath = g_path_get_dirname(fs_path->data);
+    name = g_path_get_basename(fs_path->data);
+
+    open_req = (LocalUringOpen) {
+        .dirfd = data->mountfd,
+        .path = dirpath,
+        .how = {
+            .flags = O_DIRECTORY | O_RDONLY | O_PATH | O_CLOEXEC,
+            .resolve = RESOLVE_NO_SYMLINKS | RESOLVE_BENEATH,
+        },
+    };
+    dirfd = v9fs_co_uring_submit(local_uring_prep_openat2, &open_req);
+    if (dirfd < 0) {
+        /*
+         * Kernels without IORING_OP_OPENAT2 fail with -EINVAL, and the
+         * errno reported for symlinks differs from the nofollow walk. Only
+         * take a missing path as is and let the worker sort out the rest.
+         */
+        return dirfd == -ENOENT ? dirfd : -ENOTSUP;
+    }
+
+    statx_req = (LocalUringStatx) {
+        .dirfd = dirfd,
+        .name = name,
+    };
+    ret = v9fs_co_uring_submit(local_uring_prep_statx, &statx_req);
+    close(dirfd);
+    if (ret < 0) {
+        return ret == -EINVAL ? -ENOTSUP : ret;
+    }
+
+    local_statx_to_stat(&statx_req.stx, stbuf);
+    return 0;
+}
+#endif /* HAVE_IO_URING_PREP_OPENAT2 */
+#endif /* CONFIG_LINUX_IO_URING */
+
 FileOperations local_ops = {
     .parse_opts = local_parse_opts,
     .init  = local_init,
@@ -1661,4 +1879,12 @@ FileOperations local_ops = {
     .has_valid_file_handle = local_has_valid_file_handle,
     .ftruncate = local_ftruncate,
     .futimens = local_futimens,
+#ifdef CONFIG_LINUX_IO_URING
+#ifdef HAVE_IO_URING_PREP_OPENAT2
+    .co_lstat = local_co_lstat,
+#endif
+    .co_preadv = local_co_preadv,
+    .co_pwritev = local_co_pwritev,
+    .co_fsync = local_co_fsync,
+#endif
 };
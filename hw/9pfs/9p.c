@@ -1101,6 +1101,33 @@ void pdu_free(V9fsPDU *pdu)
     QLIST_INSERT_HEAD(&s->free_list, pdu, next);
 }
 
+static inline bool is_read_only_op(V9fsPDU *pdu)
+{
+    switch (pdu->id) {
+    case P9_TREADDIR:
+    case P9_TSTATFS:
+    case P9_TGETATTR:
+    case P9_TXATTRWALK:
+    case P9_TLOCK:
+    case P9_TGETLOCK:
+    case P9_TREADLINK:
+    case P9_TVERSION:
+    case P9_TLOPEN:
+    case P9_TATTACH:
+    case P9_TSTAT:
+    case P9_TWALK:
+    case P9_TCLUNK:
+    case P9_TFSYNC:
+    case P9_TOPEN:
+    case P9_TREAD:
+    case P9_TAUTH:
+    case P9_TFLUSH:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
 static void coroutine_fn pdu_complete(V9fsPDU *pdu, ssize_t len)
 {
     int8_t id = pdu->id + 1; /* Response */
@@ -1119,6 +1146,11 @@ static void coroutine_fn pdu_complete(V9fsPDU *pdu, ssize_t len)
      * transmission of the reply.
      */
     bool discard = pdu->cancelled && len == -EINTR;
+
+    if (!is_read_only_op(pdu)) {
+        v9fs_cache_flush(&s->cache);
+    }
+
     if (discard) {
         trace_v9fs_rcancel(pdu->tag, pdu->id);
         pdu->size = 0;
@@ -1909,6 +1941,45 @@ static char *trace_v9fs_walk_wnames(V9fsString *wnames, size_t nwnames)
     return g_strjoinv(", ", arr);
 }
 
+/*
+ * Try to resolve a whole Twalk request from the metadata cache on main
+ * thread, without dispatching anything to the fs driver's worker thread.
+ * Fills @pathes, @stbufs and @fidst like the worker part of v9fs_walk() and
+ * returns true only if every element of the walk was found in the cache.
+ */
+static bool coroutine_fn v9fs_walk_cached(V9fsPDU *pdu, V9fsPath *fidpath,
+                                          V9fsString *wnames, uint16_t nwnames,
+                                          V9fsPath *pathes,
+                                          struct stat *stbufs,
+                                          struct stat *fidst)
+{
+    V9fsState *s = pdu->s;
+    V9fsPath *dpath = fidpath;
+    struct stat stbuf;
+    int i;
+
+    if (!v9fs_cache_get_stat(&s->cache, dpath, fidst)) {
+        return false;
+    }
+    stbuf = *fidst;
+    for (i = 0; i < nwnames; i++) {
+        if (!same_stat_id(&s->root_st, &stbuf) ||
+            strcmp("..", wnames[i].data))
+        {
+            if (s->ops->name_to_path(&s->ctx, dpath, wnames[i].data,
+                                     &pathes[i]) < 0) {
+                return false;
+            }
+            if (!v9fs_cache_get_stat(&s->cache, &pathes[i], &stbuf)) {
+                return false;
+            }
+            stbufs[i] = stbuf;
+            dpath = &pathes[i];
+        }
+    }
+    return true;
+}
+
 static void coroutine_fn v9fs_walk(void *opaque)
 {
     int name_idx, nwalked;
@@ -1928,6 +1999,8 @@ static void coroutine_fn v9fs_walk(void *opaque)
     V9fsPDU *pdu = opaque;
     V9fsState *s = pdu->s;
     V9fsQID qid;
+    uint64_t generation = s->cache.generation;
+    bool cached = false;
 
     err = pdu_unmarshal(pdu, offset, "ddw", &fid, &newfid, &nwnames);
     if (err < 0) {
@@ -1980,52 +2053,60 @@ static void coroutine_fn v9fs_walk(void *opaque)
     v9fs_path_copy(&dpath, &fidp->path);
     v9fs_path_copy(&path, &fidp->path);
 
-    /*
-     * To keep latency (i.e. overall execution time for processing this
-     * Twalk client request) as small as possible, run all the required fs
-     * driver code altogether inside the following block.
-     */
-    v9fs_co_run_in_worker({
-        nwalked = 0;
-        if (v9fs_request_cancelled(pdu)) {
-            any_err |= err = -EINTR;
-            break;
-        }
-        err = s->ops->lstat(&s->ctx, &dpath, &fidst);
-        if (err < 0) {
-            any_err |= err = -errno;
-            break;
-        }
-        stbuf = fidst;
-        for (; nwalked < nwnames; nwalked++) {
+    if (v9fs_cache_enabled(&s->cache) &&
+        v9fs_walk_cached(pdu, &fidp->path, wnames, nwnames, pathes, stbufs,
+                         &fidst)) {
+        cached = true;
+        nwalked = nwnames;
+        err = 0;
+    } else {
+        /*
+         * To keep latency (i.e. overall execution time for processing this
+         * Twalk client request) as small as possible, run all the required fs
+         * driver code altogether inside the following block.
+         */
+        v9fs_co_run_in_worker({
+            nwalked = 0;
             if (v9fs_request_cancelled(pdu)) {
                 any_err |= err = -EINTR;
                 break;
             }
-            if (!same_stat_id(&pdu->s->root_st, &stbuf) ||
-                strcmp("..", wnames[nwalked].data))
-            {
-                err = s->ops->name_to_path(&s->ctx, &dpath,
-                                           wnames[nwalked].data,
-                                           &pathes[nwalked]);
-                if (err < 0) {
-                    any_err |= err = -errno;
-                    break;
-                }
+            err = s->ops->lstat(&s->ctx, &dpath, &fidst);
+            if (err < 0) {
+                any_err |= err = -errno;
+                break;
+            }
+            stbuf = fidst;
+            for (; nwalked < nwnames; nwalked++) {
                 if (v9fs_request_cancelled(pdu)) {
                     any_err |= err = -EINTR;
                     break;
                 }
-                err = s->ops->lstat(&s->ctx, &pathes[nwalked], &stbuf);
-                if (err < 0) {
-                    any_err |= err = -errno;
-                    break;
+                if (!same_stat_id(&pdu->s->root_st, &stbuf) ||
+                    strcmp("..", wnames[nwalked].data))
+                {
+                    err = s->ops->name_to_path(&s->ctx, &dpath,
+                                               wnames[nwalked].data,
+                                               &pathes[nwalked]);
+                    if (err < 0) {
+                        any_err |= err = -errno;
+                        break;
+                    }
+                    if (v9fs_request_cancelled(pdu)) {
+                        any_err |= err = -EINTR;
+                        break;
+                    }
+                    err = s->ops->lstat(&s->ctx, &pathes[nwalked], &stbuf);
+                    if (err < 0) {
+                        any_err |= err = -errno;
+                        break;
+                    }
+                    stbufs[nwalked] = stbuf;
+                    v9fs_path_copy(&dpath, &pathes[nwalked]);
                 }
-                stbufs[nwalked] = stbuf;
-                v9fs_path_copy(&dpath, &pathes[nwalked]);
             }
-        }
-    });
+        });
+    }
     /*
      * Handle all the rest of this Twalk request on main thread ...
      *
@@ -2039,6 +2120,10 @@ static void coroutine_fn v9fs_walk(void *opaque)
         goto out;
     }
 
+    if (!cached) {
+        v9fs_cache_put_stat(&s->cache, generation, &fidp->path, &fidst);
+    }
+
     any_err |= err = stat_to_qid(pdu, &fidst, &qid);
     if (err < 0 && !nwalked) {
         goto out;
@@ -2058,6 +2143,10 @@ static void coroutine_fn v9fs_walk(void *opaque)
             if (err < 0) {
                 break;
             }
+            if (!cached) {
+                v9fs_cache_put_stat(&s->cache, generation, &pathes[name_idx],
+                                    &stbuf);
+            }
             v9fs_path_copy(&path, &pathes[name_idx]);
             v9fs_path_copy(&dpath, &path);
         }
@@ -2604,7 +2693,7 @@ size_t v9fs_readdir_response_size(V9fsString *name)
     return 24 + v9fs_string_size(name);
 }
 
-static void v9fs_free_dirents(struct V9fsDirEnt *e)
+void v9fs_free_dirents(struct V9fsDirEnt *e)
 {
     struct V9fsDirEnt *next = NULL;
 
@@ -4352,33 +4441,6 @@ static void coroutine_fn v9fs_fs_ro(void *opaque)
     pdu_complete(pdu, -EROFS);
 }
 
-static inline bool is_read_only_op(V9fsPDU *pdu)
-{
-    switch (pdu->id) {
-    case P9_TREADDIR:
-    case P9_TSTATFS:
-    case P9_TGETATTR:
-    case P9_TXATTRWALK:
-    case P9_TLOCK:
-    case P9_TGETLOCK:
-    case P9_TREADLINK:
-    case P9_TVERSION:
-    case P9_TLOPEN:
-    case P9_TATTACH:
-    case P9_TSTAT:
-    case P9_TWALK:
-    case P9_TCLUNK:
-    case P9_TFSYNC:
-    case P9_TOPEN:
-    case P9_TREAD:
-    case P9_TAUTH:
-    case P9_TFLUSH:
-        return 1;
-    default:
-        return 0;
-    }
-}
-
 void pdu_submit(V9fsPDU *pdu, P9MsgHeader *hdr)
 {
     Coroutine *co;
@@ -4398,6 +4460,10 @@ void pdu_submit(V9fsPDU *pdu, P9MsgHeader *hdr)
         handler = pdu_co_handlers[pdu->id];
     }
 
+    if (!is_read_only_op(pdu)) {
+        v9fs_cache_flush(&s->cache);
+    }
+
     qemu_co_queue_init(&pdu->complete);
     co = qemu_coroutine_create(handler, pdu);
     qemu_coroutine_enter(co);
@@ -4511,6 +4577,8 @@ int v9fs_device_realize_common(V9fsState *s, const V9fsTransport *t,
     s->ctx.xattr_fid_limit = fse->max_xattr;
     s->ctx.xattr_fid_count = 0;
 
+    v9fs_cache_init(&s->cache, fse->cache_timeout);
+
     rc = 0;
 out:
     if (rc) {
@@ -4533,6 +4601,7 @@ void v9fs_device_unrealize_common(V9fsState *s)
         s->fids = NULL;
     }
     g_free(s->tag);
+    v9fs_cache_cleanup(&s->cache);
     qp_table_destroy(&s->qpd_table);
     qp_table_destroy(&s->qpp_table);
     qp_table_destroy(&s->qpf_table);
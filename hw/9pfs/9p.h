@@ -335,6 +335,25 @@ typedef struct {
     uint64_t path;
 } QpfEntry;
 
+/*
+ * Opt-in cache of lstat() results and readdir responses, so that repeated
+ * walks of the same tree can be answered without any fs driver call.
+ *
+ * Every request that may modify the export flushes the whole cache on
+ * submission and on completion. Changes made on host side behind QEMU's
+ * back become visible to the guest after at most @timeout milliseconds.
+ *
+ * Only accessed from the main I/O thread (top half).
+ */
+typedef struct V9fsCache {
+    /* lifetime of an entry in ms, 0 if the cache is disabled */
+    uint32_t timeout;
+    /* incremented on every flush to reject inserts of stale results */
+    uint64_t generation;
+    GHashTable *stats;
+    GHashTable *dirents;
+} V9fsCache;
+
 struct V9fsState {
     QLIST_HEAD(, V9fsPDU) free_list;
     QLIST_HEAD(, V9fsPDU) active_list;
@@ -363,6 +382,7 @@ struct V9fsState {
     uint16_t qp_affix_next;
     uint64_t qp_fullpath_next;
     bool reclaiming;
+    V9fsCache cache;
 };
 
 /* 9p2000.L open flags */
@@ -470,6 +490,27 @@ V9fsPDU *pdu_alloc(V9fsState *s);
 void pdu_free(V9fsPDU *pdu);
 void pdu_submit(V9fsPDU *pdu, P9MsgHeader *hdr);
 void v9fs_reset(V9fsState *s);
+void v9fs_free_dirents(struct V9fsDirEnt *e);
+
+void v9fs_cache_init(V9fsCache *cache, uint32_t timeout);
+void v9fs_cache_cleanup(V9fsCache *cache);
+void v9fs_cache_flush(V9fsCache *cache);
+bool v9fs_cache_get_stat(V9fsCache *cache, V9fsPath *path,
+                         struct stat *stbuf);
+void v9fs_cache_put_stat(V9fsCache *cache, uint64_t generation,
+                         V9fsPath *path, const struct stat *stbuf);
+int32_t v9fs_cache_get_dirents(V9fsCache *cache, V9fsPath *path,
+                               off_t offset, int32_t maxsize, bool dostat,
+                               struct V9fsDirEnt **entries);
+void v9fs_cache_put_dirents(V9fsCache *cache, uint64_t generation,
+                            V9fsPath *path, off_t offset, int32_t maxsize,
+                            bool dostat, int32_t size,
+                            struct V9fsDirEnt *entries);
+
+static inline bool v9fs_cache_enabled(V9fsCache *cache)
+{
+    return cache->timeout > 0;
+}
 
 struct V9fsTransport {
     ssize_t     coroutine_fn (*pdu_vmarshal)(V9fsPDU *pdu, size_t offset,
@@ -221,15 +221,25 @@ int coroutine_fn v9fs_co_readdir_many(V9fsPDU *pdu, V9fsFidState *fidp,
 {
     int err = 0;
     V9fsState *s = pdu->s;
+    uint64_t generation = s->cache.generation;
 
     if (v9fs_request_cancelled(pdu)) {
         return -EINTR;
     }
+    err = v9fs_cache_get_dirents(&s->cache, &fidp->path, offset, maxsize,
+                                 dostat, entries);
+    if (err >= 0) {
+        return err;
+    }
     v9fs_path_read_lock(s);
     v9fs_co_run_in_worker({
         err = do_readdir_many(pdu, fidp, entries, offset, maxsize, dostat);
     });
     v9fs_path_unlock(s);
+    if (err >= 0) {
+        v9fs_cache_put_dirents(&s->cache, generation, &fidp->path, offset,
+                               maxsize, dostat, err, *entries);
+    }
     return err;
 }
 
@@ -51,11 +51,21 @@ int coroutine_fn v9fs_co_lstat(V9fsPDU *pdu, V9fsPath *path, struct stat *stbuf)
 {
     int err;
     V9fsState *s = pdu->s;
+    uint64_t generation = s->cache.generation;
 
     if (v9fs_request_cancelled(pdu)) {
         return -EINTR;
     }
+    if (v9fs_cache_get_stat(&s->cache, path, stbuf)) {
+        return 0;
+    }
     v9fs_path_read_lock(s);
+    if (s->ops->co_lstat) {
+        err = s->ops->co_lstat(&s->ctx, path, stbuf);
+        if (err != -ENOTSUP) {
+            goto out;
+        }
+    }
     v9fs_co_run_in_worker(
         {
             err = s->ops->lstat(&s->ctx, path, stbuf);
@@ -63,7 +73,11 @@ int coroutine_fn v9fs_co_lstat(V9fsPDU *pdu, V9fsPath *path, struct stat *stbuf)
                 err = -errno;
             }
         });
+out:
     v9fs_path_unlock(s);
+    if (!err) {
+        v9fs_cache_put_stat(&s->cache, generation, path, stbuf);
+    }
     return err;
 }
 
@@ -119,6 +133,9 @@ int coroutine_fn v9fs_co_open(V9fsPDU *pdu, V9fsFidState *fidp, int flags)
             }
         });
     v9fs_path_unlock(s);
+    if (flags & O_TRUNC) {
+        v9fs_cache_flush(&s->cache);
+    }
     if (!err) {
         total_open_fd++;
         if (total_open_fd > open_fd_hw) {
@@ -216,6 +233,12 @@ int coroutine_fn v9fs_co_fsync(V9fsPDU *pdu, V9fsFidState *fidp, int datasync)
     if (v9fs_request_cancelled(pdu)) {
         return -EINTR;
     }
+    if (s->ops->co_fsync) {
+        err = s->ops->co_fsync(&s->ctx, fidp->fid_type, &fidp->fs, datasync);
+        if (err != -ENOTSUP) {
+            return err;
+        }
+    }
     v9fs_co_run_in_worker(
         {
             err = s->ops->fsync(&s->ctx, fidp->fid_type, &fidp->fs, datasync);
@@ -258,6 +281,12 @@ int coroutine_fn v9fs_co_pwritev(V9fsPDU *pdu, V9fsFidState *fidp,
         return -EINTR;
     }
     fsdev_co_throttle_request(s->ctx.fst, THROTTLE_WRITE, iov, iovcnt);
+    if (s->ops->co_pwritev) {
+        err = s->ops->co_pwritev(&s->ctx, &fidp->fs, iov, iovcnt, offset);
+        if (err != -ENOTSUP) {
+            return err;
+        }
+    }
     v9fs_co_run_in_worker(
         {
             err = s->ops->pwritev(&s->ctx, &fidp->fs, iov, iovcnt, offset);
@@ -278,6 +307,12 @@ int coroutine_fn v9fs_co_preadv(V9fsPDU *pdu, V9fsFidState *fidp,
         return -EINTR;
     }
     fsdev_co_throttle_request(s->ctx.fst, THROTTLE_READ, iov, iovcnt);
+    if (s->ops->co_preadv) {
+        err = s->ops->co_preadv(&s->ctx, &fidp->fs, iov, iovcnt, offset);
+        if (err != -ENOTSUP) {
+            return err;
+        }
+    }
     v9fs_co_run_in_worker(
         {
             err = s->ops->preadv(&s->ctx, &fidp->fs, iov, iovcnt, offset);
@@ -43,3 +43,42 @@ void co_run_in_worker_bh(void *opaque)
     Coroutine *co = opaque;
     thread_pool_submit_aio(coroutine_enter_func, co, coroutine_enter_cb, co);
 }
+
+#ifdef CONFIG_LINUX_IO_URING
+typedef struct {
+    Coroutine *co;
+    int ret;
+    CqeHandler cqe_handler;
+} V9fsUringRequest;
+
+static void v9fs_uring_cqe_handler(CqeHandler *cqe_handler)
+{
+    V9fsUringRequest *req = container_of(cqe_handler, V9fsUringRequest,
+                                         cqe_handler);
+
+    req->ret = cqe_handler->cqe.res;
+
+    /* The coroutine may still be inside v9fs_co_uring_submit() */
+    if (!qemu_coroutine_entered(req->co)) {
+        aio_co_wake(req->co);
+    }
+}
+
+int coroutine_fn v9fs_co_uring_submit(void (*prep_sqe)(struct io_uring_sqe *,
+                                                       void *),
+                                      void *opaque)
+{
+    V9fsUringRequest req = {
+        .co = qemu_coroutine_self(),
+        .ret = -EINPROGRESS,
+    };
+
+    req.cqe_handler.cb = v9fs_uring_cqe_handler;
+    aio_add_sqe(prep_sqe, opaque, &req.cqe_handler);
+
+    if (req.ret == -EINPROGRESS) {
+        qemu_coroutine_yield();
+    }
+    return req.ret;
+}
+#endif
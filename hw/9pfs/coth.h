@@ -59,6 +59,16 @@
     } while (0)
 
 void co_run_in_worker_bh(void *);
+#ifdef CONFIG_LINUX_IO_URING
+/*
+ * Submit a single io_uring request from the current AioContext and yield
+ * until it completes, returning the cqe result. Only valid when
+ * aio_has_io_uring() is true.
+ */
+int coroutine_fn v9fs_co_uring_submit(void (*prep_sqe)(struct io_uring_sqe *,
+                                                       void *),
+                                      void *opaque);
+#endif
 int coroutine_fn v9fs_co_readlink(V9fsPDU *, V9fsPath *, V9fsString *);
 int coroutine_fn v9fs_co_readdir(V9fsPDU *, V9fsFidState *, struct dirent **);
 int coroutine_fn v9fs_co_readdir_many(V9fsPDU *, V9fsFidState *,
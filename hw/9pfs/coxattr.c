@@ -88,6 +88,7 @@ int coroutine_fn v9fs_co_lsetxattr(V9fsPDU *pdu, V9fsPath *path,
             }
         });
     v9fs_path_unlock(s);
+    v9fs_cache_flush(&s->cache);
     return err;
 }
 
@@ -109,5 +110,6 @@ int coroutine_fn v9fs_co_lremovexattr(V9fsPDU *pdu, V9fsPath *path,
             }
         });
     v9fs_path_unlock(s);
+    v9fs_cache_flush(&s->cache);
     return err;
 }
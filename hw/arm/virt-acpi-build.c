@@ -30,6 +30,7 @@
 #include "qapi/error.h"
 #include "qemu/bitmap.h"
 #include "qemu/error-report.h"
+#include "qemu/startup-profile.h"
 #include "trace.h"
 #include "hw/core/cpu.h"
 #include "hw/acpi/acpi-defs.h"
@@ -1561,6 +1562,7 @@ void virt_acpi_setup(VirtMachineState *vms)
     AcpiBuildTables tables;
     AcpiBuildState *build_state;
     AcpiGedState *acpi_ged_state;
+    int64_t start;
 
     if (!vms->fw_cfg) {
         trace_virt_acpi_setup();
@@ -1574,8 +1576,10 @@ void virt_acpi_setup(VirtMachineState *vms)
 
     build_state = g_malloc0(sizeof *build_state);
 
+    start = startup_profile_begin();
     acpi_build_tables_init(&tables);
     virt_acpi_build(vms, &tables);
+    startup_profile_end(start, "acpi", "virt_acpi_build");
 
     /* Now expose it all to Guest */
     build_state->table_mr = acpi_add_rom_blob(virt_acpi_build_update,
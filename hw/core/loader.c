@@ -48,6 +48,8 @@
 #include "qapi/error.h"
 #include "qapi/qapi-commands-machine.h"
 #include "qapi/type-helpers.h"
+#include "block/thread-pool.h"
+#include "qemu/startup-profile.h"
 #include "qemu/units.h"
 #include "trace.h"
 #include "hw/core/hw-error.h"
@@ -983,6 +985,10 @@ struct Rom {
     char *fw_dir;
     char *fw_file;
     GMappedFile *mapped_file;
+    /* Opened by rom_add_file() for reading the file in the background */
+    int load_fd;
+    /* Set by the worker if reading the file in the background failed */
+    GError *load_err;
 
     bool committed;
 
@@ -993,6 +999,79 @@ struct Rom {
 static FWCfgState *fw_cfg;
 static QTAILQ_HEAD(, Rom) roms = QTAILQ_HEAD_INITIALIZER(roms);
 
+/*
+ * Files at least this large are read on a worker thread by rom_add_file(),
+ * so that machine init can go on creating devices in the meantime.
+ */
+#define ROM_LOAD_ASYNC_MIN_SIZE (1 * MiB)
+
+static ThreadPool *rom_load_pool;
+static bool rom_load_pending;
+
+static int rom_load_worker(void *opaque)
+{
+    Rom *rom = opaque;
+    int64_t start = startup_profile_begin();
+    uint8_t *data = g_malloc(rom->romsize);
+    size_t done = 0;
+    ssize_t ret;
+
+    while (done < rom->romsize) {
+        ret = read(rom->load_fd, data + done, rom->romsize - done);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            g_set_error(&rom->load_err, G_FILE_ERROR,
+                        g_file_error_from_errno(errno), "%s", strerror(errno));
+            break;
+        }
+        if (ret == 0) {
+            g_set_error(&rom->load_err, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                        "file size changed while loading");
+            break;
+        }
+        done += ret;
+    }
+    close(rom->load_fd);
+    rom->load_fd = -1;
+
+    if (rom->load_err) {
+        g_free(data);
+        return -1;
+    }
+    startup_profile_end(start, "rom", "%s", rom->path);
+    rom->data = data;
+    return 0;
+}
+
+/*
+ * Wait for the ROM files that are being read in the background.  Must be
+ * called before looking at the contents of any ROM.
+ *
+ * The files were opened by rom_add_file(), so only I/O errors can show up
+ * here.
+ */
+static void rom_load_wait(void)
+{
+    Rom *rom;
+
+    if (!rom_load_pending) {
+        return;
+    }
+    thread_pool_free(rom_load_pool);
+    rom_load_pool = NULL;
+    rom_load_pending = false;
+
+    QTAILQ_FOREACH(rom, &roms, next) {
+        if (rom->load_err) {
+            error_report("rom: file %-20s: error %s",
+                         rom->name, rom->load_err->message);
+            exit(1);
+        }
+    }
+}
+
 /*
  * rom->data can be heap-allocated or memory-mapped (e.g. when added with
  * rom_add_elf_program())
@@ -1012,6 +1091,7 @@ static void rom_free_data(Rom *rom)
 static void rom_free(Rom *rom)
 {
     rom_free_data(rom);
+    g_clear_error(&rom->load_err);
     g_free(rom->path);
     g_free(rom->name);
     g_free(rom->fw_dir);
@@ -1062,6 +1142,7 @@ static void *rom_set_mr(Rom *rom, Object *owner, const char *name, bool ro)
 {
     void *data;
 
+    rom_load_wait();
     rom->mr = g_malloc(sizeof(*rom->mr));
     memory_region_init_resizeable_ram(rom->mr, owner, name,
                                       rom->datasize, rom->romsize,
@@ -1088,6 +1169,9 @@ ssize_t rom_add_file(const char *file, const char *fw_dir,
     gsize size;
     g_autoptr(GError) gerr = NULL;
     char devpath[100];
+    int64_t start;
+    struct stat st;
+    int fd = -1;
 
     if (as && mr) {
         fprintf(stderr, "Specifying an Address Space and Memory Region is " \
@@ -1096,6 +1180,7 @@ ssize_t rom_add_file(const char *file, const char *fw_dir,
         return -1;
     }
 
+    start = startup_profile_begin();
     rom = g_malloc0(sizeof(*rom));
     rom->name = g_strdup(file);
     rom->path = qemu_find_file(QEMU_FILE_TYPE_BIOS, rom->name);
@@ -1104,12 +1189,38 @@ ssize_t rom_add_file(const char *file, const char *fw_dir,
         rom->path = g_strdup(file);
     }
 
-    if (!g_file_get_contents(rom->path, (gchar **) &rom->data,
-                             &size, &gerr)) {
+    /*
+     * Files registered with fw_cfg are needed right away, everything else
+     * is only looked at when the machine is done or at reset.  Only the
+     * size of those is needed now, the contents can come later.  The file
+     * is opened here, so that a file that cannot be opened still fails
+     * rom_add_file().
+     */
+    if (!(fw_dir && fw_cfg)) {
+        fd = qemu_open_old(rom->path, O_RDONLY | O_BINARY);
+        if (fd >= 0 && (fstat(fd, &st) || !S_ISREG(st.st_mode) ||
+                        st.st_size < ROM_LOAD_ASYNC_MIN_SIZE)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        size = st.st_size;
+        rom->romsize = size;
+        rom->load_fd = fd;
+        if (!rom_load_pool) {
+            rom_load_pool = thread_pool_new();
+        }
+        thread_pool_submit_immediate(rom_load_pool, rom_load_worker,
+                                     rom, NULL);
+        rom_load_pending = true;
+    } else if (!g_file_get_contents(rom->path, (gchar **) &rom->data,
+                                    &size, &gerr)) {
         fprintf(stderr, "rom: file %-20s: error %s\n",
                 rom->name, gerr->message);
         goto err;
     }
+    startup_profile_end(start, "rom", "%s", rom->path);
 
     if (fw_dir) {
         rom->fw_dir  = g_strdup(fw_dir);
@@ -1340,6 +1451,8 @@ int rom_check_and_register_reset(void)
     Rom *rom, *last_rom = NULL;
     bool found_overlap = false;
 
+    rom_load_wait();
+
     QTAILQ_FOREACH(rom, &roms, next) {
         if (rom->fw_file) {
             continue;
@@ -1389,6 +1502,8 @@ void rom_transaction_end(bool commit)
     Rom *rom;
     Rom *tmp;
 
+    rom_load_wait();
+
     QTAILQ_FOREACH_SAFE(rom, &roms, next, tmp) {
         if (rom->committed) {
             continue;
@@ -1522,6 +1637,8 @@ int rom_copy(uint8_t *dest, hwaddr addr, size_t size)
     size_t l = 0;
     Rom *rom;
 
+    rom_load_wait();
+
     QTAILQ_FOREACH(rom, &roms, next) {
         if (rom->fw_file) {
             continue;
@@ -1576,6 +1693,7 @@ void *rom_ptr(hwaddr addr, size_t size)
 {
     Rom *rom;
 
+    rom_load_wait();
     rom = find_rom(addr, size);
     if (!rom || !rom->data)
         return NULL;
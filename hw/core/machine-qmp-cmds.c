@@ -20,6 +20,7 @@
 #include "qobject/qobject.h"
 #include "qapi/qobject-input-visitor.h"
 #include "qapi/type-helpers.h"
+#include "qemu/startup-profile.h"
 #include "qemu/uuid.h"
 #include "qemu/target-info.h"
 #include "qemu/target-info-qapi.h"
@@ -301,6 +302,30 @@ UuidInfo *qmp_query_uuid(Error **errp)
     return info;
 }
 
+static void query_startup_profile_event(const StartupProfileRecord *rec,
+                                        void *opaque)
+{
+    StartupProfileEventList ***tail = opaque;
+    StartupProfileEvent *ev = g_new(StartupProfileEvent, 1);
+
+    ev->category = g_strdup(rec->category);
+    ev->name = g_strdup(rec->name);
+    ev->thread_id = rec->thread_id;
+    ev->start = rec->start;
+    ev->duration = rec->duration;
+    QAPI_LIST_APPEND(*tail, ev);
+}
+
+StartupProfile *qmp_query_startup_profile(Error **errp)
+{
+    StartupProfile *profile = g_new0(StartupProfile, 1);
+    StartupProfileEventList **tail = &profile->events;
+
+    startup_profile_foreach(query_startup_profile_event, &tail);
+    profile->complete = startup_profile_finished();
+    return profile;
+}
+
 void qmp_system_reset(Error **errp)
 {
     qemu_system_reset_request(SHUTDOWN_CAUSE_HOST_QMP_SYSTEM_RESET);
@@ -32,6 +32,7 @@
 #include "qapi/visitor.h"
 #include "qemu/error-report.h"
 #include "qemu/option.h"
+#include "qemu/startup-profile.h"
 #include "qom/compat-properties.h"
 #include "hw/core/irq.h"
 #include "hw/core/qdev-properties.h"
@@ -526,7 +527,12 @@ static void device_set_realized(Object *obj, bool value, Error **errp)
         }
 
         if (dc->realize) {
+            int64_t start = startup_profile_begin();
+
             dc->realize(dev, &local_err);
+            startup_profile_end(start, "realize", "%s%s%s",
+                                object_get_typename(obj),
+                                dev->id ? " id=" : "", dev->id ?: "");
             if (local_err != NULL) {
                 goto fail;
             }
@@ -872,10 +878,20 @@ bool phase_check(MachineInitPhase phase)
     return machine_phase >= phase;
 }
 
+static const char *const phase_names[] = {
+    [PHASE_NO_MACHINE] = "no-machine",
+    [PHASE_MACHINE_CREATED] = "machine-created",
+    [PHASE_ACCEL_CREATED] = "accel-created",
+    [PHASE_LATE_BACKENDS_CREATED] = "late-backends-created",
+    [PHASE_MACHINE_INITIALIZED] = "machine-initialized",
+    [PHASE_MACHINE_READY] = "machine-ready",
+};
+
 void phase_advance(MachineInitPhase phase)
 {
     assert(machine_phase == phase - 1);
     machine_phase = phase;
+    startup_profile_mark("phase", phase_names[phase]);
 }
 
 static const TypeInfo device_type_info = {
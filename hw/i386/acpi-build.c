@@ -27,6 +27,7 @@
 #include "acpi-common.h"
 #include "qemu/bitmap.h"
 #include "qemu/error-report.h"
+#include "qemu/startup-profile.h"
 #include "hw/pci/pci_bridge.h"
 #include "hw/cxl/cxl.h"
 #include "hw/core/cpu.h"
@@ -2278,6 +2279,7 @@ void acpi_setup(void)
     AcpiBuildTables tables;
     AcpiBuildState *build_state;
     Object *vmgenid_dev;
+    int64_t start;
 #ifdef CONFIG_TPM
     TPMIf *tpm;
     static FwCfgTPMConfig tpm_config;
@@ -2300,8 +2302,10 @@ void acpi_setup(void)
 
     build_state = g_malloc0(sizeof *build_state);
 
+    start = startup_profile_begin();
     acpi_build_tables_init(&tables);
     acpi_build(&tables, MACHINE(pcms));
+    startup_profile_end(start, "acpi", "acpi_build");
 
     /* Now expose it all to Guest */
     build_state->table_mr = acpi_add_rom_blob(acpi_build_update,
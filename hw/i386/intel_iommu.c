@@ -5710,6 +5710,7 @@ static void vtd_iommu_memory_region_class_init(ObjectClass *klass,
     imrc->replay = vtd_iommu_replay;
     imrc->attrs_to_index = vtd_attrs_to_index;
     imrc->num_indexes = vtd_num_indexes;
+    imrc->cache_translations = true;
 }
 
 static const TypeInfo vtd_iommu_memory_region_info = {
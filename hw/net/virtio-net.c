@@ -13,6 +13,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/atomic.h"
+#include "qemu/defer-call.h"
 #include "qemu/iov.h"
 #include "qemu/log.h"
 #include "qemu/main-loop.h"
@@ -31,6 +32,8 @@
 #include "net/vhost_net.h"
 #include "net/announce.h"
 #include "hw/virtio/virtio-bus.h"
+#include "hw/virtio/iothread-vq-mapping.h"
+#include "qemu/aio-wait.h"
 #include "qapi/error.h"
 #include "qapi/qapi-events-net.h"
 #include "hw/core/qdev-properties.h"
@@ -401,6 +404,105 @@ static void virtio_net_drop_tx_queue_data(VirtIODevice *vdev, VirtQueue *vq)
     }
 }
 
+/*
+ * With iothread-vq-mapping every queue pair is serviced, together with its
+ * peer, by a single AioContext: the RX/TX host notifiers, the TX bottom half
+ * and the backend's fd handlers all run in that IOThread.  The main loop only
+ * keeps the control virtqueue and must quiesce the IOThreads before touching
+ * queue pair state.
+ */
+static bool virtio_net_uses_iothreads(VirtIONet *n)
+{
+    return n->net_conf.iothread_vq_mapping_list != NULL;
+}
+
+static bool virtio_net_iothreads_running(VirtIONet *n)
+{
+    return n->ioeventfd_started && !n->ioeventfd_quiesce_depth;
+}
+
+static void virtio_net_tx_bh_schedule(VirtIONetQueue *q)
+{
+    /*
+     * Outside the main loop the bottom half can only run while its queue
+     * pair is attached; virtio_net_ioeventfd_attach() reschedules it if
+     * q->tx_waiting is set.
+     */
+    if (virtio_net_uses_iothreads(q->n) &&
+        !virtio_net_iothreads_running(q->n)) {
+        return;
+    }
+    replay_bh_schedule_event(q->tx_bh);
+}
+
+/* Context: BQL held */
+static void virtio_net_ioeventfd_attach(VirtIONet *n)
+{
+    int queue_pairs = n->multiqueue ? n->max_queue_pairs : 1;
+    int i;
+
+    for (i = 0; i < queue_pairs; i++) {
+        VirtIONetQueue *q = &n->vqs[i];
+        NetClientState *nc = qemu_get_subqueue(n->nic, i);
+
+        qemu_set_aio_context(nc->peer, q->ctx);
+        /* The RX ring is normally full of buffers, don't busy-poll it */
+        virtio_queue_aio_attach_host_notifier_no_poll(q->rx_vq, q->ctx);
+        virtio_queue_aio_attach_host_notifier(q->tx_vq, q->ctx);
+        if (q->tx_waiting) {
+            replay_bh_schedule_event(q->tx_bh);
+        }
+    }
+}
+
+/* Context: BH in IOThread */
+static void virtio_net_ioeventfd_detach_bh(void *opaque)
+{
+    VirtIONetQueue *q = opaque;
+    VirtIONet *n = q->n;
+    NetClientState *nc = qemu_get_subqueue(n->nic, q - n->vqs);
+    AioContext *ctx = qemu_get_current_aio_context();
+
+    virtio_queue_aio_detach_host_notifier(q->rx_vq, ctx);
+    virtio_queue_aio_detach_host_notifier(q->tx_vq, ctx);
+    qemu_bh_cancel(q->tx_bh);
+    qemu_set_aio_context(nc->peer, NULL);
+}
+
+/* Context: BQL held */
+static void virtio_net_ioeventfd_detach(VirtIONet *n)
+{
+    int queue_pairs = n->multiqueue ? n->max_queue_pairs : 1;
+    int i;
+
+    for (i = 0; i < queue_pairs; i++) {
+        aio_wait_bh_oneshot(n->vqs[i].ctx, virtio_net_ioeventfd_detach_bh,
+                            &n->vqs[i]);
+    }
+}
+
+/*
+ * Keep the IOThreads away from the queue pairs while the main loop changes
+ * device state.  Calls can nest.
+ *
+ * Context: BQL held
+ */
+static void virtio_net_iothreads_quiesce(VirtIONet *n)
+{
+    if (n->ioeventfd_quiesce_depth++ == 0 && n->ioeventfd_started) {
+        virtio_net_ioeventfd_detach(n);
+    }
+}
+
+/* Context: BQL held */
+static void virtio_net_iothreads_resume(VirtIONet *n)
+{
+    assert(n->ioeventfd_quiesce_depth > 0);
+    if (--n->ioeventfd_quiesce_depth == 0 && n->ioeventfd_started) {
+        virtio_net_ioeventfd_attach(n);
+    }
+}
+
 static int virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
 {
     VirtIONet *n = VIRTIO_NET(vdev);
@@ -408,6 +510,7 @@ static int virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
     int i;
     uint8_t queue_status;
 
+    virtio_net_iothreads_quiesce(n);
     virtio_net_vnet_endian_status(n, status);
     virtio_net_vhost_status(n, status);
 
@@ -437,7 +540,7 @@ static int virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
                 timer_mod(q->tx_timer,
                                qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + n->tx_timeout);
             } else {
-                replay_bh_schedule_event(q->tx_bh);
+                virtio_net_tx_bh_schedule(q);
             }
         } else {
             if (q->tx_timer) {
@@ -456,6 +559,7 @@ static int virtio_net_set_status(struct VirtIODevice *vdev, uint8_t status)
             }
         }
     }
+    virtio_net_iothreads_resume(n);
     return 0;
 }
 
@@ -1592,8 +1696,11 @@ size_t virtio_net_handle_ctrl_iov(VirtIODevice *vdev,
 
 static void virtio_net_handle_ctrl(VirtIODevice *vdev, VirtQueue *vq)
 {
+    VirtIONet *n = VIRTIO_NET(vdev);
     VirtQueueElement *elem;
 
+    /* Commands change the filters and queue pairs used by the IOThreads */
+    virtio_net_iothreads_quiesce(n);
     for (;;) {
         size_t written;
         elem = virtqueue_pop(vq, sizeof(VirtQueueElement));
@@ -1613,6 +1720,7 @@ static void virtio_net_handle_ctrl(VirtIODevice *vdev, VirtQueue *vq)
             break;
         }
     }
+    virtio_net_iothreads_resume(n);
 }
 
 /* RX */
@@ -2723,7 +2831,7 @@ static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
          */
         virtio_queue_set_notification(q->tx_vq, 0);
         if (q->tx_bh) {
-            replay_bh_schedule_event(q->tx_bh);
+            virtio_net_tx_bh_schedule(q);
         } else {
             timer_mod(q->tx_timer,
                       qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + n->tx_timeout);
@@ -2733,7 +2841,7 @@ static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
 }
 
 /* TX */
-static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
+static int32_t virtio_net_do_flush_tx(VirtIONetQueue *q)
 {
     VirtIONet *n = q->n;
     VirtIODevice *vdev = VIRTIO_DEVICE(n);
@@ -2835,6 +2943,17 @@ detach:
     return -EINVAL;
 }
 
+static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
+{
+    int32_t ret;
+
+    defer_call_begin(); /* publish the burst's completions at once */
+    ret = virtio_net_do_flush_tx(q);
+    defer_call_end();
+
+    return ret;
+}
+
 static void virtio_net_tx_timer(void *opaque);
 
 static void virtio_net_handle_tx_timer(VirtIODevice *vdev, VirtQueue *vq)
@@ -2889,7 +3008,7 @@ static void virtio_net_handle_tx_bh(VirtIODevice *vdev, VirtQueue *vq)
         return;
     }
     virtio_queue_set_notification(vq, 0);
-    replay_bh_schedule_event(q->tx_bh);
+    virtio_net_tx_bh_schedule(q);
 }
 
 static void virtio_net_tx_timer(void *opaque)
@@ -2972,7 +3091,7 @@ static void virtio_net_tx_bh(void *opaque)
     /* If we flush a full burst of packets, assume there are
      * more coming and immediately reschedule */
     if (ret >= n->tx_burst) {
-        replay_bh_schedule_event(q->tx_bh);
+        virtio_net_tx_bh_schedule(q);
         q->tx_waiting = 1;
         return;
     }
@@ -2986,7 +3105,7 @@ static void virtio_net_tx_bh(void *opaque)
         return;
     } else if (ret > 0) {
         virtio_queue_set_notification(q->tx_vq, 0);
-        replay_bh_schedule_event(q->tx_bh);
+        virtio_net_tx_bh_schedule(q);
         q->tx_waiting = 1;
     }
 }
@@ -2994,6 +3113,7 @@ static void virtio_net_tx_bh(void *opaque)
 static void virtio_net_add_queue(VirtIONet *n, int index)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    VirtIONetQueue *q = &n->vqs[index];
 
     n->vqs[index].rx_vq = virtio_add_queue(vdev, n->net_conf.rx_queue_size,
                                            virtio_net_handle_rx);
@@ -3009,9 +3129,14 @@ static void virtio_net_add_queue(VirtIONet *n, int index)
         n->vqs[index].tx_vq =
             virtio_add_queue(vdev, n->net_conf.tx_queue_size,
                              virtio_net_handle_tx_bh);
-        n->vqs[index].tx_bh = virtio_bh_new_guarded(DEVICE(vdev),
-                                                    virtio_net_tx_bh,
-                                                    &n->vqs[index]);
+        if (q->ctx == qemu_get_aio_context()) {
+            q->tx_bh = virtio_bh_new_guarded(DEVICE(vdev), virtio_net_tx_bh, q);
+        } else {
+            DeviceState *transport = qdev_get_parent_bus(DEVICE(vdev))->parent;
+
+            q->tx_bh = aio_bh_new_guarded(q->ctx, virtio_net_tx_bh, q,
+                                          &transport->mem_reentrancy_guard);
+        }
     }
 
     n->vqs[index].tx_waiting = 0;
@@ -3152,6 +3277,18 @@ static void virtio_net_get_features(VirtIODevice *vdev, uint64_t *features,
                                 VIRTIO_NET_F_HOST_UDP_TUNNEL_GSO_CSUM);
     }
 
+    if (virtio_net_uses_iothreads(n)) {
+        /*
+         * Software RSS and RSC would fill queue pairs owned by other threads,
+         * hash reports would share n->rx_pkt between the IOThreads, and a
+         * single queue cannot be reset behind its IOThread's back.
+         */
+        virtio_clear_feature_ex(features, VIRTIO_NET_F_RSS);
+        virtio_clear_feature_ex(features, VIRTIO_NET_F_HASH_REPORT);
+        virtio_clear_feature_ex(features, VIRTIO_NET_F_RSC_EXT);
+        virtio_clear_feature_ex(features, VIRTIO_F_RING_RESET);
+    }
+
     if (!get_vhost_net(nc->peer)) {
         if (!use_own_hash) {
             virtio_clear_feature_ex(features, VIRTIO_NET_F_HASH_REPORT);
@@ -3890,6 +4027,141 @@ static bool failover_hide_primary_device(DeviceListener *listener,
     return qatomic_read(&n->failover_primary_hidden);
 }
 
+/* Context: BQL held */
+static bool virtio_net_vq_aio_context_init(VirtIONet *n, Error **errp)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    BusState *qbus = BUS(qdev_get_parent_bus(DEVICE(vdev)));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    g_autofree AioContext **vq_aio_context = NULL;
+    int i;
+
+    if (!n->net_conf.iothread_vq_mapping_list) {
+        for (i = 0; i < n->max_queue_pairs; i++) {
+            n->vqs[i].ctx = qemu_get_aio_context();
+        }
+        return true;
+    }
+
+    if (!k->set_guest_notifiers || !k->ioeventfd_assign) {
+        error_setg(errp,
+                   "device is incompatible with iothread-vq-mapping "
+                   "(transport does not support notifiers)");
+        return false;
+    }
+    if (!virtio_device_ioeventfd_enabled(vdev)) {
+        error_setg(errp, "ioeventfd is required for iothread-vq-mapping");
+        return false;
+    }
+    if (n->net_conf.tx && !strcmp(n->net_conf.tx, "timer")) {
+        error_setg(errp, "iothread-vq-mapping requires tx=bh");
+        return false;
+    }
+
+    for (i = 0; i < n->max_queue_pairs; i++) {
+        NetClientState *peer = n->nic_conf.peers.ncs[i];
+
+        if (get_vhost_net(peer)) {
+            error_setg(errp, "iothread-vq-mapping cannot be used with vhost");
+            return false;
+        }
+        /* Filters such as colo-compare only work in the main loop */
+        if (peer && !QTAILQ_EMPTY(&peer->filters)) {
+            error_setg(errp, "iothread-vq-mapping cannot be used with "
+                       "net filters");
+            return false;
+        }
+        if (!qemu_can_set_aio_context(peer)) {
+            error_setg(errp, "iothread-vq-mapping requires a netdev that "
+                       "can run in an IOThread, such as tap");
+            return false;
+        }
+    }
+
+    /* Each entry of the mapping refers to a queue pair */
+    vq_aio_context = g_new(AioContext *, n->max_queue_pairs);
+    if (!iothread_vq_mapping_apply(n->net_conf.iothread_vq_mapping_list,
+                                   vq_aio_context, n->max_queue_pairs,
+                                   errp)) {
+        return false;
+    }
+
+    for (i = 0; i < n->max_queue_pairs; i++) {
+        n->vqs[i].ctx = vq_aio_context[i];
+        /* Keeps filters from being added later */
+        n->nic_conf.peers.ncs[i]->uses_iothread = true;
+    }
+
+    /* Masking is left to the transport, the callbacks only handle vhost */
+    vdev->use_guest_notifier_mask = false;
+    return true;
+}
+
+/* Context: BQL held */
+static int virtio_net_start_ioeventfd(VirtIODevice *vdev)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    BusState *qbus = qdev_get_parent_bus(DEVICE(vdev));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+    int queue_pairs = n->multiqueue ? n->max_queue_pairs : 1;
+    int nvqs = virtio_get_num_queues(vdev);
+    int i, r;
+
+    if (!virtio_net_uses_iothreads(n)) {
+        return virtio_device_start_ioeventfd_impl(vdev);
+    }
+
+    /* IOThreads raise interrupts through the guest notifiers */
+    r = k->set_guest_notifiers(qbus->parent, nvqs, true);
+    if (r != 0) {
+        error_report("virtio-net failed to set guest notifier (%d), "
+                     "ensure -accel kvm is set.", r);
+        return r;
+    }
+
+    r = virtio_device_start_ioeventfd_impl(vdev);
+    if (r < 0) {
+        k->set_guest_notifiers(qbus->parent, nvqs, false);
+        return r;
+    }
+
+    /* Only the control virtqueue stays in the main loop */
+    for (i = 0; i < queue_pairs; i++) {
+        event_notifier_set_handler(
+            virtio_queue_get_host_notifier(n->vqs[i].rx_vq), NULL);
+        event_notifier_set_handler(
+            virtio_queue_get_host_notifier(n->vqs[i].tx_vq), NULL);
+    }
+
+    n->ioeventfd_started = true;
+    if (!n->ioeventfd_quiesce_depth) {
+        virtio_net_ioeventfd_attach(n);
+    }
+    return 0;
+}
+
+/* Context: BQL held */
+static void virtio_net_stop_ioeventfd(VirtIODevice *vdev)
+{
+    VirtIONet *n = VIRTIO_NET(vdev);
+    BusState *qbus = qdev_get_parent_bus(DEVICE(vdev));
+    VirtioBusClass *k = VIRTIO_BUS_GET_CLASS(qbus);
+
+    if (!virtio_net_uses_iothreads(n)) {
+        virtio_device_stop_ioeventfd_impl(vdev);
+        return;
+    }
+
+    if (virtio_net_iothreads_running(n)) {
+        virtio_net_ioeventfd_detach(n);
+    }
+    n->ioeventfd_started = false;
+
+    /* Requests kicked after the detach are picked up by the main loop */
+    virtio_device_stop_ioeventfd_impl(vdev);
+    k->set_guest_notifiers(qbus->parent, virtio_get_num_queues(vdev), false);
+}
+
 static void virtio_net_device_realize(DeviceState *dev, Error **errp)
 {
     VirtIODevice *vdev = VIRTIO_DEVICE(dev);
@@ -3999,6 +4271,12 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
     n->net_conf.tx_queue_size = MIN(virtio_net_max_tx_queue_size(n),
                                     n->net_conf.tx_queue_size);
 
+    if (!virtio_net_vq_aio_context_init(n, errp)) {
+        g_free(n->vqs);
+        virtio_cleanup(vdev);
+        return;
+    }
+
     virtio_net_add_queue(n, 0);
 
     n->ctrl_vq = virtio_add_queue(vdev, 64, virtio_net_handle_ctrl);
@@ -4111,7 +4389,15 @@ static void virtio_net_device_unrealize(DeviceState *dev)
     virtio_del_queue(vdev, max_queue_pairs * 2);
     qemu_announce_timer_del(&n->announce_timer, false);
     g_free(n->vqs);
+    if (n->net_conf.iothread_vq_mapping_list) {
+        for (i = 0; i < n->max_queue_pairs; i++) {
+            n->nic_conf.peers.ncs[i]->uses_iothread = false;
+        }
+    }
     qemu_del_nic(n->nic);
+    if (n->net_conf.iothread_vq_mapping_list) {
+        iothread_vq_mapping_cleanup(n->net_conf.iothread_vq_mapping_list);
+    }
     virtio_net_rsc_cleanup(n);
     g_free(n->rss_data.indirections_table);
     net_rx_pkt_uninit(n->rx_pkt);
@@ -4270,6 +4556,8 @@ static const Property virtio_net_properties[] = {
                        TX_TIMER_INTERVAL),
     DEFINE_PROP_INT32("x-txburst", VirtIONet, net_conf.txburst, TX_BURST),
     DEFINE_PROP_STRING("tx", VirtIONet, net_conf.tx),
+    DEFINE_PROP_IOTHREAD_VQ_MAPPING_LIST("iothread-vq-mapping", VirtIONet,
+                                         net_conf.iothread_vq_mapping_list),
     DEFINE_PROP_UINT16("rx_queue_size", VirtIONet, net_conf.rx_queue_size,
                        VIRTIO_NET_RX_QUEUE_DEFAULT_SIZE),
     DEFINE_PROP_UINT16("tx_queue_size", VirtIONet, net_conf.tx_queue_size,
@@ -4357,6 +4645,8 @@ static void virtio_net_class_init(ObjectClass *klass, const void *data)
     vdc->queue_reset = virtio_net_queue_reset;
     vdc->queue_enable = virtio_net_queue_enable;
     vdc->set_status = virtio_net_set_status;
+    vdc->start_ioeventfd = virtio_net_start_ioeventfd;
+    vdc->stop_ioeventfd = virtio_net_stop_ioeventfd;
     vdc->guest_notifier_mask = virtio_net_guest_notifier_mask;
     vdc->guest_notifier_pending = virtio_net_guest_notifier_pending;
     vdc->legacy_features |= (0x1 << VIRTIO_NET_F_GSO);
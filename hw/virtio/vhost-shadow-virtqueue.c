@@ -39,6 +39,7 @@ bool vhost_svq_valid_features(uint64_t features, Error **errp)
         case VIRTIO_RING_F_EVENT_IDX:
         case VIRTIO_RING_F_INDIRECT_DESC:
         case VIRTIO_F_IN_ORDER:
+        case VIRTIO_F_RING_PACKED:
             continue;
 
         case VIRTIO_F_ACCESS_PLATFORM:
@@ -283,7 +284,115 @@ static bool vhost_svq_add_split(VhostShadowVirtqueue *svq,
     return true;
 }
 
-static void vhost_svq_kick(VhostShadowVirtqueue *svq)
+static bool vhost_svq_add_packed(VhostShadowVirtqueue *svq,
+                                 const struct iovec *out_sg, size_t out_num,
+                                 const hwaddr *out_addr,
+                                 const struct iovec *in_sg, size_t in_num,
+                                 const hwaddr *in_addr, unsigned *head)
+{
+    struct vring_packed_desc *descs = svq->vring_packed.desc;
+    uint16_t avail_used_flags = svq->avail_used_flags;
+    uint16_t i = svq->shadow_avail_idx, head_idx = i;
+    uint16_t head_flags = 0;
+    size_t num = out_num + in_num;
+    bool ok;
+    g_autofree hwaddr *sgs = g_new(hwaddr, num);
+
+    *head = svq->free_head;
+
+    /* We need some descriptors here */
+    if (unlikely(!num)) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "Guest provided element with no descriptors");
+        return false;
+    }
+
+    ok = vhost_svq_translate_addr(svq, sgs, out_sg, out_num, out_addr);
+    if (unlikely(!ok)) {
+        return false;
+    }
+
+    ok = vhost_svq_translate_addr(svq, sgs + out_num, in_sg, in_num, in_addr);
+    if (unlikely(!ok)) {
+        return false;
+    }
+
+    for (size_t n = 0; n < num; n++) {
+        const struct iovec *iov = n < out_num ? &out_sg[n]
+                                              : &in_sg[n - out_num];
+        uint16_t flags = avail_used_flags;
+
+        if (n >= out_num) {
+            flags |= VRING_DESC_F_WRITE;
+        }
+        if (n + 1 < num) {
+            flags |= VRING_DESC_F_NEXT;
+        }
+
+        descs[i].addr = cpu_to_le64(sgs[n]);
+        descs[i].len = cpu_to_le32(iov->iov_len);
+        descs[i].id = cpu_to_le16(*head);
+        if (n == 0) {
+            /* Written last, so the device never sees a partial chain */
+            head_flags = flags;
+        } else {
+            descs[i].flags = cpu_to_le16(flags);
+        }
+
+        if (++i == svq->vring.num) {
+            i = 0;
+            avail_used_flags ^= 1 << VRING_PACKED_DESC_F_AVAIL |
+                                1 << VRING_PACKED_DESC_F_USED;
+        }
+    }
+
+    svq->shadow_avail_idx = i;
+    svq->avail_used_flags = avail_used_flags;
+    svq->avail_wrap_counter = avail_used_flags &
+                              (1 << VRING_PACKED_DESC_F_AVAIL);
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
+        /* Buffer ids are the position of their first descriptor */
+        svq->free_head = i;
+    } else {
+        svq->free_head = svq->desc_state[*head].next;
+    }
+
+    /* Update the head flags after write the rest of the chain */
+    smp_wmb();
+    descs[head_idx].flags = cpu_to_le16(head_flags);
+
+    return true;
+}
+
+/*
+ * Check the device event suppression structure of a packed vq
+ *
+ * @svq: Shadow Virtqueue
+ * @ndescs: Number of descriptors exposed since the last check
+ */
+static bool vhost_svq_packed_needs_kick(const VhostShadowVirtqueue *svq,
+                                        uint16_t ndescs)
+{
+    const struct vring_packed_desc_event *device = svq->vring_packed.device;
+    uint16_t flags = le16_to_cpu(qatomic_read(&device->flags));
+    uint16_t off_wrap, event_idx;
+    uint16_t new_idx = svq->shadow_avail_idx, old_idx = new_idx - ndescs;
+
+    if (flags != VRING_PACKED_EVENT_FLAG_DESC) {
+        return flags != VRING_PACKED_EVENT_FLAG_DISABLE;
+    }
+
+    off_wrap = le16_to_cpu(qatomic_read(&device->off_wrap));
+    event_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+    if ((off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR) !=
+        svq->avail_wrap_counter) {
+        event_idx -= svq->vring.num;
+    }
+
+    return vring_need_event(event_idx, new_idx, old_idx);
+}
+
+static void vhost_svq_kick(VhostShadowVirtqueue *svq, uint16_t ndescs)
 {
     bool needs_kick;
 
@@ -293,7 +402,9 @@ static void vhost_svq_kick(VhostShadowVirtqueue *svq)
      */
     smp_mb();
 
-    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        needs_kick = vhost_svq_packed_needs_kick(svq, ndescs);
+    } else if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
         uint16_t avail_event = le16_to_cpu(
                 *(uint16_t *)(&svq->vring.used->ring[svq->vring.num]));
         needs_kick = vring_need_event(avail_event, svq->shadow_avail_idx, svq->shadow_avail_idx - 1);
@@ -327,8 +438,13 @@ int vhost_svq_add(VhostShadowVirtqueue *svq, const struct iovec *out_sg,
         return -ENOSPC;
     }
 
-    ok = vhost_svq_add_split(svq, out_sg, out_num, out_addr, in_sg, in_num,
-                             in_addr, &qemu_head);
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        ok = vhost_svq_add_packed(svq, out_sg, out_num, out_addr, in_sg,
+                                  in_num, in_addr, &qemu_head);
+    } else {
+        ok = vhost_svq_add_split(svq, out_sg, out_num, out_addr, in_sg,
+                                 in_num, in_addr, &qemu_head);
+    }
     if (unlikely(!ok)) {
         return -EINVAL;
     }
@@ -339,7 +455,7 @@ int vhost_svq_add(VhostShadowVirtqueue *svq, const struct iovec *out_sg,
     if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
         svq->desc_state[qemu_head].in_bytes = iov_size(in_sg, in_num);
     }
-    vhost_svq_kick(svq);
+    vhost_svq_kick(svq, ndescs);
     return 0;
 }
 
@@ -431,6 +547,17 @@ static void vhost_handle_guest_kick_notifier(EventNotifier *n)
     vhost_handle_guest_kick(svq);
 }
 
+static bool vhost_svq_more_used_packed(const VhostShadowVirtqueue *svq)
+{
+    const struct vring_packed_desc *desc =
+        &svq->vring_packed.desc[svq->last_used_idx];
+    uint16_t flags = le16_to_cpu(qatomic_read(&desc->flags));
+    bool avail = flags & (1 << VRING_PACKED_DESC_F_AVAIL);
+    bool used = flags & (1 << VRING_PACKED_DESC_F_USED);
+
+    return avail == used && used == svq->used_wrap_counter;
+}
+
 static bool vhost_svq_more_used(VhostShadowVirtqueue *svq)
 {
     uint16_t *used_idx = &svq->vring.used->idx;
@@ -440,6 +567,10 @@ static bool vhost_svq_more_used(VhostShadowVirtqueue *svq)
         return true;
     }
 
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        return vhost_svq_more_used_packed(svq);
+    }
+
     if (svq->last_used_idx != svq->shadow_used_idx) {
         return true;
     }
@@ -460,7 +591,21 @@ static bool vhost_svq_more_used(VhostShadowVirtqueue *svq)
  */
 static bool vhost_svq_enable_notification(VhostShadowVirtqueue *svq)
 {
-    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        struct vring_packed_desc_event *driver = svq->vring_packed.driver;
+
+        if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+            uint16_t off_wrap = svq->last_used_idx |
+                    svq->used_wrap_counter << VRING_PACKED_EVENT_F_WRAP_CTR;
+
+            driver->off_wrap = cpu_to_le16(off_wrap);
+            /* Make sure off_wrap is visible before flags */
+            smp_wmb();
+            driver->flags = cpu_to_le16(VRING_PACKED_EVENT_FLAG_DESC);
+        } else {
+            driver->flags = cpu_to_le16(VRING_PACKED_EVENT_FLAG_ENABLE);
+        }
+    } else if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
         uint16_t *used_event = (uint16_t *)&svq->vring.avail->ring[svq->vring.num];
         *used_event = cpu_to_le16(svq->shadow_used_idx);
     } else {
@@ -474,6 +619,12 @@ static bool vhost_svq_enable_notification(VhostShadowVirtqueue *svq)
 
 static void vhost_svq_disable_notification(VhostShadowVirtqueue *svq)
 {
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        svq->vring_packed.driver->flags =
+            cpu_to_le16(VRING_PACKED_EVENT_FLAG_DISABLE);
+        return;
+    }
+
     /*
      * No need to disable notification in the event idx case, since used event
      * index is already an index too far away.
@@ -543,6 +694,76 @@ static int32_t vhost_svq_get_last_used_split_in_order(
     return last_used;
 }
 
+/*
+ * Move forward the used position of a packed vq past a buffer.
+ *
+ * @svq: Shadow VirtQueue
+ * @ndescs: Number of descriptors of the buffer
+ */
+static void vhost_svq_packed_skip_used(VhostShadowVirtqueue *svq,
+                                       uint16_t ndescs)
+{
+    svq->last_used_idx += ndescs;
+    if (svq->last_used_idx >= svq->vring.num) {
+        svq->last_used_idx -= svq->vring.num;
+        svq->used_wrap_counter = !svq->used_wrap_counter;
+    }
+}
+
+/*
+ * Gets the next buffer id and moves forward the used position, so the next
+ * time SVQ calls this function will get the next one.  Packed vq version.
+ *
+ * With IN_ORDER the device may write a single used descriptor for a batch of
+ * buffers, so the buffers are returned in the order they were made available
+ * until the one of the used descriptor is reached.
+ *
+ * @svq: Shadow VirtQueue
+ * @len: Consumed length by the device.
+ *
+ * Return the next buffer id consumed by the device, or -1 on error.
+ */
+static int32_t vhost_svq_get_last_used_packed(VhostShadowVirtqueue *svq,
+                                              uint32_t *len)
+{
+    const struct vring_packed_desc *desc =
+        &svq->vring_packed.desc[svq->last_used_idx];
+    uint16_t id, ndescs;
+
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
+        if (svq->batch_last.id == VIRTIO_RING_NOT_IN_BATCH) {
+            svq->batch_last.id = le16_to_cpu(desc->id);
+            svq->batch_last.len = le32_to_cpu(desc->len);
+        }
+
+        id = svq->last_used;
+        if (svq->batch_last.id == id) {
+            svq->batch_last.id = VIRTIO_RING_NOT_IN_BATCH;
+            *len = svq->batch_last.len;
+        } else {
+            *len = svq->desc_state[id].in_bytes;
+        }
+    } else {
+        id = le16_to_cpu(desc->id);
+        *len = le32_to_cpu(desc->len);
+    }
+
+    if (unlikely(id >= svq->vring.num || !svq->desc_state[id].ndescs)) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+            "Device %s says id %u is used, but it was not available",
+            svq->vdev->name, id);
+        svq->batch_last.id = VIRTIO_RING_NOT_IN_BATCH;
+        return -1;
+    }
+
+    ndescs = svq->desc_state[id].ndescs;
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
+        svq->last_used = (id + ndescs) % svq->vring.num;
+    }
+    vhost_svq_packed_skip_used(svq, ndescs);
+    return id;
+}
+
 static uint16_t vhost_svq_last_desc_of_chain(const VhostShadowVirtqueue *svq,
                                              uint16_t num, uint16_t i)
 {
@@ -566,6 +787,16 @@ static VirtQueueElement *vhost_svq_detach_buf_split(VhostShadowVirtqueue *svq,
     return g_steal_pointer(&svq->desc_state[id].elem);
 }
 
+G_GNUC_WARN_UNUSED_RESULT
+static VirtQueueElement *vhost_svq_detach_buf_packed(VhostShadowVirtqueue *svq,
+                                                     uint16_t id)
+{
+    svq->desc_state[id].next = svq->free_head;
+    svq->free_head = id;
+
+    return g_steal_pointer(&svq->desc_state[id].elem);
+}
+
 G_GNUC_WARN_UNUSED_RESULT
 static VirtQueueElement *vhost_svq_detach_buf_split_in_order(
         VhostShadowVirtqueue *svq,
@@ -588,6 +819,8 @@ static VirtQueueElement *vhost_svq_detach_buf(VhostShadowVirtqueue *svq,
 {
     if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
         return vhost_svq_detach_buf_split_in_order(svq, id);
+    } else if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        return vhost_svq_detach_buf_packed(svq, id);
     } else {
         return vhost_svq_detach_buf_split(svq, id);
     }
@@ -606,7 +839,14 @@ static VirtQueueElement *vhost_svq_get_buf(VhostShadowVirtqueue *svq,
     /* Only get used array entries after they have been exposed by dev */
     smp_rmb();
 
-    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        int32_t r = vhost_svq_get_last_used_packed(svq, len);
+        if (r < 0) {
+            return NULL;
+        }
+
+        last_used = r;
+    } else if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
         int32_t r;
         r = vhost_svq_get_last_used_split_in_order(svq, len);
         if (r < 0) {
@@ -776,9 +1016,50 @@ void vhost_svq_set_svq_call_fd(VhostShadowVirtqueue *svq, int call_fd)
 void vhost_svq_get_vring_addr(const VhostShadowVirtqueue *svq,
                               struct vhost_vring_addr *addr)
 {
-    addr->desc_user_addr = (uint64_t)(uintptr_t)svq->vring.desc;
-    addr->avail_user_addr = (uint64_t)(uintptr_t)svq->vring.avail;
-    addr->used_user_addr = (uint64_t)(uintptr_t)svq->vring.used;
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        addr->desc_user_addr = (uint64_t)(uintptr_t)svq->vring_packed.desc;
+        addr->avail_user_addr = (uint64_t)(uintptr_t)svq->vring_packed.driver;
+        addr->used_user_addr = (uint64_t)(uintptr_t)svq->vring_packed.device;
+    } else {
+        addr->desc_user_addr = (uint64_t)(uintptr_t)svq->vring.desc;
+        addr->avail_user_addr = (uint64_t)(uintptr_t)svq->vring.avail;
+        addr->used_user_addr = (uint64_t)(uintptr_t)svq->vring.used;
+    }
+}
+
+static void *vhost_svq_driver_area(const VhostShadowVirtqueue *svq)
+{
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        return svq->vring_packed.driver;
+    }
+    return svq->vring.desc;
+}
+
+/*
+ * The packed vq descriptor ring is written by the device too, so it lives in
+ * the device area.
+ */
+static void *vhost_svq_device_area(const VhostShadowVirtqueue *svq)
+{
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        return svq->vring_packed.desc;
+    }
+    return svq->vring.used;
+}
+
+/**
+ * Get the start of the shadow vq areas that are only read by the device
+ * (driver area) and written by the device (device area).
+ *
+ * @svq: Shadow virtqueue
+ * @driver_addr: Destination to store the driver area address
+ * @device_addr: Destination to store the device area address
+ */
+void vhost_svq_get_area_addr(const VhostShadowVirtqueue *svq,
+                             uint64_t *driver_addr, uint64_t *device_addr)
+{
+    *driver_addr = (uint64_t)(uintptr_t)vhost_svq_driver_area(svq);
+    *device_addr = (uint64_t)(uintptr_t)vhost_svq_device_area(svq);
 }
 
 size_t vhost_svq_driver_area_size(const VhostShadowVirtqueue *svq)
@@ -787,6 +1068,11 @@ size_t vhost_svq_driver_area_size(const VhostShadowVirtqueue *svq)
     size_t avail_size = offsetof(vring_avail_t, ring[svq->vring.num]) +
                                                               sizeof(uint16_t);
 
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        return ROUND_UP(sizeof(struct vring_packed_desc_event),
+                        qemu_real_host_page_size());
+    }
+
     return ROUND_UP(desc_size + avail_size, qemu_real_host_page_size());
 }
 
@@ -794,6 +1080,14 @@ size_t vhost_svq_device_area_size(const VhostShadowVirtqueue *svq)
 {
     size_t used_size = offsetof(vring_used_t, ring[svq->vring.num]) +
                                                               sizeof(uint16_t);
+
+    if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_RING_PACKED)) {
+        size_t desc_size = sizeof(struct vring_packed_desc) * svq->vring.num;
+
+        return ROUND_UP(desc_size + sizeof(struct vring_packed_desc_event),
+                        qemu_real_host_page_size());
+    }
+
     return ROUND_UP(used_size, qemu_real_host_page_size());
 }
 
@@ -847,20 +1141,36 @@ void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
     memset(&svq->batch_last, 0, sizeof(svq->batch_last));
     svq->last_used = 0;
     svq->last_used_idx = 0;
+    svq->free_head = 0;
+    svq->avail_used_flags = 1 << VRING_PACKED_DESC_F_AVAIL;
+    svq->avail_wrap_counter = true;
+    svq->used_wrap_counter = true;
     svq->vdev = vdev;
     svq->vq = vq;
     svq->iova_tree = iova_tree;
 
     svq->vring.num = virtio_queue_get_num(vdev, virtio_get_queue_index(vq));
     svq->num_free = svq->vring.num;
-    svq->vring.desc = mmap(NULL, vhost_svq_driver_area_size(svq),
-                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
-                           -1, 0);
-    desc_size = sizeof(vring_desc_t) * svq->vring.num;
-    svq->vring.avail = (void *)((char *)svq->vring.desc + desc_size);
-    svq->vring.used = mmap(NULL, vhost_svq_device_area_size(svq),
-                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
-                           -1, 0);
+    if (virtio_vdev_has_feature(vdev, VIRTIO_F_RING_PACKED)) {
+        svq->vring_packed.driver = mmap(NULL, vhost_svq_driver_area_size(svq),
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        desc_size = sizeof(struct vring_packed_desc) * svq->vring.num;
+        svq->vring_packed.desc = mmap(NULL, vhost_svq_device_area_size(svq),
+                                      PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        svq->vring_packed.device = (void *)((char *)svq->vring_packed.desc +
+                                            desc_size);
+    } else {
+        svq->vring.desc = mmap(NULL, vhost_svq_driver_area_size(svq),
+                               PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        desc_size = sizeof(vring_desc_t) * svq->vring.num;
+        svq->vring.avail = (void *)((char *)svq->vring.desc + desc_size);
+        svq->vring.used = mmap(NULL, vhost_svq_device_area_size(svq),
+                               PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    }
     svq->desc_state = g_new0(SVQDescState, svq->vring.num);
     if (virtio_vdev_has_feature(svq->vdev, VIRTIO_F_IN_ORDER)) {
         svq->batch_last.id = VIRTIO_RING_NOT_IN_BATCH;
@@ -905,8 +1215,8 @@ void vhost_svq_stop(VhostShadowVirtqueue *svq)
     }
     svq->vq = NULL;
     g_free(svq->desc_state);
-    munmap(svq->vring.desc, vhost_svq_driver_area_size(svq));
-    munmap(svq->vring.used, vhost_svq_device_area_size(svq));
+    munmap(vhost_svq_driver_area(svq), vhost_svq_driver_area_size(svq));
+    munmap(vhost_svq_device_area(svq), vhost_svq_device_area_size(svq));
     event_notifier_set_handler(&svq->hdev_call, NULL);
 }
 
@@ -27,13 +27,14 @@ typedef struct SVQDescState {
     union {
         /*
          * Total length of the available buffer that is writable by the device.
-         * Only used in packed vq.
+         * Only used with IN_ORDER.
          */
         uint32_t in_bytes;
 
         /*
          * Backup next field for each descriptor so we can recover securely, not
-         * needing to trust the device access.  Only used in split vq.
+         * needing to trust the device access.  In packed vq it links the free
+         * buffer ids instead.  Only used without IN_ORDER.
          */
         uint16_t next;
     };
@@ -62,9 +63,16 @@ typedef struct VhostShadowVirtqueueOps {
 
 /* Shadow virtqueue to relay notifications */
 typedef struct VhostShadowVirtqueue {
-    /* Shadow vring */
+    /* Shadow vring.  Only vring.num is used in packed vq */
     struct vring vring;
 
+    /* Shadow packed vring, if VIRTIO_F_RING_PACKED */
+    struct {
+        struct vring_packed_desc *desc;
+        struct vring_packed_desc_event *driver;
+        struct vring_packed_desc_event *device;
+    } vring_packed;
+
     /* Shadow kick notifier, sent to vhost */
     EventNotifier hdev_kick;
     /* Shadow call notifier, sent to vhost */
@@ -104,9 +112,19 @@ typedef struct VhostShadowVirtqueue {
     /* Caller callbacks opaque */
     void *ops_opaque;
 
-    /* Next head to expose to the device */
+    /*
+     * Next head to expose to the device.  In packed vq this is the next
+     * descriptor ring position.
+     */
     uint16_t shadow_avail_idx;
 
+    /* Packed vq avail and used flags for the next exposed descriptor */
+    uint16_t avail_used_flags;
+
+    /* Packed vq driver and device ring wrap counters */
+    bool avail_wrap_counter;
+    bool used_wrap_counter;
+
     /*
      * Next free descriptor.
      *
@@ -123,13 +141,16 @@ typedef struct VhostShadowVirtqueue {
      */
     vring_used_elem_t batch_last;
 
-    /* Last used id if IN_ORDER and split vq */
+    /* Last used id if IN_ORDER */
     uint16_t last_used;
 
-    /* Last seen used idx */
+    /* Last seen used idx.  Only used in split vq */
     uint16_t shadow_used_idx;
 
-    /* Next head to consume from the device */
+    /*
+     * Next head to consume from the device.  In packed vq this is the next
+     * descriptor ring position.
+     */
     uint16_t last_used_idx;
 
     /* Size of SVQ vring free descriptors */
@@ -151,6 +172,8 @@ void vhost_svq_set_svq_kick_fd(VhostShadowVirtqueue *svq, int svq_kick_fd);
 void vhost_svq_set_svq_call_fd(VhostShadowVirtqueue *svq, int call_fd);
 void vhost_svq_get_vring_addr(const VhostShadowVirtqueue *svq,
                               struct vhost_vring_addr *addr);
+void vhost_svq_get_area_addr(const VhostShadowVirtqueue *svq,
+                             uint64_t *driver_addr, uint64_t *device_addr);
 size_t vhost_svq_driver_area_size(const VhostShadowVirtqueue *svq);
 size_t vhost_svq_device_area_size(const VhostShadowVirtqueue *svq);
 
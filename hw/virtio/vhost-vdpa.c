@@ -1146,13 +1146,13 @@ static void vhost_vdpa_svq_unmap_rings(struct vhost_dev *dev,
                                        const VhostShadowVirtqueue *svq)
 {
     struct vhost_vdpa *v = dev->opaque;
-    struct vhost_vring_addr svq_addr;
+    uint64_t driver_addr, device_addr;
 
-    vhost_svq_get_vring_addr(svq, &svq_addr);
+    vhost_svq_get_area_addr(svq, &driver_addr, &device_addr);
 
-    vhost_vdpa_svq_unmap_ring(v, svq_addr.desc_user_addr);
+    vhost_vdpa_svq_unmap_ring(v, driver_addr);
 
-    vhost_vdpa_svq_unmap_ring(v, svq_addr.used_user_addr);
+    vhost_vdpa_svq_unmap_ring(v, device_addr);
 }
 
 /**
@@ -1192,6 +1192,22 @@ static bool vhost_vdpa_svq_map_ring(struct vhost_vdpa *v, DMAMap *needle,
     return r == 0;
 }
 
+/*
+ * Translate a SVQ ring address to the IOVA of the mapped area that contains it
+ */
+static uint64_t vhost_vdpa_svq_ring_iova(const DMAMap *driver_region,
+                                         const DMAMap *device_region,
+                                         uint64_t addr)
+{
+    const DMAMap *region = device_region;
+
+    if (addr - driver_region->translated_addr <= driver_region->size) {
+        region = driver_region;
+    }
+
+    return region->iova + (addr - region->translated_addr);
+}
+
 /**
  * Map the shadow virtqueue rings in the device
  *
@@ -1211,38 +1227,45 @@ static bool vhost_vdpa_svq_map_rings(struct vhost_dev *dev,
     struct vhost_vdpa *v = dev->opaque;
     size_t device_size = vhost_svq_device_area_size(svq);
     size_t driver_size = vhost_svq_driver_area_size(svq);
-    size_t avail_offset;
+    uint64_t driver_addr, device_addr;
     bool ok;
 
     vhost_svq_get_vring_addr(svq, &svq_addr);
+    vhost_svq_get_area_addr(svq, &driver_addr, &device_addr);
 
     driver_region = (DMAMap) {
         .size = driver_size - 1,
         .perm = IOMMU_RO,
     };
-    ok = vhost_vdpa_svq_map_ring(v, &driver_region, svq_addr.desc_user_addr,
-                                 errp);
+    ok = vhost_vdpa_svq_map_ring(v, &driver_region, driver_addr, errp);
     if (unlikely(!ok)) {
         error_prepend(errp, "Cannot create vq driver region: ");
         return false;
     }
-    addr->desc_user_addr = driver_region.iova;
-    avail_offset = svq_addr.avail_user_addr - svq_addr.desc_user_addr;
-    addr->avail_user_addr = driver_region.iova + avail_offset;
 
     device_region = (DMAMap) {
         .size = device_size - 1,
         .perm = IOMMU_RW,
     };
-    ok = vhost_vdpa_svq_map_ring(v, &device_region, svq_addr.used_user_addr,
-                                 errp);
+    ok = vhost_vdpa_svq_map_ring(v, &device_region, device_addr, errp);
     if (unlikely(!ok)) {
         error_prepend(errp, "Cannot create vq device region: ");
         vhost_vdpa_svq_unmap_ring(v, driver_region.translated_addr);
+        return false;
     }
-    addr->used_user_addr = device_region.iova;
 
-    return ok;
+    /* The packed vq descriptor ring is in the device region */
+    addr->desc_user_addr = vhost_vdpa_svq_ring_iova(&driver_region,
+                                                    &device_region,
+                                                    svq_addr.desc_user_addr);
+    addr->avail_user_addr = vhost_vdpa_svq_ring_iova(&driver_region,
+                                                     &device_region,
+                                                     svq_addr.avail_user_addr);
+    addr->used_user_addr = vhost_vdpa_svq_ring_iova(&driver_region,
+                                                    &device_region,
+                                                    svq_addr.used_user_addr);
+
+    return true;
 }
 
 static bool vhost_vdpa_svq_setup(struct vhost_dev *dev,
@@ -1255,6 +1278,14 @@ static bool vhost_vdpa_svq_setup(struct vhost_dev *dev,
     };
     int r;
 
+    if (virtio_vdev_has_feature(dev->vdev, VIRTIO_F_RING_PACKED)) {
+        /*
+         * Both wrap counters start set, see
+         * virtio_queue_packed_get_last_avail_idx() for the encoding
+         */
+        s.num = 1U << 15 | 1U << 31;
+    }
+
     r = vhost_vdpa_set_dev_vring_base(dev, &s);
     if (unlikely(r)) {
         error_setg_errno(errp, -r, "Cannot set vring base");
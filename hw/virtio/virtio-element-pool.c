@@ -0,0 +1,155 @@
+/*
+ * Pool of virtqueue elements
+ *
+ * Elements are recycled instead of being allocated with g_malloc() for
+ * each request.  Only the thread that pops from the virtqueue allocates
+ * from the pool, but elements may be freed from any thread: they go to a
+ * lock-free list that the popping thread takes over when its own list is
+ * empty.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/queue.h"
+#include "hw/virtio/virtio.h"
+
+/* A pooled element waiting to be reused, linked through its first bytes */
+typedef struct VirtQueueFreeElement {
+    QSLIST_ENTRY(VirtQueueFreeElement) next;
+} VirtQueueFreeElement;
+
+struct VirtQueueElementPool {
+    size_t sz;
+    size_t slot_size;
+    unsigned int max_sg;
+
+    /* Elements in use, plus one until the pool is disabled */
+    unsigned int refcnt;
+    bool disabled;
+
+    /* Only accessed by the thread that allocates from the pool */
+    QSLIST_HEAD(, VirtQueueFreeElement) free;
+    /* Filled by virtqueue_element_free() from any thread */
+    QSLIST_HEAD(, VirtQueueFreeElement) returned;
+};
+
+static size_t virtqueue_element_size(size_t sz, unsigned num_sg)
+{
+    VirtQueueElement *elem;
+    size_t addr_end = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0])) +
+                      num_sg * sizeof(elem->in_addr[0]);
+
+    return QEMU_ALIGN_UP(addr_end, __alignof__(elem->in_sg[0])) +
+           num_sg * sizeof(elem->in_sg[0]);
+}
+
+VirtQueueElementPool *virtqueue_element_pool_new(size_t sz,
+                                                 unsigned int max_sg)
+{
+    VirtQueueElementPool *pool = g_new0(VirtQueueElementPool, 1);
+
+    assert(sz >= sizeof(VirtQueueElement));
+    assert(max_sg > 0 && max_sg <= VIRTQUEUE_MAX_SIZE);
+
+    pool->sz = sz;
+    pool->max_sg = max_sg;
+    pool->slot_size = virtqueue_element_size(sz, max_sg);
+    pool->refcnt = 1;
+    QSLIST_INIT(&pool->free);
+    QSLIST_INIT(&pool->returned);
+    return pool;
+}
+
+static void virtqueue_element_pool_release(VirtQueueElementPool *pool)
+{
+    VirtQueueFreeElement *free_elem, *next;
+
+    QSLIST_MOVE_ATOMIC(&pool->free, &pool->returned);
+    QSLIST_FOREACH_SAFE(free_elem, &pool->free, next, next) {
+        g_free(free_elem);
+    }
+    QSLIST_INIT(&pool->free);
+}
+
+static void virtqueue_element_pool_unref(VirtQueueElementPool *pool)
+{
+    if (qatomic_fetch_dec(&pool->refcnt) == 1) {
+        /* Frees that raced with disabling may have left elements behind */
+        virtqueue_element_pool_release(pool);
+        g_free(pool);
+    }
+}
+
+void virtqueue_element_pool_disable(VirtQueueElementPool *pool)
+{
+    qatomic_set(&pool->disabled, true);
+    virtqueue_element_pool_release(pool);
+    virtqueue_element_pool_unref(pool);
+}
+
+static void *virtqueue_element_pool_get(VirtQueueElementPool *pool)
+{
+    VirtQueueFreeElement *free_elem;
+
+    qatomic_inc(&pool->refcnt);
+    if (QSLIST_EMPTY(&pool->free)) {
+        QSLIST_MOVE_ATOMIC(&pool->free, &pool->returned);
+    }
+
+    free_elem = QSLIST_FIRST(&pool->free);
+    if (!free_elem) {
+        return g_malloc(pool->slot_size);
+    }
+    QSLIST_REMOVE_HEAD(&pool->free, next);
+    return free_elem;
+}
+
+void *virtqueue_element_alloc(VirtQueueElementPool *pool, size_t sz,
+                              unsigned int out_num, unsigned int in_num)
+{
+    VirtQueueElement *elem;
+    size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
+    size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
+    size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
+    size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
+    size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
+    size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
+
+    assert(sz >= sizeof(VirtQueueElement));
+    if (pool && pool->sz == sz && out_num + in_num <= pool->max_sg) {
+        assert(out_sg_end <= pool->slot_size);
+        elem = virtqueue_element_pool_get(pool);
+        elem->pool = pool;
+    } else {
+        elem = g_malloc(out_sg_end);
+        elem->pool = NULL;
+    }
+    elem->out_num = out_num;
+    elem->in_num = in_num;
+    elem->in_addr = (void *)elem + in_addr_ofs;
+    elem->out_addr = (void *)elem + out_addr_ofs;
+    elem->in_sg = (void *)elem + in_sg_ofs;
+    elem->out_sg = (void *)elem + out_sg_ofs;
+    return elem;
+}
+
+void virtqueue_element_free(void *opaque)
+{
+    VirtQueueElement *elem = opaque;
+    VirtQueueElementPool *pool = elem->pool;
+
+    if (!pool) {
+        g_free(elem);
+        return;
+    }
+
+    if (qatomic_read(&pool->disabled)) {
+        g_free(elem);
+    } else {
+        QSLIST_INSERT_HEAD_ATOMIC(&pool->returned,
+                                  (VirtQueueFreeElement *)elem, next);
+    }
+    virtqueue_element_pool_unref(pool);
+}
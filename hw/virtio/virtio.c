@@ -156,6 +156,14 @@ struct VirtQueue
     EventNotifier host_notifier;
     bool host_notifier_enabled;
     QLIST_ENTRY(VirtQueue) node;
+
+    /* Element pool, see virtqueue_enable_element_pool() */
+    VirtQueueElementPool *elem_pool;
+
+    /* Completions filled by virtqueue_push() but not yet published */
+    unsigned int batch_count;
+    bool batch_notify;
+    int64_t batch_start_ns;
 };
 
 const char *virtio_device_names[] = {
@@ -1068,8 +1076,8 @@ static void virtqueue_packed_fill_desc(VirtQueue *vq,
 }
 
 /* Called within rcu_read_lock().  */
-void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
-                    unsigned int len, unsigned int idx)
+static void virtqueue_fill_used(VirtQueue *vq, const VirtQueueElement *elem,
+                                unsigned int len, unsigned int idx)
 {
     trace_virtqueue_fill(vq, elem, len, idx);
 
@@ -1207,7 +1215,7 @@ static void virtqueue_ordered_flush(VirtQueue *vq)
     vq->inuse -= ndescs;
 }
 
-void virtqueue_flush(VirtQueue *vq, unsigned int count)
+static void virtqueue_flush_used(VirtQueue *vq, unsigned int count)
 {
     if (virtio_device_disabled(vq->vdev)) {
         vq->inuse -= count;
@@ -1223,12 +1231,82 @@ void virtqueue_flush(VirtQueue *vq, unsigned int count)
     }
 }
 
+/*
+ * Completion batching
+ *
+ * Inside a defer_call_begin()/defer_call_end() section virtqueue_push() only
+ * fills the used ring.  All completions of the section are published with a
+ * single used index update when the section ends, followed by at most one
+ * notification.  Outside of a section completions are published
+ * immediately, as before.
+ *
+ * The device's x-completion-batch-age-us is checked by virtqueue_push()
+ * only: a completion that finds the batch older than that publishes it
+ * early, which keeps long sections from holding back many completions.
+ * It is not a latency bound, the last batch of a section always waits for
+ * the end of the section.
+ */
+static void virtqueue_batch_publish(VirtQueue *vq)
+{
+    unsigned int count = vq->batch_count;
+
+    if (!count) {
+        return;
+    }
+
+    trace_virtqueue_batch_publish(vq, count);
+    vq->batch_count = 0;
+    WITH_RCU_READ_LOCK_GUARD() {
+        virtqueue_flush_used(vq, count);
+    }
+
+    if (vq->batch_notify) {
+        vq->batch_notify = false;
+        virtio_notify(vq->vdev, vq);
+    }
+}
+
+static void virtqueue_batch_publish_deferred_fn(void *opaque)
+{
+    virtqueue_batch_publish(opaque);
+}
+
+void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
+                    unsigned int len, unsigned int idx)
+{
+    /* @idx is relative to the used index, so publish pending batches first */
+    virtqueue_batch_publish(vq);
+    virtqueue_fill_used(vq, elem, len, idx);
+}
+
+void virtqueue_flush(VirtQueue *vq, unsigned int count)
+{
+    virtqueue_batch_publish(vq);
+    virtqueue_flush_used(vq, count);
+}
+
 void virtqueue_push(VirtQueue *vq, const VirtQueueElement *elem,
                     unsigned int len)
 {
+    VirtIODevice *vdev = vq->vdev;
+
     RCU_READ_LOCK_GUARD();
-    virtqueue_fill(vq, elem, len, 0);
-    virtqueue_flush(vq, 1);
+    if (!vdev->completion_batch_age_us ||
+        virtio_vdev_has_feature(vdev, VIRTIO_F_IN_ORDER)) {
+        virtqueue_fill(vq, elem, len, 0);
+        virtqueue_flush(vq, 1);
+        return;
+    }
+
+    virtqueue_fill_used(vq, elem, len, vq->batch_count);
+    if (vq->batch_count++ == 0) {
+        vq->batch_start_ns = get_clock();
+        /* Called immediately when not inside a deferred section */
+        defer_call(virtqueue_batch_publish_deferred_fn, vq);
+    } else if (get_clock() - vq->batch_start_ns >=
+               vdev->completion_batch_age_us * SCALE_US) {
+        virtqueue_batch_publish(vq);
+    }
 }
 
 /* Called within rcu_read_lock().  */
@@ -1712,25 +1790,29 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
-static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+static void virtqueue_disable_element_pool(VirtQueue *vq)
+{
+    if (vq->elem_pool) {
+        virtqueue_element_pool_disable(vq->elem_pool);
+        vq->elem_pool = NULL;
+    }
+}
+
+void virtqueue_enable_element_pool(VirtQueue *vq, size_t sz,
+                                   unsigned int max_sg)
+{
+    virtqueue_disable_element_pool(vq);
+    vq->elem_pool = virtqueue_element_pool_new(sz, max_sg);
+}
+
+static void *virtqueue_alloc_element(VirtQueue *vq, size_t sz,
+                                     unsigned out_num, unsigned in_num)
 {
     VirtQueueElement *elem;
-    size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
-    size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
-    size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
-    size_t in_sg_ofs = QEMU_ALIGN_UP(out_addr_end, __alignof__(elem->in_sg[0]));
-    size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
-    size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
-
-    assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+
+    elem = virtqueue_element_alloc(vq ? vq->elem_pool : NULL, sz,
+                                   out_num, in_num);
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
-    elem->out_num = out_num;
-    elem->in_num = in_num;
-    elem->in_addr = (void *)elem + in_addr_ofs;
-    elem->out_addr = (void *)elem + out_addr_ofs;
-    elem->in_sg = (void *)elem + in_sg_ofs;
-    elem->out_sg = (void *)elem + out_sg_ofs;
     return elem;
 }
 
@@ -1849,7 +1931,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     elem->index = head;
     elem->ndescs = 1;
     for (i = 0; i < out_num; i++) {
@@ -1990,7 +2072,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_alloc_element(vq, sz, out_num, in_num);
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -2179,7 +2261,7 @@ void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz)
     assert(ARRAY_SIZE(data.in_addr) >= data.in_num);
     assert(ARRAY_SIZE(data.out_addr) >= data.out_num);
 
-    elem = virtqueue_alloc_element(sz, data.out_num, data.in_num);
+    elem = virtqueue_alloc_element(NULL, sz, data.out_num, data.in_num);
     elem->index = data.index;
 
     for (i = 0; i < elem->in_num; i++) {
@@ -2351,6 +2433,8 @@ static void __virtio_queue_reset(VirtIODevice *vdev, uint32_t i)
     vdev->vq[i].notification = true;
     vdev->vq[i].vring.num = vdev->vq[i].vring.num_default;
     vdev->vq[i].inuse = 0;
+    vdev->vq[i].batch_count = 0;
+    vdev->vq[i].batch_notify = false;
     virtio_virtqueue_reset_region_cache(&vdev->vq[i]);
 }
 
@@ -2604,6 +2688,7 @@ void virtio_delete_queue(VirtQueue *vq)
     vq->handle_output = NULL;
     g_free(vq->used_elems);
     vq->used_elems = NULL;
+    virtqueue_disable_element_pool(vq);
     virtio_virtqueue_reset_region_cache(vq);
 }
 
@@ -2749,6 +2834,12 @@ static void virtio_irq(VirtQueue *vq)
 
 void virtio_notify(VirtIODevice *vdev, VirtQueue *vq)
 {
+    if (vq->batch_count) {
+        /* Raised by virtqueue_batch_publish() */
+        vq->batch_notify = true;
+        return;
+    }
+
     WITH_RCU_READ_LOCK_GUARD() {
         if (!virtio_should_notify(vdev, vq)) {
             return;
@@ -4343,9 +4434,11 @@ static const Property virtio_properties[] = {
     DEFINE_PROP_BOOL("use-disabled-flag", VirtIODevice, use_disabled_flag, true),
     DEFINE_PROP_BOOL("x-disable-legacy-check", VirtIODevice,
                      disable_legacy_check, false),
+    DEFINE_PROP_UINT32("x-completion-batch-age-us", VirtIODevice,
+                       completion_batch_age_us, 50),
 };
 
-static int virtio_device_start_ioeventfd_impl(VirtIODevice *vdev)
+int virtio_device_start_ioeventfd_impl(VirtIODevice *vdev)
 {
     VirtioBusState *qbus = VIRTIO_BUS(qdev_get_parent_bus(DEVICE(vdev)));
     int i, n, r, err;
@@ -4415,7 +4508,7 @@ int virtio_device_start_ioeventfd(VirtIODevice *vdev)
     return virtio_bus_start_ioeventfd(vbus);
 }
 
-static void virtio_device_stop_ioeventfd_impl(VirtIODevice *vdev)
+void virtio_device_stop_ioeventfd_impl(VirtIODevice *vdev)
 {
     VirtioBusState *qbus = VIRTIO_BUS(qdev_get_parent_bus(DEVICE(vdev)));
     int n, r;
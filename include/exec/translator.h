@@ -161,6 +161,34 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
  */
 bool translator_use_goto_tb(DisasContextBase *db, vaddr dest);
 
+/**
+ * translator_push_return_hint
+ * @db: Disassembly context
+ * @ret_addr: Guest address of the instruction following the call,
+ *            in the same form as the pc returned by get_tb_cpu_state
+ *
+ * Push @ret_addr onto the per-vCPU shadow return stack, along with the
+ * TB cached for it in the jump cache, so that a matching
+ * tcg_gen_lookup_and_goto_ptr_ret() can jump directly to the predicted
+ * TB.  The push is expanded inline, without a helper call.  This is
+ * only a hint: targets need not pair calls and returns exactly.
+ */
+void translator_push_return_hint(DisasContextBase *db, TCGv_i64 ret_addr);
+
+/**
+ * translator_lookup_and_goto_ptr_ret
+ * @db: Disassembly context
+ * @pc: Guest address returned to, in the same form as for
+ *      translator_push_return_hint
+ *
+ * As tcg_gen_lookup_and_goto_ptr_ret(), but the prediction is checked
+ * inline and a hit jumps to the predicted TB without a helper call.
+ * The check compares the predicted TB with cs_base, flags and cflags of
+ * the current TB, so the target may only use this if nothing but the pc
+ * has changed since the start of the current TB.
+ */
+void translator_lookup_and_goto_ptr_ret(DisasContextBase *db, TCGv_i64 pc);
+
 /**
  * translator_io_start
  * @db: Disassembly context
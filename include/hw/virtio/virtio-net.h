@@ -20,6 +20,7 @@
 #include "net/announce.h"
 #include "qemu/option_int.h"
 #include "qom/object.h"
+#include "qapi/qapi-types-virtio.h"
 
 #include "ebpf/ebpf_rss.h"
 
@@ -56,6 +57,7 @@ typedef struct virtio_net_conf
     char *duplex_str;
     uint8_t duplex;
     char *primary_id_str;
+    IOThreadVirtQueueMappingList *iothread_vq_mapping_list;
 } virtio_net_conf;
 
 /* Coalesced packets type & status */
@@ -165,6 +167,8 @@ typedef struct VirtIONetQueue {
         VirtQueueElement *elem;
     } async_tx;
     struct VirtIONet *n;
+    /* AioContext that services this queue pair and its peer */
+    AioContext *ctx;
 } VirtIONetQueue;
 
 struct VirtIONet {
@@ -230,6 +234,9 @@ struct VirtIONet {
     struct EBPFRSSContext ebpf_rss;
     uint32_t nr_ebpf_rss_fds;
     char **ebpf_rss_fds;
+    /* queue pairs are attached to their IOThreads */
+    bool ioeventfd_started;
+    unsigned int ioeventfd_quiesce_depth;
 };
 
 size_t virtio_net_handle_ctrl_iov(VirtIODevice *vdev,
@@ -60,6 +60,7 @@ size_t virtio_get_config_size(const VirtIOConfigSizeParams *params,
                               uint64_t host_features);
 
 typedef struct VirtQueue VirtQueue;
+typedef struct VirtQueueElementPool VirtQueueElementPool;
 
 #define VIRTQUEUE_MAX_SIZE 1024
 
@@ -72,6 +73,8 @@ typedef struct VirtQueueElement
     unsigned int in_num;
     /* Element has been processed (VIRTIO_F_IN_ORDER) */
     bool in_order_filled;
+    /* Pool that owns the element, or NULL if g_malloc'ed */
+    VirtQueueElementPool *pool;
     hwaddr *in_addr;
     hwaddr *out_addr;
     struct iovec *in_sg;
@@ -190,6 +193,11 @@ struct VirtIODevice
     bool started;
     bool start_on_kick; /* when virtio 1.0 feature has not been negotiated */
     bool disable_legacy_check;
+    /*
+     * Age at which virtqueue_push() publishes a batch of used ring updates
+     * early, 0 disables batching
+     */
+    uint32_t completion_batch_age_us;
     bool vhost_started;
     VMChangeStateEntry *vmstate;
     char *bus_name;
@@ -322,6 +330,67 @@ void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
 
 void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem);
 void *virtqueue_pop(VirtQueue *vq, size_t sz);
+
+/**
+ * virtqueue_enable_element_pool:
+ * @vq: the #VirtQueue
+ * @sz: the size the device passes to virtqueue_pop() for @vq
+ * @max_sg: the largest number of descriptors served from the pool
+ *
+ * Recycle the elements popped from @vq instead of allocating each one with
+ * g_malloc().  Elements with more than @max_sg descriptors still come from
+ * the heap.  The pool grows up to the number of requests in flight and is
+ * disabled by virtio_delete_queue().
+ *
+ * Devices that enable the pool must release the elements popped from @vq
+ * with virtqueue_element_free() instead of g_free().  Elements that are
+ * still in use when the pool is disabled go back to the heap when freed.
+ */
+void virtqueue_enable_element_pool(VirtQueue *vq, size_t sz,
+                                   unsigned int max_sg);
+
+/**
+ * virtqueue_element_pool_new:
+ * @sz: the size of the elements, as passed to virtqueue_pop()
+ * @max_sg: the largest number of descriptors served from the pool
+ *
+ * Returns: a pool for virtqueue_element_alloc().
+ */
+VirtQueueElementPool *virtqueue_element_pool_new(size_t sz,
+                                                 unsigned int max_sg);
+
+/**
+ * virtqueue_element_pool_disable:
+ * @pool: the pool
+ *
+ * Release the free elements of @pool.  @pool goes away once the elements
+ * still in use have been freed, and must not be allocated from anymore.
+ */
+void virtqueue_element_pool_disable(VirtQueueElementPool *pool);
+
+/**
+ * virtqueue_element_alloc:
+ * @pool: the pool to allocate from, or NULL
+ * @sz: the size of the element, at least sizeof(VirtQueueElement)
+ * @out_num: the number of device readable descriptors
+ * @in_num: the number of device writable descriptors
+ *
+ * Allocate an element with room for its descriptors, from @pool if @sz
+ * and the number of descriptors fit it and from the heap otherwise.
+ *
+ * Returns: the element, to be released with virtqueue_element_free().
+ */
+void *virtqueue_element_alloc(VirtQueueElementPool *pool, size_t sz,
+                              unsigned int out_num, unsigned int in_num);
+
+/**
+ * virtqueue_element_free:
+ * @elem: an element from virtqueue_pop() or qemu_get_virtqueue_element()
+ *
+ * Release @elem, returning it to the pool of its virtqueue if it came from
+ * one.  May be called from any thread.
+ */
+void virtqueue_element_free(void *elem);
 unsigned int virtqueue_drop_all(VirtQueue *vq);
 void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz);
 void qemu_put_virtqueue_element(VirtIODevice *vdev, QEMUFile *f,
@@ -557,6 +626,8 @@ VirtQueue *virtio_get_queue(VirtIODevice *vdev, int n);
 uint16_t virtio_get_queue_index(VirtQueue *vq);
 EventNotifier *virtio_queue_get_guest_notifier(VirtQueue *vq);
 int virtio_device_start_ioeventfd(VirtIODevice *vdev);
+int virtio_device_start_ioeventfd_impl(VirtIODevice *vdev);
+void virtio_device_stop_ioeventfd_impl(VirtIODevice *vdev);
 int virtio_device_grab_ioeventfd(VirtIODevice *vdev);
 void virtio_device_release_ioeventfd(VirtIODevice *vdev);
 bool virtio_device_ioeventfd_enabled(VirtIODevice *vdev);
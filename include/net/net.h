@@ -82,6 +82,8 @@ typedef void (NetAnnounce)(NetClientState *);
 typedef bool (SetSteeringEBPF)(NetClientState *, int);
 typedef bool (NetCheckPeerType)(NetClientState *, ObjectClass *, Error **);
 typedef struct vhost_net *(GetVHostNet)(NetClientState *nc);
+typedef void (SetAioContext)(NetClientState *, AioContext *);
+typedef void (NetPrintInfo)(NetClientState *, Monitor *);
 
 typedef struct NetClientInfo {
     NetClientDriver type;
@@ -110,6 +112,8 @@ typedef struct NetClientInfo {
     SetSteeringEBPF *set_steering_ebpf;
     NetCheckPeerType *check_peer_type;
     GetVHostNet *get_vhost_net;
+    SetAioContext *set_aio_context;
+    NetPrintInfo *print_info;
 } NetClientInfo;
 
 struct NetClientState {
@@ -130,6 +134,10 @@ struct NetClientState {
     bool is_netdev;
     bool do_not_pad; /* do not pad to the minimum ethernet frame length */
     bool is_datapath;
+    /* Serviced by an IOThread, see qemu_set_aio_context() */
+    bool uses_iothread;
+    /* AioContext of the event handlers, NULL for the main loop */
+    AioContext *ctx;
     QTAILQ_HEAD(, NetFilterState) filters;
 };
 
@@ -156,6 +164,41 @@ struct SocketReadState {
 };
 
 int net_fill_rstate(SocketReadState *rs, const uint8_t *buf, int size);
+
+#ifdef CONFIG_RECVMMSG
+#define NET_DGRAM_BATCH 32
+#else
+#define NET_DGRAM_BATCH 1
+#endif
+
+/* Datagrams received together by net_dgram_batch_recv() */
+typedef struct NetDgramBatch {
+    unsigned int count;
+    /* The first datagram that the caller has not passed on yet */
+    unsigned int next;
+    size_t len[NET_DGRAM_BATCH];
+    /*
+     * @size buffers of NET_BUFSIZE bytes.  Starts at one buffer and grows
+     * up to NET_DGRAM_BATCH while the socket keeps filling all of them.
+     */
+    unsigned int size;
+    uint8_t *buf;
+#ifdef CONFIG_RECVMMSG
+    struct iovec iov[NET_DGRAM_BATCH];
+    struct mmsghdr msgs[NET_DGRAM_BATCH];
+#endif
+} NetDgramBatch;
+
+void net_dgram_batch_init(NetDgramBatch *batch);
+void net_dgram_batch_cleanup(NetDgramBatch *batch);
+int net_dgram_batch_recv(NetDgramBatch *batch, int fd);
+
+static inline const uint8_t *net_dgram_batch_buf(const NetDgramBatch *batch,
+                                                 unsigned int i)
+{
+    return batch->buf + i * NET_BUFSIZE;
+}
+
 char *qemu_mac_strdup_printf(const uint8_t *macaddr);
 NetClientState *qemu_find_netdev(const char *id);
 int qemu_find_net_clients_except(const char *id, NetClientState **ncs,
@@ -210,6 +253,8 @@ void qemu_set_vnet_hdr_len(NetClientState *nc, int len);
 bool qemu_get_vnet_hash_supported_types(NetClientState *nc, uint32_t *types);
 int qemu_set_vnet_le(NetClientState *nc, bool is_le);
 int qemu_set_vnet_be(NetClientState *nc, bool is_be);
+bool qemu_can_set_aio_context(NetClientState *nc);
+void qemu_set_aio_context(NetClientState *nc, AioContext *ctx);
 void qemu_macaddr_default_if_unset(MACAddr *macaddr);
 /**
  * qemu_find_nic_info: Obtain NIC configuration information
@@ -195,4 +195,19 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(RCUReadAuto, rcu_read_auto_unlock)
 void rcu_add_force_rcu_notifier(Notifier *n);
 void rcu_remove_force_rcu_notifier(Notifier *n);
 
+typedef struct RCUStats {
+    /* Callbacks waiting for their grace period, now and at most */
+    int pending;
+    int pending_max;
+    /* Callbacks whose grace period has elapsed but have not run yet */
+    int ready;
+    /* Callbacks that have run */
+    uint64_t callbacks;
+    /* Grace periods, and how many had to be forced */
+    uint64_t grace_periods;
+    uint64_t forced_grace_periods;
+} RCUStats;
+
+void rcu_get_stats(RCUStats *stats);
+
 #endif /* QEMU_RCU_H */
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Startup time profiling
+ */
+
+#ifndef QEMU_STARTUP_PROFILE_H
+#define QEMU_STARTUP_PROFILE_H
+
+typedef struct StartupProfileRecord {
+    /* Static string, e.g. "phase", "realize" or "class_init" */
+    const char *category;
+    char *name;
+    int thread_id;
+    /* Nanoseconds since startup_profile_init() */
+    int64_t start;
+    int64_t duration;
+} StartupProfileRecord;
+
+/* See documentation in util/startup-profile.c */
+void startup_profile_init(void);
+void startup_profile_set_output(const char *filename);
+void startup_profile_finish(void);
+bool startup_profile_finished(void);
+
+int64_t startup_profile_begin(void);
+void G_GNUC_PRINTF(3, 4) startup_profile_end(int64_t start,
+                                             const char *category,
+                                             const char *fmt, ...);
+void startup_profile_mark(const char *category, const char *name);
+
+void startup_profile_foreach(void (*fn)(const StartupProfileRecord *ev,
+                                        void *opaque),
+                             void *opaque);
+
+#endif /* QEMU_STARTUP_PROFILE_H */
@@ -87,7 +87,8 @@ struct QEMUTimer {
     QEMUTimerList *timer_list;
     QEMUTimerCB *cb;
     void *opaque;
-    QEMUTimer *next;
+    uint64_t seq;               /* orders timers with equal expire_time */
+    size_t heap_index;          /* position in the timer list's heap */
     int attributes;
     int scale;
 };
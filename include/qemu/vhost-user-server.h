@@ -15,6 +15,7 @@
 #include "io/channel-socket.h"
 #include "io/channel-file.h"
 #include "io/net-listener.h"
+#include "qemu/coroutine.h"
 #include "qapi/error.h"
 #include "standard-headers/linux/virtio_blk.h"
 
@@ -24,6 +25,7 @@ typedef struct VuFdWatch {
     int fd; /*kick fd*/
     void *pvt;
     vu_watch_cb cb;
+    AioContext *ctx; /* virtqueue AioContext, or NULL for VuServer->ctx */
     QTAILQ_ENTRY(VuFdWatch) next;
 } VuFdWatch;
 
@@ -31,7 +33,9 @@ typedef struct VuFdWatch {
  * VuServer:
  * A vhost-user server instance with user-defined VuDevIface callbacks.
  * Vhost-user device backends can be implemented using VuServer. VuDevIface
- * callbacks and virtqueue kicks run in the given AioContext.
+ * callbacks and virtqueue kicks run in the given AioContext, unless
+ * vhost_user_server_set_queue_ctxs() assigned separate AioContexts to the
+ * virtqueues.
  */
 typedef struct {
     QIONetListener *listener;
@@ -42,9 +46,19 @@ typedef struct {
 
     unsigned int in_flight; /* atomic */
 
+    /*
+     * AioContexts that virtqueue kicks are distributed over, or NULL if they
+     * are handled in ctx. Only used between vhost-user messages.
+     */
+    AioContext **queue_ctxs;
+    size_t num_queue_ctxs;
+    QemuMutex idle_lock; /* protects idle_queue */
+    CoQueue idle_queue; /* waiting for in_flight to drop to zero */
+
     /* Protected by ctx lock */
     bool in_qio_channel_yield;
-    bool wait_idle;
+    bool wait_idle; /* read by other threads with queue_ctxs */
+    bool queues_running; /* kick fds of queue_ctxs are monitored */
     bool quiescing;
     VuDev vu_dev;
     QIOChannel *ioc; /* The I/O channel with the client */
@@ -63,6 +77,9 @@ bool vhost_user_server_start(VuServer *server,
 
 void vhost_user_server_stop(VuServer *server);
 
+void vhost_user_server_set_queue_ctxs(VuServer *server,
+                                      AioContext *const *ctxs, size_t count);
+
 void vhost_user_server_inc_in_flight(VuServer *server);
 void vhost_user_server_dec_in_flight(VuServer *server);
 bool vhost_user_server_has_in_flight(VuServer *server);
@@ -532,6 +532,18 @@ struct IOMMUMemoryRegionClass {
      * @iommu: the IOMMUMemoryRegion
      */
     int (*num_indexes)(IOMMUMemoryRegion *iommu);
+
+    /**
+     * @cache_translations:
+     *
+     * Set to true if the memory core may cache the results of @translate
+     * for DMA.  The cache registers an IOMMU_NOTIFIER_UNMAP notifier on
+     * the region, so this must only be set by IOMMUs that send unmap
+     * notifications for every mapping they invalidate, and for which
+     * registering such a notifier has no other side effects.  Only
+     * translations for IOMMU index 0 are cached.
+     */
+    bool cache_translations;
 };
 
 /**
@@ -613,6 +625,11 @@ struct IOMMUMemoryRegion {
 
     QLIST_HEAD(, IOMMUNotifier) iommu_notify;
     IOMMUNotifierFlag iommu_notify_flags;
+
+    /* DMA translation cache, see address_space_translate_iommu() */
+    IOMMUNotifier xlat_cache_notifier;
+    int xlat_cache_state;
+    uint64_t xlat_cache_gen;
 };
 
 #define IOMMU_NOTIFIER_FOREACH(n, mr) \
@@ -922,6 +939,18 @@ struct AddressSpace {
     size_t max_bounce_buffer_size;
     /* Total size of bounce buffers currently allocated, atomically accessed */
     size_t bounce_buffer_size;
+    /*
+     * Bounce buffers released by address_space_unmap() are kept here for
+     * reuse, up to max_bounce_buffer_size bytes in total.
+     */
+    QemuMutex bounce_pool_lock;
+    QSLIST_HEAD(, BounceBuffer) bounce_pool;
+    size_t bounce_pool_size;
+    /* Bounce buffer statistics, atomically accessed */
+    size_t bounce_maps;
+    size_t bounce_pool_hits;
+    size_t bounce_exhausted;
+    size_t bounce_peak_size;
     /* List of callbacks to invoke when buffers free up */
     QemuMutex map_client_list_lock;
     QLIST_HEAD(, AddressSpaceMapClient) map_client_list;
@@ -40,6 +40,8 @@ struct RAMBlock {
     Error *cpr_blocker;
     int fd;
     uint64_t fd_offset;
+    /* Parts were mapped with qemu_ram_map_private_file() */
+    bool private_file_mapped;
     int guest_memfd;
     RamBlockAttributes *attributes;
     size_t page_size;
@@ -132,6 +134,8 @@ static inline void *ramblock_ptr(RAMBlock *block, ram_addr_t offset)
 /* memory API */
 
 void qemu_ram_remap(ram_addr_t addr);
+int qemu_ram_map_private_file(RAMBlock *block, ram_addr_t offset,
+                              size_t length, int fd, off_t fd_offset);
 /* This should not be used by devices.  */
 ram_addr_t qemu_ram_addr_from_host(void *ptr);
 ram_addr_t qemu_ram_addr_from_host_nofail(void *ptr);
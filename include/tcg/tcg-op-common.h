@@ -85,6 +85,24 @@ void tcg_gen_goto_tb(unsigned idx);
  */
 void tcg_gen_lookup_and_goto_ptr(void);
 
+/**
+ * tcg_gen_lookup_and_goto_ptr_ret() - look up the TB after a return
+ *
+ * Equivalent to tcg_gen_lookup_and_goto_ptr(), but first check the
+ * prediction made by the most recent translator_push_return_hint().
+ */
+void tcg_gen_lookup_and_goto_ptr_ret(void);
+
+/**
+ * tcg_gen_goto_ptr() - jump to translated code
+ * @ptr: Host address of the code of a valid TB
+ *
+ * For translators that find the next TB themselves, e.g. from a
+ * prediction they verify inline.  Code following this op is only
+ * reachable through a label.
+ */
+void tcg_gen_goto_ptr(TCGv_ptr ptr);
+
 void tcg_gen_plugin_cb(unsigned from);
 void tcg_gen_plugin_mem_cb(TCGv_i64 addr, unsigned meminfo);
 
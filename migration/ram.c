@@ -39,6 +39,7 @@
 #include "migration/register.h"
 #include "migration/misc.h"
 #include "qemu-file.h"
+#include "io/channel-file.h"
 #include "postcopy-ram.h"
 #include "page_cache.h"
 #include "qemu/error-report.h"
@@ -4079,6 +4080,89 @@ static bool handle_zero_mapped_ram(RAMBlock *block, unsigned long from_bit_idx,
     return true;
 }
 
+#ifndef _WIN32
+/*
+ * mapped_ram_mmap_fd: Return the file descriptor to map @block's pages from,
+ * or -1 if they have to be read.
+ *
+ * Mapping the pages replaces the guest RAM of @block, so it is only done for
+ * private anonymous memory that nothing else has pinned, and only while the
+ * destination RAM is still known to be zero (incoming migration).  The new
+ * mapping only gets the machine's default madvise() settings and is
+ * populated lazily, so memory backends with a NUMA policy, their own dump
+ * or merge settings, or preallocation are read.
+ */
+static int mapped_ram_mmap_fd(QEMUFile *f, RAMBlock *block)
+{
+    QIOChannel *ioc = qemu_file_get_ioc(f);
+    size_t page_size = qemu_real_host_page_size();
+    HostMemoryBackend *backend;
+
+    if (!migrate_mapped_ram_mmap() ||
+        !runstate_check(RUN_STATE_INMIGRATE) ||
+        !object_dynamic_cast(OBJECT(ioc), TYPE_QIO_CHANNEL_FILE)) {
+        return -1;
+    }
+
+    if (!block->host || block->fd >= 0 || block->guest_memfd >= 0 ||
+        qemu_ram_is_shared(block) ||
+        (block->flags & (RAM_PREALLOC | RAM_READONLY)) ||
+        qemu_ram_pagesize(block) != page_size ||
+        ram_block_discard_is_disabled() ||
+        !QEMU_IS_ALIGNED(block->pages_offset, page_size)) {
+        return -1;
+    }
+
+    backend = (HostMemoryBackend *)
+        object_dynamic_cast(block->mr->owner, TYPE_MEMORY_BACKEND);
+    if (backend &&
+        (backend->prealloc ||
+         backend->policy != HOST_MEM_POLICY_DEFAULT ||
+         backend->dump != machine_dump_guest_core(current_machine) ||
+         backend->merge != machine_mem_merge(current_machine))) {
+        return -1;
+    }
+
+    return QIO_CHANNEL_FILE(ioc)->fd;
+}
+
+/*
+ * mapped_ram_mmap_pages: Map pages of @block copy-on-write from the
+ * migration file instead of reading them.
+ *
+ * Returns: true if the pages were mapped, false if they have to be read.
+ */
+static bool mapped_ram_mmap_pages(RAMBlock *block, int fd, ram_addr_t offset,
+                                  size_t size)
+{
+    size_t page_size = qemu_real_host_page_size();
+
+    if (!offset_in_ramblock(block, offset) ||
+        !QEMU_IS_ALIGNED(offset, page_size) ||
+        !QEMU_IS_ALIGNED(size, page_size)) {
+        return false;
+    }
+
+    if (qemu_ram_map_private_file(block, offset, size, fd,
+                                  block->pages_offset + offset)) {
+        return false;
+    }
+    trace_ram_load_mapped_ram_mmap(block->idstr, offset, size);
+    return true;
+}
+#else
+static int mapped_ram_mmap_fd(QEMUFile *f, RAMBlock *block)
+{
+    return -1;
+}
+
+static bool mapped_ram_mmap_pages(RAMBlock *block, int fd, ram_addr_t offset,
+                                  size_t size)
+{
+    return false;
+}
+#endif
+
 static bool read_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
                                      long num_pages, unsigned long *bitmap,
                                      Error **errp)
@@ -4088,6 +4172,7 @@ static bool read_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
     ram_addr_t offset;
     void *host;
     size_t read, unread, size;
+    int fd = mapped_ram_mmap_fd(f, block);
 
     for (set_bit_idx = find_first_bit(bitmap, num_pages);
          set_bit_idx < num_pages;
@@ -4104,6 +4189,10 @@ static bool read_ramblock_mapped_ram(QEMUFile *f, RAMBlock *block,
         unread = TARGET_PAGE_SIZE * (clear_bit_idx - set_bit_idx);
         offset = set_bit_idx << TARGET_PAGE_BITS;
 
+        if (fd >= 0 && mapped_ram_mmap_pages(block, fd, offset, unread)) {
+            continue;
+        }
+
         while (unread > 0) {
             host = host_from_ram_block_offset(block, offset);
             if (!host) {
@@ -14,6 +14,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/rcu.h"
 #include "qemu/sockets.h"
 #include "monitor-internal.h"
 #include "monitor/qdev.h"
@@ -41,6 +42,21 @@ NameInfo *qmp_query_name(Error **errp)
     return info;
 }
 
+RcuInfo *qmp_query_rcu(Error **errp)
+{
+    RcuInfo *info = g_new0(RcuInfo, 1);
+    RCUStats stats;
+
+    rcu_get_stats(&stats);
+    info->pending_callbacks = stats.pending;
+    info->max_pending_callbacks = stats.pending_max;
+    info->ready_callbacks = stats.ready;
+    info->callbacks = stats.callbacks;
+    info->grace_periods = stats.grace_periods;
+    info->forced_grace_periods = stats.forced_grace_periods;
+    return info;
+}
+
 void qmp_quit(Error **errp)
 {
     shutdown_action = SHUTDOWN_ACTION_POWEROFF;
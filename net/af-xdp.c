@@ -28,6 +28,7 @@
 #include "qemu/iov.h"
 #include "qemu/main-loop.h"
 #include "qemu/memalign.h"
+#include "monitor/monitor.h"
 
 
 typedef struct AFXDPState {
@@ -56,6 +57,13 @@ typedef struct AFXDPState {
     char                 *map_path;
     int                  map_fd;
     uint32_t             map_start_index;
+
+    /* Per-queue counters, shown by "info network". */
+    uint64_t             rx_packets;
+    uint64_t             tx_packets;
+    uint64_t             tx_gathered;
+    uint64_t             tx_oversize;
+    uint64_t             tx_ring_full;
 } AFXDPState;
 
 #define AF_XDP_BATCH_SIZE 64
@@ -143,10 +151,15 @@ static void af_xdp_writable(void *opaque)
     qemu_flush_queued_packets(&s->nc);
 }
 
-static ssize_t af_xdp_receive(NetClientState *nc,
-                              const uint8_t *buf, size_t size)
+/*
+ * Packets are gathered straight from the sender's iovec into the UMEM frame,
+ * so scattered packets are copied once instead of being linearized first.
+ */
+static ssize_t af_xdp_receive_iov(NetClientState *nc,
+                                  const struct iovec *iov, int iovcnt)
 {
     AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+    size_t size = iov_size(iov, iovcnt);
     struct xdp_desc *desc;
     uint32_t idx;
     void *data;
@@ -156,6 +169,7 @@ static ssize_t af_xdp_receive(NetClientState *nc,
 
     if (size > XSK_UMEM__DEFAULT_FRAME_SIZE) {
         /* We can't transmit packet this size... */
+        s->tx_oversize++;
         return size;
     }
 
@@ -164,6 +178,7 @@ static ssize_t af_xdp_receive(NetClientState *nc,
          * Out of buffers or space in tx ring.  Poll until we can write.
          * This will also kick the Tx, if it was waiting on CQ.
          */
+        s->tx_ring_full++;
         af_xdp_write_poll(s, true);
         return 0;
     }
@@ -173,10 +188,15 @@ static ssize_t af_xdp_receive(NetClientState *nc,
     desc->len = size;
 
     data = xsk_umem__get_data(s->buffer, desc->addr);
-    memcpy(data, buf, size);
+    iov_to_buf(iov, iovcnt, 0, data, size);
 
     xsk_ring_prod__submit(&s->tx, 1);
     s->outstanding_tx++;
+    s->tx_packets++;
+    if (iovcnt > 1) {
+        /* The net layer would have linearized this one before .receive */
+        s->tx_gathered++;
+    }
 
     if (xsk_ring_prod__needs_wakeup(&s->tx)) {
         af_xdp_write_poll(s, true);
@@ -185,6 +205,17 @@ static ssize_t af_xdp_receive(NetClientState *nc,
     return size;
 }
 
+static ssize_t af_xdp_receive(NetClientState *nc,
+                              const uint8_t *buf, size_t size)
+{
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = size,
+    };
+
+    return af_xdp_receive_iov(nc, &iov, 1);
+}
+
 /*
  * Complete a previous send (backend --> guest) and enable the
  * fd_read callback.
@@ -240,6 +271,7 @@ static void af_xdp_send(void *opaque)
         iov.iov_len = desc->len;
 
         s->pool[s->n_pool++] = desc->addr;
+        s->rx_packets++;
 
         if (!qemu_sendv_packet_async(&s->nc, &iov, 1,
                                      af_xdp_send_completed)) {
@@ -433,13 +465,26 @@ static int af_xdp_update_xsk_map(AFXDPState *s, Error **errp)
     return 0;
 }
 
+static void af_xdp_print_info(NetClientState *nc, Monitor *mon)
+{
+    AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+
+    monitor_printf(mon, "  rx_packets=%" PRIu64 ",tx_packets=%" PRIu64
+                   ",tx_gathered=%" PRIu64 ",tx_oversize=%" PRIu64
+                   ",tx_ring_full=%" PRIu64 "\n",
+                   s->rx_packets, s->tx_packets, s->tx_gathered,
+                   s->tx_oversize, s->tx_ring_full);
+}
+
 /* NetClientInfo methods. */
 static NetClientInfo net_af_xdp_info = {
     .type = NET_CLIENT_DRIVER_AF_XDP,
     .size = sizeof(AFXDPState),
     .receive = af_xdp_receive,
+    .receive_iov = af_xdp_receive_iov,
     .poll = af_xdp_poll,
     .cleanup = af_xdp_cleanup,
+    .print_info = af_xdp_print_info,
 };
 
 /*
@@ -8,6 +8,7 @@
 
 #include "qemu/osdep.h"
 #include "qemu/cutils.h"
+#include "qemu/aio-wait.h"
 #include "net/announce.h"
 #include "net/net.h"
 #include "qapi/clone-visitor.h"
@@ -133,6 +134,35 @@ static const char *qemu_ether_ntoa(const MACAddr *mac)
     return ret;
 }
 
+typedef struct AnnounceSelfPacket {
+    NetClientState *nc;
+    const uint8_t *buf;
+    int len;
+} AnnounceSelfPacket;
+
+static void announce_self_send_bh(void *opaque)
+{
+    AnnounceSelfPacket *pkt = opaque;
+
+    qemu_send_packet_raw(pkt->nc, pkt->buf, pkt->len);
+}
+
+/*
+ * A queue whose peer is serviced by an IOThread must only be used from
+ * that IOThread, so send the packet there and wait for it.
+ */
+static void announce_self_send(NetClientState *nc, const uint8_t *buf,
+                               int len)
+{
+    AnnounceSelfPacket pkt = { .nc = nc, .buf = buf, .len = len };
+
+    if (nc->peer && nc->peer->ctx) {
+        aio_wait_bh_oneshot(nc->peer->ctx, announce_self_send_bh, &pkt);
+    } else {
+        announce_self_send_bh(&pkt);
+    }
+}
+
 static void qemu_announce_self_iter(NICState *nic, void *opaque)
 {
     AnnounceTimer *timer = opaque;
@@ -164,7 +194,7 @@ static void qemu_announce_self_iter(NICState *nic, void *opaque)
     if (!skip) {
         len = announce_self_create(buf, nic->conf->macaddr.a);
 
-        qemu_send_packet_raw(qemu_get_queue(nic), buf, len);
+        announce_self_send(qemu_get_queue(nic), buf, len);
 
         /* if the NIC provides it's own announcement support, use it as well */
         if (nic->ncs->info->announce) {
@@ -35,16 +35,23 @@
 #include "qemu/iov.h"
 #include "qemu/main-loop.h"
 #include "qemu/cutils.h"
+#include "qemu/defer-call.h"
 
 typedef struct NetDgramState {
     NetClientState nc;
     int fd;
-    SocketReadState rs;
+    NetDgramBatch rx_batch;
     bool read_poll;               /* waiting to receive data? */
     bool write_poll;              /* waiting to transmit data? */
     /* contains destination iff connectionless */
     struct sockaddr *dest_addr;
     socklen_t dest_len;
+#ifdef CONFIG_SENDMMSG
+    /* packets staged by net_dgram_receive() until net_dgram_flush_tx() */
+    unsigned int tx_count;
+    struct iovec tx_iov[NET_DGRAM_BATCH];
+    struct mmsghdr tx_msgs[NET_DGRAM_BATCH];
+#endif
 } NetDgramState;
 
 static void net_dgram_send(void *opaque);
@@ -70,12 +77,60 @@ static void net_dgram_write_poll(NetDgramState *s, bool enable)
     net_dgram_update_fd_handler(s);
 }
 
+#ifdef CONFIG_SENDMMSG
+/*
+ * Send the packets staged by net_dgram_receive() with as few system calls as
+ * possible.  Packets that cannot be sent yet stay staged until the socket is
+ * writable.
+ */
+static void net_dgram_flush_tx(NetDgramState *s)
+{
+    unsigned int sent = 0;
+
+    while (sent < s->tx_count) {
+        int ret = RETRY_ON_EINTR(sendmmsg(s->fd, s->tx_msgs + sent,
+                                          s->tx_count - sent, 0));
+
+        if (ret < 0) {
+            if (errno == EAGAIN) {
+                net_dgram_write_poll(s, true);
+                break;
+            }
+            /* drop the packet that failed, like send() errors do */
+            ret = 1;
+        }
+        sent += ret;
+    }
+
+    for (unsigned int i = 0; i < sent; i++) {
+        g_free(s->tx_iov[i].iov_base);
+    }
+    s->tx_count -= sent;
+    memmove(s->tx_iov, s->tx_iov + sent, s->tx_count * sizeof(s->tx_iov[0]));
+    for (unsigned int i = 0; i < s->tx_count; i++) {
+        s->tx_msgs[i].msg_hdr.msg_iov = &s->tx_iov[i];
+    }
+}
+
+static void net_dgram_flush_tx_deferred_fn(void *opaque)
+{
+    net_dgram_flush_tx(opaque);
+}
+#endif
+
 static void net_dgram_writable(void *opaque)
 {
     NetDgramState *s = opaque;
 
     net_dgram_write_poll(s, false);
 
+#ifdef CONFIG_SENDMMSG
+    net_dgram_flush_tx(s);
+    if (s->tx_count) {
+        return;
+    }
+#endif
+
     qemu_flush_queued_packets(&s->nc);
 }
 
@@ -83,6 +138,37 @@ static ssize_t net_dgram_receive(NetClientState *nc,
                                  const uint8_t *buf, size_t size)
 {
     NetDgramState *s = DO_UPCAST(NetDgramState, nc, nc);
+#ifdef CONFIG_SENDMMSG
+    /*
+     * Stage the packet and send the whole burst when the caller's
+     * defer_call_begin()/defer_call_end() section ends.  Outside of such
+     * a section the packet is sent right away.
+     */
+    if (s->write_poll) {
+        return 0;
+    }
+    if (s->tx_count == NET_DGRAM_BATCH) {
+        net_dgram_flush_tx(s);
+        if (s->tx_count) {
+            return 0;
+        }
+    }
+
+    s->tx_iov[s->tx_count] = (struct iovec) {
+        .iov_base = g_memdup2(buf, size),
+        .iov_len = size,
+    };
+    s->tx_msgs[s->tx_count].msg_hdr = (struct msghdr) {
+        .msg_name = s->dest_addr,
+        .msg_namelen = s->dest_len,
+        .msg_iov = &s->tx_iov[s->tx_count],
+        .msg_iovlen = 1,
+    };
+    s->tx_count++;
+
+    defer_call(net_dgram_flush_tx_deferred_fn, s);
+    return size;
+#else
     ssize_t ret;
 
     do {
@@ -98,47 +184,62 @@ static ssize_t net_dgram_receive(NetClientState *nc,
         return 0;
     }
     return ret;
+#endif
 }
 
-static void net_dgram_send_completed(NetClientState *nc, ssize_t len)
+static void net_dgram_send_completed(NetClientState *nc, ssize_t len);
+
+/*
+ * Pass the received packets on to the peer.  NetClientInfo receive hooks
+ * take one packet, so the batch only saves system calls on the socket side.
+ *
+ * Once a packet has been queued the rest of the batch waits until it has
+ * been delivered: qemu_send_packet_async() delivers directly whenever the
+ * peer can receive, which could overtake the queued packet.
+ *
+ * Returns true once the whole batch has been passed on.
+ */
+static bool net_dgram_deliver(NetDgramState *s)
 {
-    NetDgramState *s = DO_UPCAST(NetDgramState, nc, nc);
+    NetDgramBatch *batch = &s->rx_batch;
 
-    if (!s->read_poll) {
-        net_dgram_read_poll(s, true);
+    while (batch->next < batch->count) {
+        unsigned int i = batch->next++;
+
+        if (batch->len[i] == 0) {
+            /* end of connection */
+            net_dgram_read_poll(s, false);
+            net_dgram_write_poll(s, false);
+            return false;
+        }
+
+        if (qemu_send_packet_async(&s->nc, net_dgram_batch_buf(batch, i),
+                                   batch->len[i],
+                                   net_dgram_send_completed) == 0) {
+            net_dgram_read_poll(s, false);
+            return false;
+        }
     }
+    return true;
 }
 
-static void net_dgram_rs_finalize(SocketReadState *rs)
+static void net_dgram_send_completed(NetClientState *nc, ssize_t len)
 {
-    NetDgramState *s = container_of(rs, NetDgramState, rs);
+    NetDgramState *s = DO_UPCAST(NetDgramState, nc, nc);
 
-    if (qemu_send_packet_async(&s->nc, rs->buf,
-                               rs->packet_len,
-                               net_dgram_send_completed) == 0) {
-        net_dgram_read_poll(s, false);
+    if (net_dgram_deliver(s) && !s->read_poll) {
+        net_dgram_read_poll(s, true);
     }
 }
 
 static void net_dgram_send(void *opaque)
 {
     NetDgramState *s = opaque;
-    int size;
 
-    size = recv(s->fd, s->rs.buf, sizeof(s->rs.buf), 0);
-    if (size < 0) {
-        return;
-    }
-    if (size == 0) {
-        /* end of connection */
-        net_dgram_read_poll(s, false);
-        net_dgram_write_poll(s, false);
+    if (net_dgram_batch_recv(&s->rx_batch, s->fd) < 0) {
         return;
     }
-    if (qemu_send_packet_async(&s->nc, s->rs.buf, size,
-                               net_dgram_send_completed) == 0) {
-        net_dgram_read_poll(s, false);
-    }
+    net_dgram_deliver(s);
 }
 
 static int net_dgram_mcast_create(struct sockaddr_in *mcastaddr,
@@ -247,6 +348,13 @@ static void net_dgram_cleanup(NetClientState *nc)
         close(s->fd);
         s->fd = -1;
     }
+#ifdef CONFIG_SENDMMSG
+    for (unsigned int i = 0; i < s->tx_count; i++) {
+        g_free(s->tx_iov[i].iov_base);
+    }
+    s->tx_count = 0;
+#endif
+    net_dgram_batch_cleanup(&s->rx_batch);
     g_free(s->dest_addr);
     s->dest_addr = NULL;
     s->dest_len = 0;
@@ -273,7 +381,7 @@ static NetDgramState *net_dgram_fd_init(NetClientState *peer,
     s = DO_UPCAST(NetDgramState, nc, nc);
 
     s->fd = fd;
-    net_socket_rs_init(&s->rs, net_dgram_rs_finalize, false);
+    net_dgram_batch_init(&s->rx_batch);
     net_dgram_read_poll(s, true);
 
     return s;
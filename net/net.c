@@ -559,6 +559,26 @@ void qemu_set_offload(NetClientState *nc, const NetOffloads *ol)
     nc->info->set_offload(nc, ol);
 }
 
+bool qemu_can_set_aio_context(NetClientState *nc)
+{
+    return nc && nc->info->set_aio_context;
+}
+
+/*
+ * Move the backend's event handlers to @ctx, or back to the main loop if
+ * @ctx is NULL.  The caller must make sure that nothing else is using the
+ * net client while its AioContext changes.
+ */
+void qemu_set_aio_context(NetClientState *nc, AioContext *ctx)
+{
+    if (!qemu_can_set_aio_context(nc)) {
+        return;
+    }
+
+    nc->info->set_aio_context(nc, ctx);
+    nc->ctx = ctx;
+}
+
 int qemu_get_vnet_hdr_len(NetClientState *nc)
 {
     if (!nc) {
@@ -1556,6 +1576,9 @@ void print_net_client(Monitor *mon, NetClientState *nc)
                    nc->queue_index,
                    NetClientDriver_str(nc->info->type),
                    nc->info_str);
+    if (nc->info->print_info) {
+        nc->info->print_info(nc, mon);
+    }
     if (!QTAILQ_EMPTY(&nc->filters)) {
         monitor_printf(mon, "filters:\n");
     }
@@ -2175,3 +2198,81 @@ int net_fill_rstate(SocketReadState *rs, const uint8_t *buf, int size)
     assert(size == 0);
     return 0;
 }
+
+static void net_dgram_batch_resize(NetDgramBatch *batch, unsigned int size)
+{
+    batch->size = size;
+    batch->buf = g_realloc(batch->buf, size * NET_BUFSIZE);
+#ifdef CONFIG_RECVMMSG
+    for (unsigned int i = 0; i < size; i++) {
+        batch->iov[i] = (struct iovec) {
+            .iov_base = batch->buf + i * NET_BUFSIZE,
+            .iov_len = NET_BUFSIZE,
+        };
+        batch->msgs[i].msg_hdr = (struct msghdr) {
+            .msg_iov = &batch->iov[i],
+            .msg_iovlen = 1,
+        };
+    }
+#endif
+}
+
+void net_dgram_batch_init(NetDgramBatch *batch)
+{
+    batch->count = 0;
+    batch->next = 0;
+    batch->buf = NULL;
+    net_dgram_batch_resize(batch, 1);
+}
+
+void net_dgram_batch_cleanup(NetDgramBatch *batch)
+{
+    g_free(batch->buf);
+    batch->buf = NULL;
+    batch->count = 0;
+    batch->next = 0;
+    batch->size = 0;
+}
+
+/*
+ * Receive up to NET_DGRAM_BATCH datagrams from @fd with a single system call
+ * where the host supports it.  A datagram of length 0 means end of connection
+ * for connected sockets.
+ *
+ * The buffers received into by the previous call are reused, so the caller
+ * must be done with them; the peer's NetQueue keeps its own copy.
+ *
+ * Returns the number of datagrams received, or -1 with errno set.
+ */
+int net_dgram_batch_recv(NetDgramBatch *batch, int fd)
+{
+    int count;
+
+    batch->count = 0;
+    batch->next = 0;
+#ifdef CONFIG_RECVMMSG
+    count = RETRY_ON_EINTR(recvmmsg(fd, batch->msgs, batch->size,
+                                    MSG_DONTWAIT, NULL));
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        batch->len[i] = batch->msgs[i].msg_len;
+    }
+
+    /* Idle or lightly loaded sockets do not need the whole batch */
+    if ((unsigned int)count == batch->size && batch->size < NET_DGRAM_BATCH) {
+        net_dgram_batch_resize(batch, MIN(batch->size * 2, NET_DGRAM_BATCH));
+    }
+#else
+    count = recv(fd, batch->buf, NET_BUFSIZE, 0);
+    if (count < 0) {
+        return -1;
+    }
+    batch->len[0] = count;
+    count = 1;
+#endif
+
+    batch->count = count;
+    return count;
+}
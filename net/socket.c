@@ -38,6 +38,8 @@ typedef struct NetSocketState {
     int listen_fd;
     int fd;
     SocketReadState rs;
+    NetDgramBatch rx_batch;       /* only SOCK_DGRAM */
+    unsigned int rx_queued;       /* queued packets (only SOCK_STREAM) */
     unsigned int send_index;      /* number of bytes sent (only SOCK_STREAM) */
     struct sockaddr_in dgram_dst; /* contains inet host and port destination iff connectionless (SOCK_DGRAM) */
     IOHandler *send_fn;           /* differs between SOCK_STREAM/SOCK_DGRAM */
@@ -136,7 +138,9 @@ static void net_socket_send_completed(NetClientState *nc, ssize_t len)
 {
     NetSocketState *s = DO_UPCAST(NetSocketState, nc, nc);
 
-    if (!s->read_poll) {
+    /* keep the received packets in order */
+    assert(s->rx_queued > 0);
+    if (--s->rx_queued == 0 && !s->read_poll) {
         net_socket_read_poll(s, true);
     }
 }
@@ -148,6 +152,7 @@ static void net_socket_rs_finalize(SocketReadState *rs)
     if (qemu_send_packet_async(&s->nc, rs->buf,
                                rs->packet_len,
                                net_socket_send_completed) == 0) {
+        s->rx_queued++;
         net_socket_read_poll(s, false);
     }
 }
@@ -190,24 +195,53 @@ static void net_socket_send(void *opaque)
     }
 }
 
+static void net_socket_dgram_send_completed(NetClientState *nc, ssize_t len);
+
+/*
+ * Pass the received datagrams on to the peer, stopping at the first one that
+ * is queued so that the rest cannot overtake it.  Returns true once the
+ * whole batch has been passed on.
+ */
+static bool net_socket_dgram_deliver(NetSocketState *s)
+{
+    NetDgramBatch *batch = &s->rx_batch;
+
+    while (batch->next < batch->count) {
+        unsigned int i = batch->next++;
+
+        if (batch->len[i] == 0) {
+            /* end of connection */
+            net_socket_read_poll(s, false);
+            net_socket_write_poll(s, false);
+            return false;
+        }
+        if (qemu_send_packet_async(&s->nc, net_dgram_batch_buf(batch, i),
+                                   batch->len[i],
+                                   net_socket_dgram_send_completed) == 0) {
+            net_socket_read_poll(s, false);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void net_socket_dgram_send_completed(NetClientState *nc, ssize_t len)
+{
+    NetSocketState *s = DO_UPCAST(NetSocketState, nc, nc);
+
+    if (net_socket_dgram_deliver(s) && !s->read_poll) {
+        net_socket_read_poll(s, true);
+    }
+}
+
 static void net_socket_send_dgram(void *opaque)
 {
     NetSocketState *s = opaque;
-    int size;
 
-    size = recv(s->fd, s->rs.buf, sizeof(s->rs.buf), 0);
-    if (size < 0)
+    if (net_dgram_batch_recv(&s->rx_batch, s->fd) < 0) {
         return;
-    if (size == 0) {
-        /* end of connection */
-        net_socket_read_poll(s, false);
-        net_socket_write_poll(s, false);
-        return;
-    }
-    if (qemu_send_packet_async(&s->nc, s->rs.buf, size,
-                               net_socket_send_completed) == 0) {
-        net_socket_read_poll(s, false);
     }
+    net_socket_dgram_deliver(s);
 }
 
 static int net_socket_mcast_create(struct sockaddr_in *mcastaddr,
@@ -320,6 +354,7 @@ static void net_socket_cleanup(NetClientState *nc)
         close(s->listen_fd);
         s->listen_fd = -1;
     }
+    net_dgram_batch_cleanup(&s->rx_batch);
 }
 
 static NetClientInfo net_dgram_socket_info = {
@@ -383,6 +418,7 @@ static NetSocketState *net_socket_fd_init_dgram(NetClientState *peer,
     s->listen_fd = -1;
     s->send_fn = net_socket_send_dgram;
     net_socket_rs_init(&s->rs, net_socket_rs_finalize, false);
+    net_dgram_batch_init(&s->rx_batch);
     net_socket_read_poll(s, true);
 
     /* mcast: save bound address as dst */
@@ -1941,6 +1941,7 @@ ERST
 DEF("fsdev", HAS_ARG, QEMU_OPTION_fsdev,
     "-fsdev local,id=id,path=path,security_model=mapped-xattr|mapped-file|passthrough|none\n"
     " [,writeout=immediate][,readonly=on][,fmode=fmode][,dmode=dmode][,max_xattr=max]\n"
+    " [,cache_timeout=ms]\n"
     " [[,throttling.bps-total=b]|[[,throttling.bps-read=r][,throttling.bps-write=w]]]\n"
     " [[,throttling.iops-total=i]|[[,throttling.iops-read=r][,throttling.iops-write=w]]]\n"
     " [[,throttling.bps-total-max=bm]|[[,throttling.bps-read-max=rm][,throttling.bps-write-max=wm]]]\n"
@@ -1950,7 +1951,7 @@ DEF("fsdev", HAS_ARG, QEMU_OPTION_fsdev,
     QEMU_ARCH_ALL)
 
 SRST
-``-fsdev local,id=id,path=path,security_model=security_model [,writeout=writeout][,readonly=on][,fmode=fmode][,dmode=dmode][,max_xattr=max] [,throttling.option=value[,throttling.option=value[,...]]]``
+``-fsdev local,id=id,path=path,security_model=security_model [,writeout=writeout][,readonly=on][,fmode=fmode][,dmode=dmode][,max_xattr=max][,cache_timeout=ms] [,throttling.option=value[,throttling.option=value[,...]]]``
   \ 
 ``-fsdev synth,id=id[,readonly=on][,max_xattr=max]``
     Define a new file system device. Valid options are:
@@ -2032,6 +2033,14 @@ SRST
         number of xattr FIDs. This limit prevents host memory exhaustion
         attacks by capping the number of simultaneous xattr FIDs.
 
+    ``cache_timeout=ms``
+        Enables caching of file attributes and directory listings for
+        this export, so that repeated lookups of the same files are
+        answered without accessing the host filesystem. Any modifying
+        request by the guest drops the cache; changes made on host side
+        may however only become visible to the guest after up to ``ms``
+        milliseconds. The default is 0, which disables the cache.
+
     -fsdev option is used along with -device driver "virtio-9p-...".
 
 ``-device virtio-9p-type,fsdev=id,mount_tag=mount_tag``
@@ -2052,11 +2061,12 @@ ERST
 DEF("virtfs", HAS_ARG, QEMU_OPTION_virtfs,
     "-virtfs local,path=path,mount_tag=tag,security_model=mapped-xattr|mapped-file|passthrough|none\n"
     "        [,id=id][,writeout=immediate][,readonly=on][,fmode=fmode][,dmode=dmode][,multidevs=remap|forbid|warn][,max_xattr=max]\n"
+    "        [,cache_timeout=ms]\n"
     "-virtfs synth,mount_tag=tag[,id=id][,readonly=on][,max_xattr=max]\n",
     QEMU_ARCH_ALL)
 
 SRST
-``-virtfs local,path=path,mount_tag=mount_tag ,security_model=security_model[,writeout=writeout][,readonly=on] [,fmode=fmode][,dmode=dmode][,multidevs=multidevs][,max_xattr=max]``
+``-virtfs local,path=path,mount_tag=mount_tag ,security_model=security_model[,writeout=writeout][,readonly=on] [,fmode=fmode][,dmode=dmode][,multidevs=multidevs][,max_xattr=max][,cache_timeout=ms]``
   \ 
 ``-virtfs synth,mount_tag=mount_tag[,max_xattr=max]``
     Define a new virtual filesystem device and expose it to the guest using
@@ -2130,6 +2140,12 @@ SRST
         number of xattr FIDs. This limit prevents host memory exhaustion
         attacks by capping the number of simultaneous xattr FIDs.
 
+    ``cache_timeout=ms``
+        Enables caching of file attributes and directory listings for
+        this export. Changes made on host side may only become visible
+        to the guest after up to ``ms`` milliseconds. The default is 0,
+        which disables the cache.
+
     ``multidevs=remap|forbid|warn``
         Specifies how to deal with multiple devices being shared with
         the same 9p export in order to avoid file ID collisions on guest.
@@ -3968,6 +3984,12 @@ SRST
         |qemu_system| linux.img -device virtio-net-pci,netdev=n1 \\
             -netdev af-xdp,id=n1,ifname=eth0,queues=4
 
+    ``info network`` shows packet counters for each queue: received
+    packets, transmitted packets, transmitted packets that were gathered
+    from several guest buffers without an intermediate copy, and packets
+    dropped for being larger than a UMEM frame or delayed by a full
+    transmit ring.
+
     'start-queue' option can be specified if a particular range of queues
     [m, m + n] should be in use.  For example, this is may be necessary in
     order to use certain NICs in native mode.  Kernel allows the driver to
@@ -5035,6 +5057,21 @@ SRST
     from a script.
 ERST
 
+DEF("startup-profile", HAS_ARG, QEMU_OPTION_startup_profile, \
+    "-startup-profile file\n"
+    "                write startup timings to 'file' in Chrome trace format\n",
+    QEMU_ARCH_ALL)
+SRST
+``-startup-profile file``
+    Once the machine is ready to run, write how long each part of
+    startup took to file, in the Chrome trace event format understood
+    by ``chrome://tracing`` and Perfetto. This covers the machine
+    initialization phases, QOM class initialization, device realize,
+    module loading, RAM allocation, ROM loading and ACPI table
+    generation. The same data is available through the
+    ``query-startup-profile`` QMP command.
+ERST
+
 DEF("preconfig", 0, QEMU_OPTION_preconfig, \
     "--preconfig     pause QEMU before machine is initialized (experimental)\n",
     QEMU_ARCH_ALL)
@@ -26,6 +26,7 @@
 #include "qobject/qdict.h"
 #include "qobject/qjson.h"
 #include "qemu/id.h"
+#include "qemu/startup-profile.h"
 #include "qapi/qmp/qerror.h"
 #include "trace.h"
 
@@ -408,7 +409,10 @@ static void type_initialize(TypeImpl *ti)
     }
 
     if (ti->class_init) {
+        int64_t start = startup_profile_begin();
+
         ti->class_init(ti->class, ti->class_data);
+        startup_profile_end(start, "class_init", "%s", ti->name);
     }
 }
 
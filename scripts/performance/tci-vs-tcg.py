@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+
+#  Compare the speed of the TCG interpreter (TCI) against native TCG.
+#  Syntax:
+#  tci-vs-tcg.py [-h] [-r] <number of runs> <native qemu> <tci qemu> -- \
+#           <target executable> [<target executable options>]
+#
+#  [-h] - Print the script arguments help message.
+#  [-r] - Specify the number of runs of each configuration.
+#       - If this flag is not specified, the tool defaults to 5.
+#
+#  Both QEMU executables must be linux-user emulators for the same
+#  target, one built normally and one with --enable-tcg-interpreter.
+#  A fixed, deterministic guest workload should be used, for example
+#  the sha512 test from tests/tcg/multiarch.
+#
+#  Example of usage:
+#  tci-vs-tcg.py -r 10 build/qemu-x86_64 build-tci/qemu-x86_64 -- \
+#           build/tests/tcg/x86_64-linux-user/sha512
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+import argparse
+import statistics
+import subprocess
+import sys
+import time
+
+
+def run_once(command):
+    start = time.perf_counter()
+    result = subprocess.run(command, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, check=False)
+    elapsed = time.perf_counter() - start
+    if result.returncode:
+        sys.exit("Command '{}' failed:\n{}".format(
+            " ".join(command), result.stderr.decode("utf-8")))
+    return elapsed
+
+
+def measure(qemu, target, runs):
+    # Warm up the page cache before timing anything
+    run_once([qemu] + target)
+    return [run_once([qemu] + target) for _ in range(runs)]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        usage='tci-vs-tcg.py [-h] [-r] <number of runs> '
+              '<native qemu> <tci qemu> -- '
+              '<target executable> [<target executable options>]')
+
+    parser.add_argument('-r', dest='runs', type=int, default=5,
+                        help='Specify the number of runs of each '
+                             'configuration.')
+    parser.add_argument('native', type=str, help=argparse.SUPPRESS)
+    parser.add_argument('tci', type=str, help=argparse.SUPPRESS)
+    parser.add_argument('target', type=str, nargs='+',
+                        help=argparse.SUPPRESS)
+
+    args = parser.parse_args()
+    if args.runs < 1:
+        sys.exit("The number of runs must be positive.")
+
+    native = measure(args.native, args.target, args.runs)
+    tci = measure(args.tci, args.target, args.runs)
+
+    print("{:<8}  {:>10}  {:>10}  {:>10}".format(
+        "accel", "min (s)", "median (s)", "max (s)"))
+    for name, times in (("native", native), ("tci", tci)):
+        print("{:<8}  {:>10.3f}  {:>10.3f}  {:>10.3f}".format(
+            name, min(times), statistics.median(times), max(times)))
+    print("TCI slowdown: {:.2f}x".format(
+        statistics.median(tci) / statistics.median(native)))
+
+
+if __name__ == "__main__":
+    main()
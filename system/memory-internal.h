@@ -40,6 +40,9 @@ void address_space_dispatch_free(AddressSpaceDispatch *d);
 void mtree_print_dispatch(struct AddressSpaceDispatch *d,
                           MemoryRegion *root);
 
+void address_space_bounce_pool_init(AddressSpace *as);
+void address_space_bounce_pool_destroy(AddressSpace *as);
+
 /* returns true if end is big endian. */
 static inline bool devend_big_endian(enum device_endian end)
 {
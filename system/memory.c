@@ -104,6 +104,24 @@ static AddrRange addrrange_intersection(AddrRange r1, AddrRange r2)
     return addrrange_make(start, int128_sub(end, start));
 }
 
+/*
+ * Parts of the memory topology that changed since the FlatViews were last
+ * updated, relative to the start of @mr.  memory_region_transaction_commit()
+ * only re-renders the corresponding windows of each FlatView that contains @mr
+ * (directly or through aliases) instead of regenerating it from scratch.
+ */
+typedef struct FlatViewDirtyRange {
+    MemoryRegion *mr; /* never dereferenced, might be gone by the commit */
+    AddrRange range;
+} FlatViewDirtyRange;
+
+/* Beyond this, regenerating all FlatViews is likely cheaper */
+#define FLATVIEW_MAX_DIRTY_RANGES 64
+
+static GArray *flatview_dirty_ranges;
+/* Changes that cannot be expressed as dirty ranges are pending */
+static bool flatview_full_update;
+
 enum ListenerDirection { Forward, Reverse };
 
 #define MEMORY_LISTENER_CALL_GLOBAL(_callback, _direction, _args...)    \
@@ -744,10 +762,22 @@ static MemoryRegion *memory_region_get_flatview_root(MemoryRegion *mr)
     return NULL;
 }
 
+static void flatview_build_dispatch(FlatView *view)
+{
+    int i;
+
+    view->dispatch = address_space_dispatch_new(view);
+    for (i = 0; i < view->nr; i++) {
+        MemoryRegionSection mrs =
+            section_from_flat_range(&view->ranges[i], view);
+        flatview_add_to_dispatch(view, &mrs);
+    }
+    address_space_dispatch_compact(view->dispatch);
+}
+
 /* Render a memory topology into a list of disjoint absolute ranges. */
 static FlatView *generate_memory_topology(MemoryRegion *mr)
 {
-    int i;
     FlatView *view;
 
     view = flatview_new(mr);
@@ -758,19 +788,175 @@ static FlatView *generate_memory_topology(MemoryRegion *mr)
                              false, false, false);
     }
     flatview_simplify(view);
+    flatview_build_dispatch(view);
+    g_hash_table_replace(flat_views, mr, view);
 
-    view->dispatch = address_space_dispatch_new(view);
-    for (i = 0; i < view->nr; i++) {
-        MemoryRegionSection mrs =
-            section_from_flat_range(&view->ranges[i], view);
-        flatview_add_to_dispatch(view, &mrs);
+    return view;
+}
+
+/*
+ * Collect the absolute address windows that are affected by
+ * flatview_dirty_ranges when rendering @mr.  This walks the tree just like
+ * render_memory_region(), but without rendering anything.
+ */
+static void flatview_collect_windows(GArray *windows, MemoryRegion *mr,
+                                     Int128 base, AddrRange clip)
+{
+    MemoryRegion *subregion;
+    AddrRange tmp;
+    unsigned i;
+
+    int128_addto(&base, int128_make64(mr->addr));
+    tmp = addrrange_make(base, mr->size);
+
+    if (!addrrange_intersects(tmp, clip)) {
+        return;
     }
-    address_space_dispatch_compact(view->dispatch);
+
+    clip = addrrange_intersection(tmp, clip);
+
+    /* Checked before mr->enabled: disabling @mr also dirties its range */
+    for (i = 0; i < flatview_dirty_ranges->len; i++) {
+        FlatViewDirtyRange *dirty =
+            &g_array_index(flatview_dirty_ranges, FlatViewDirtyRange, i);
+
+        if (dirty->mr == mr) {
+            tmp = addrrange_shift(dirty->range, base);
+            if (addrrange_intersects(tmp, clip)) {
+                tmp = addrrange_intersection(tmp, clip);
+                g_array_append_val(windows, tmp);
+            }
+        }
+    }
+
+    if (!mr->enabled) {
+        return;
+    }
+
+    if (mr->alias) {
+        int128_subfrom(&base, int128_make64(mr->alias->addr));
+        int128_subfrom(&base, int128_make64(mr->alias_offset));
+        flatview_collect_windows(windows, mr->alias, base, clip);
+        return;
+    }
+
+    QTAILQ_FOREACH(subregion, &mr->subregions, subregions_link) {
+        flatview_collect_windows(windows, subregion, base, clip);
+    }
+}
+
+static gint addrrange_cmp_start(gconstpointer a, gconstpointer b)
+{
+    const AddrRange *r1 = a, *r2 = b;
+
+    if (int128_lt(r1->start, r2->start)) {
+        return -1;
+    }
+    return int128_eq(r1->start, r2->start) ? 0 : 1;
+}
+
+/*
+ * Create the new FlatView for @mr from @old_view, which was rendered from @mr
+ * before the pending changes.  Only @windows are rendered anew, the ranges
+ * outside of them are taken over from @old_view.
+ */
+static FlatView *flatview_patch(FlatView *old_view, MemoryRegion *mr,
+                                GArray *windows)
+{
+    FlatView *view;
+    unsigned i, j, nr_windows;
+
+    /*
+     * Extend the windows so that they do not split any range of the old view;
+     * adjacent unmergeable ranges are included, too, so that a re-rendered
+     * range ends up as a single FlatRange like it would in a full rendering.
+     */
+    for (i = 0; i < windows->len; i++) {
+        AddrRange *w = &g_array_index(windows, AddrRange, i);
+        Int128 start = w->start, end = addrrange_end(*w);
+
+        for (j = 0; j < old_view->nr; j++) {
+            FlatRange *fr = &old_view->ranges[j];
+
+            if (addrrange_intersects(fr->addr, *w) ||
+                (fr->unmergeable &&
+                 (int128_eq(addrrange_end(fr->addr), w->start) ||
+                  int128_eq(fr->addr.start, addrrange_end(*w))))) {
+                start = int128_min(start, fr->addr.start);
+                end = int128_max(end, addrrange_end(fr->addr));
+            }
+        }
+        *w = addrrange_make(start, int128_sub(end, start));
+    }
+
+    /* Sort and merge overlapping windows */
+    g_array_sort(windows, addrrange_cmp_start);
+    nr_windows = 0;
+    for (i = 0; i < windows->len; i++) {
+        AddrRange w = g_array_index(windows, AddrRange, i);
+        AddrRange *last = nr_windows ?
+            &g_array_index(windows, AddrRange, nr_windows - 1) : NULL;
+
+        if (last && int128_le(w.start, addrrange_end(*last))) {
+            Int128 end = int128_max(addrrange_end(*last), addrrange_end(w));
+            last->size = int128_sub(end, last->start);
+        } else {
+            g_array_index(windows, AddrRange, nr_windows++) = w;
+        }
+    }
+
+    view = flatview_new(mr);
+
+    /* Old ranges are now either completely inside a window or outside */
+    for (i = 0, j = 0; i < old_view->nr; i++) {
+        FlatRange *fr = &old_view->ranges[i];
+
+        while (j < nr_windows &&
+               int128_le(addrrange_end(g_array_index(windows, AddrRange, j)),
+                         fr->addr.start)) {
+            j++;
+        }
+        if (j < nr_windows &&
+            addrrange_intersects(g_array_index(windows, AddrRange, j),
+                                 fr->addr)) {
+            continue;
+        }
+        flatview_insert(view, view->nr, fr);
+    }
+
+    for (i = 0; i < nr_windows; i++) {
+        render_memory_region(view, mr, int128_zero(),
+                             g_array_index(windows, AddrRange, i),
+                             false, false, false);
+    }
+    flatview_simplify(view);
+    flatview_build_dispatch(view);
     g_hash_table_replace(flat_views, mr, view);
 
     return view;
 }
 
+/*
+ * Bring the FlatView of @mr up to date, starting from @old_view.  If none of
+ * the pending changes affect @mr, @old_view is kept.
+ */
+static void flatview_update(FlatView *old_view, MemoryRegion *mr)
+{
+    g_autoptr(GArray) windows = g_array_new(false, false, sizeof(AddrRange));
+
+    flatview_collect_windows(windows, mr, int128_zero(),
+                             addrrange_make(int128_zero(), int128_2_64()));
+    trace_flatview_update(old_view, mr, windows->len);
+
+    if (!windows->len) {
+        flatview_ref(old_view);
+        g_hash_table_replace(flat_views, mr, old_view);
+        return;
+    }
+
+    flatview_patch(old_view, mr, windows);
+}
+
 static void address_space_add_del_ioeventfds(AddressSpace *as,
                                              MemoryRegionIoeventfd *fds_new,
                                              unsigned fds_new_nb,
@@ -1062,23 +1248,37 @@ static void flatviews_init(void)
 static void flatviews_reset(void)
 {
     AddressSpace *as;
+    GHashTable *old_views = flat_views;
+    bool incremental = old_views && flatview_dirty_ranges &&
+                       !flatview_full_update;
 
-    if (flat_views) {
-        g_hash_table_unref(flat_views);
-        flat_views = NULL;
-    }
+    flat_views = NULL;
     flatviews_init();
 
-    /* Render unique FVs */
+    /* Render unique FVs, incrementally where an old one exists */
     QTAILQ_FOREACH(as, &address_spaces, address_spaces_link) {
         MemoryRegion *physmr = memory_region_get_flatview_root(as->root);
+        FlatView *old_view;
 
         if (g_hash_table_lookup(flat_views, physmr)) {
             continue;
         }
 
-        generate_memory_topology(physmr);
+        old_view = incremental ? g_hash_table_lookup(old_views, physmr) : NULL;
+        if (old_view) {
+            flatview_update(old_view, physmr);
+        } else {
+            generate_memory_topology(physmr);
+        }
+    }
+
+    if (old_views) {
+        g_hash_table_unref(old_views);
     }
+    if (flatview_dirty_ranges) {
+        g_array_set_size(flatview_dirty_ranges, 0);
+    }
+    flatview_full_update = false;
 }
 
 static void address_space_set_flatview(AddressSpace *as)
@@ -1137,6 +1337,56 @@ static void address_space_update_topology(AddressSpace *as)
     address_space_set_flatview(as);
 }
 
+/*
+ * Record that rendering the range @start/@size of @mr may have changed, to be
+ * picked up by the next memory_region_transaction_commit().
+ */
+static void memory_region_update_range(MemoryRegion *mr, Int128 start,
+                                       Int128 size)
+{
+    FlatViewDirtyRange dirty = {
+        .mr = mr,
+        .range = addrrange_make(start, size),
+    };
+
+    memory_region_update_pending = true;
+    if (flatview_full_update) {
+        return;
+    }
+    if (!flatview_dirty_ranges) {
+        flatview_dirty_ranges = g_array_new(false, false,
+                                            sizeof(FlatViewDirtyRange));
+    }
+    if (flatview_dirty_ranges->len >= FLATVIEW_MAX_DIRTY_RANGES) {
+        flatview_full_update = true;
+        return;
+    }
+    g_array_append_val(flatview_dirty_ranges, dirty);
+}
+
+/* Record that the rendering of @mr as a whole may have changed */
+static void memory_region_update_extent(MemoryRegion *mr)
+{
+    if (mr->container) {
+        memory_region_update_range(mr->container, int128_make64(mr->addr),
+                                   mr->size);
+    }
+    /*
+     * Aliases that point to @mr render it without going through its
+     * container, so record the change on @mr itself as well.
+     */
+    if (!mr->container || mr->mapped_via_alias) {
+        memory_region_update_range(mr, int128_zero(), mr->size);
+    }
+}
+
+/* Record a change that requires regenerating all FlatViews */
+static void memory_region_update_all(void)
+{
+    memory_region_update_pending = true;
+    flatview_full_update = true;
+}
+
 void memory_region_transaction_begin(void)
 {
     qemu_flush_coalesced_mmio_buffer();
@@ -2128,7 +2378,9 @@ void memory_region_set_log(MemoryRegion *mr, bool log, unsigned client)
 
     memory_region_transaction_begin();
     mr->dirty_log_mask = (mr->dirty_log_mask & ~mask) | (log * mask);
-    memory_region_update_pending |= mr->enabled;
+    if (mr->enabled) {
+        memory_region_update_extent(mr);
+    }
     memory_region_transaction_commit();
 }
 
@@ -2258,7 +2510,9 @@ void memory_region_set_readonly(MemoryRegion *mr, bool readonly)
     if (mr->readonly != readonly) {
         memory_region_transaction_begin();
         mr->readonly = readonly;
-        memory_region_update_pending |= mr->enabled;
+        if (mr->enabled) {
+            memory_region_update_extent(mr);
+        }
         memory_region_transaction_commit();
     }
 }
@@ -2268,7 +2522,9 @@ void memory_region_set_nonvolatile(MemoryRegion *mr, bool nonvolatile)
     if (mr->nonvolatile != nonvolatile) {
         memory_region_transaction_begin();
         mr->nonvolatile = nonvolatile;
-        memory_region_update_pending |= mr->enabled;
+        if (mr->enabled) {
+            memory_region_update_extent(mr);
+        }
         memory_region_transaction_commit();
     }
 }
@@ -2278,7 +2534,9 @@ void memory_region_rom_device_set_romd(MemoryRegion *mr, bool romd_mode)
     if (mr->romd_mode != romd_mode) {
         memory_region_transaction_begin();
         mr->romd_mode = romd_mode;
-        memory_region_update_pending |= mr->enabled;
+        if (mr->enabled) {
+            memory_region_update_extent(mr);
+        }
         memory_region_transaction_commit();
     }
 }
@@ -2534,7 +2792,9 @@ static void memory_region_update_container_subregions(MemoryRegion *subregion)
     }
     QTAILQ_INSERT_TAIL(&mr->subregions, subregion, subregions_link);
 done:
-    memory_region_update_pending |= mr->enabled && subregion->enabled;
+    if (mr->enabled && subregion->enabled) {
+        memory_region_update_extent(subregion);
+    }
     memory_region_transaction_commit();
 }
 
@@ -2584,11 +2844,15 @@ void memory_region_del_subregion(MemoryRegion *mr,
     }
     QTAILQ_REMOVE(&mr->subregions, subregion, subregions_link);
 
+    if (mr->enabled && subregion->enabled) {
+        memory_region_update_range(mr, int128_make64(subregion->addr),
+                                   subregion->size);
+    }
+
     if (mr->owner != subregion->owner) {
         memory_region_unref(subregion);
     }
 
-    memory_region_update_pending |= mr->enabled && subregion->enabled;
     memory_region_transaction_commit();
 }
 
@@ -2599,7 +2863,7 @@ void memory_region_set_enabled(MemoryRegion *mr, bool enabled)
     }
     memory_region_transaction_begin();
     mr->enabled = enabled;
-    memory_region_update_pending = true;
+    memory_region_update_extent(mr);
     memory_region_transaction_commit();
 }
 
@@ -2614,8 +2878,18 @@ void memory_region_set_size(MemoryRegion *mr, uint64_t size)
         return;
     }
     memory_region_transaction_begin();
+    if (mr->container && !mr->mapped_via_alias) {
+        /* Cover both the old and the new size */
+        memory_region_update_range(mr->container, int128_make64(mr->addr),
+                                   int128_max(s, mr->size));
+    } else {
+        /*
+         * Aliases clip the rendering of @mr to its current size, so a
+         * shrinking alias target cannot be described by a dirty range.
+         */
+        memory_region_update_all();
+    }
     mr->size = s;
-    memory_region_update_pending = true;
     memory_region_transaction_commit();
 }
 
@@ -2636,8 +2910,20 @@ static void memory_region_readd_subregion(MemoryRegion *mr)
 void memory_region_set_address(MemoryRegion *mr, hwaddr addr)
 {
     if (addr != mr->addr) {
+        memory_region_transaction_begin();
+        if (!mr->container) {
+            /* Picked up by the next update, whenever that happens */
+            flatview_full_update = true;
+        } else if (mr->container->enabled && mr->enabled) {
+            /*
+             * Record the old location; memory_region_del_subregion() below
+             * only sees the new address.
+             */
+            memory_region_update_extent(mr);
+        }
         mr->addr = addr;
         memory_region_readd_subregion(mr);
+        memory_region_transaction_commit();
     }
 }
 
@@ -2651,7 +2937,9 @@ void memory_region_set_alias_offset(MemoryRegion *mr, hwaddr offset)
 
     memory_region_transaction_begin();
     mr->alias_offset = offset;
-    memory_region_update_pending |= mr->enabled;
+    if (mr->enabled) {
+        memory_region_update_extent(mr);
+    }
     memory_region_transaction_commit();
 }
 
@@ -2663,7 +2951,9 @@ void memory_region_set_unmergeable(MemoryRegion *mr, bool unmergeable)
 
     memory_region_transaction_begin();
     mr->unmergeable = unmergeable;
-    memory_region_update_pending |= mr->enabled;
+    if (mr->enabled) {
+        memory_region_update_extent(mr);
+    }
     memory_region_transaction_commit();
 }
 
@@ -2862,7 +3152,7 @@ bool memory_global_dirty_log_start(unsigned int flags, Error **errp)
         }
 
         memory_region_transaction_begin();
-        memory_region_update_pending = true;
+        memory_region_update_all();
         memory_region_transaction_commit();
     }
     return true;
@@ -2878,7 +3168,7 @@ static void memory_global_dirty_log_do_stop(unsigned int flags)
 
     if (!global_dirty_tracking) {
         memory_region_transaction_begin();
-        memory_region_update_pending = true;
+        memory_region_update_all();
         memory_region_transaction_commit();
         MEMORY_LISTENER_CALL_GLOBAL(log_global_stop, Reverse);
     }
@@ -3118,6 +3408,7 @@ void address_space_init(AddressSpace *as, MemoryRegion *root, const char *name)
     QTAILQ_INSERT_TAIL(&address_spaces, as, address_spaces_link);
     as->max_bounce_buffer_size = DEFAULT_MAX_BOUNCE_BUFFER_SIZE;
     as->bounce_buffer_size = 0;
+    address_space_bounce_pool_init(as);
     qemu_mutex_init(&as->map_client_list_lock);
     QLIST_INIT(&as->map_client_list);
     as->name = g_strdup(name ? name : "anonymous");
@@ -3130,6 +3421,7 @@ static void do_address_space_destroy(AddressSpace *as)
     assert(qatomic_read(&as->bounce_buffer_size) == 0);
     assert(QLIST_EMPTY(&as->map_client_list));
     qemu_mutex_destroy(&as->map_client_list_lock);
+    address_space_bounce_pool_destroy(as);
 
     assert(QTAILQ_EMPTY(&as->listeners));
 
@@ -3517,6 +3809,14 @@ static void mtree_print_as_name(gpointer data, gpointer user_data)
     AddressSpace *as = data;
 
     qemu_printf("address-space: %s\n", as->name);
+    if (qatomic_read(&as->bounce_maps)) {
+        qemu_printf("  bounce buffers: %zu maps, %zu from pool, "
+                    "%zu exhausted, peak %zu bytes\n",
+                    qatomic_read(&as->bounce_maps),
+                    qatomic_read(&as->bounce_pool_hits),
+                    qatomic_read(&as->bounce_exhausted),
+                    qatomic_read(&as->bounce_peak_size));
+    }
 }
 
 static void mtree_print_as(gpointer key, gpointer value, gpointer user_data)
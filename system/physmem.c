@@ -26,6 +26,7 @@
 #include "qemu/hbitmap.h"
 #include "qemu/madvise.h"
 #include "qemu/lockable.h"
+#include "qemu/coroutine-tls.h"
 
 #ifdef CONFIG_TCG
 #include "accel/tcg/cpu-ops.h"
@@ -66,6 +67,7 @@
 #endif
 
 #include "qemu/rcu_queue.h"
+#include "qemu/startup-profile.h"
 #include "qemu/main-loop.h"
 #include "system/replay.h"
 
@@ -395,6 +397,147 @@ address_space_translate_internal(AddressSpaceDispatch *d, hwaddr addr, hwaddr *x
     return section;
 }
 
+/*
+ * Per-thread cache of IOMMU translations for DMA.  Emulated devices look up
+ * the same few IOVAs over and over (virtqueue rings, descriptor tables,
+ * bounce buffers); this saves a call into the IOMMU's translate callback,
+ * and the locking and IOTLB lookup that come with it, for each of them.
+ * IOThreads each run a single AioContext, so the cache is effectively
+ * per-AioContext.
+ *
+ * Entries are tagged with the IOMMU region's xlat_cache_gen.  The
+ * generation is bumped from an IOMMU_NOTIFIER_UNMAP notifier that is
+ * registered the first time the region is used, so every invalidation
+ * the guest performs drops all cached translations for that region.
+ * Generations are allocated from a global counter and are never reused
+ * by a different region.
+ */
+enum {
+    IOMMU_XLAT_CACHE_NONE,
+    IOMMU_XLAT_CACHE_PENDING,
+    IOMMU_XLAT_CACHE_ACTIVE,
+    IOMMU_XLAT_CACHE_DISABLED,
+};
+
+#define IOMMU_XLAT_CACHE_BITS 6
+#define IOMMU_XLAT_CACHE_SIZE (1 << IOMMU_XLAT_CACHE_BITS)
+
+typedef struct IOMMUXlatCacheEntry {
+    IOMMUMemoryRegion *iommu_mr;
+    uint64_t gen;
+    bool is_write;
+    IOMMUTLBEntry iotlb;
+} IOMMUXlatCacheEntry;
+
+typedef struct IOMMUXlatCache {
+    IOMMUXlatCacheEntry entries[IOMMU_XLAT_CACHE_SIZE];
+} IOMMUXlatCache;
+
+QEMU_DEFINE_STATIC_CO_TLS(IOMMUXlatCache, iommu_xlat_cache)
+
+/* 64 bits, so that a generation is never reused */
+static uint64_t iommu_xlat_cache_next_gen;
+
+static void iommu_xlat_cache_unmap_notify(IOMMUNotifier *n,
+                                          IOMMUTLBEntry *iotlb)
+{
+    IOMMUMemoryRegion *iommu_mr = container_of(n, IOMMUMemoryRegion,
+                                               xlat_cache_notifier);
+
+    qatomic_store_release(&iommu_mr->xlat_cache_gen,
+                          qatomic_inc_fetch(&iommu_xlat_cache_next_gen));
+}
+
+/* Registering a notifier needs the BQL, so do it from the main loop */
+static void iommu_xlat_cache_register_bh(void *opaque)
+{
+    IOMMUMemoryRegion *iommu_mr = opaque;
+    MemoryRegion *mr = MEMORY_REGION(iommu_mr);
+    int state = IOMMU_XLAT_CACHE_DISABLED;
+    Error *local_err = NULL;
+
+    iommu_notifier_init(&iommu_mr->xlat_cache_notifier,
+                        iommu_xlat_cache_unmap_notify,
+                        IOMMU_NOTIFIER_UNMAP, 0, HWADDR_MAX, 0);
+    if (memory_region_register_iommu_notifier(mr,
+                                              &iommu_mr->xlat_cache_notifier,
+                                              &local_err) == 0) {
+        iommu_mr->xlat_cache_gen = qatomic_inc_fetch(&iommu_xlat_cache_next_gen);
+        state = IOMMU_XLAT_CACHE_ACTIVE;
+    } else {
+        error_free(local_err);
+    }
+    trace_iommu_xlat_cache_register(memory_region_name(mr),
+                                    state == IOMMU_XLAT_CACHE_ACTIVE);
+    qatomic_store_release(&iommu_mr->xlat_cache_state, state);
+    memory_region_unref(mr);
+}
+
+static inline unsigned iommu_xlat_cache_hash(IOMMUMemoryRegion *iommu_mr,
+                                             hwaddr addr)
+{
+    return ((uintptr_t)iommu_mr >> 4 ^ addr >> TARGET_PAGE_BITS) &
+           (IOMMU_XLAT_CACHE_SIZE - 1);
+}
+
+/* Called from RCU critical section */
+static IOMMUTLBEntry iommu_xlat_cache_translate(IOMMUMemoryRegion *iommu_mr,
+                                                IOMMUMemoryRegionClass *imrc,
+                                                hwaddr addr, bool is_write,
+                                                int iommu_idx)
+{
+    IOMMUXlatCacheEntry *entry;
+    IOMMUTLBEntry iotlb;
+    uint64_t gen;
+    int state;
+
+    /* The unmap notifier is only registered for IOMMU index 0 */
+    state = qatomic_load_acquire(&iommu_mr->xlat_cache_state);
+    if (state != IOMMU_XLAT_CACHE_ACTIVE || iommu_idx != 0) {
+        if (state == IOMMU_XLAT_CACHE_NONE && imrc->cache_translations &&
+            qatomic_cmpxchg(&iommu_mr->xlat_cache_state,
+                            IOMMU_XLAT_CACHE_NONE,
+                            IOMMU_XLAT_CACHE_PENDING) ==
+            IOMMU_XLAT_CACHE_NONE) {
+            memory_region_ref(MEMORY_REGION(iommu_mr));
+            aio_bh_schedule_oneshot(qemu_get_aio_context(),
+                                    iommu_xlat_cache_register_bh, iommu_mr);
+        }
+        return imrc->translate(iommu_mr, addr, is_write ?
+                               IOMMU_WO : IOMMU_RO, iommu_idx);
+    }
+
+    /*
+     * Read the generation before translating, so that an invalidation
+     * racing with the translation makes the new entry stale at once.
+     */
+    gen = qatomic_load_acquire(&iommu_mr->xlat_cache_gen);
+    entry = &get_ptr_iommu_xlat_cache()->entries[
+        iommu_xlat_cache_hash(iommu_mr, addr)];
+
+    /*
+     * A write must not hit an entry that was filled by a read, so that
+     * IOMMUs that track accessed/dirty bits still see the first write.
+     */
+    if (entry->iommu_mr == iommu_mr && entry->gen == gen &&
+        (entry->is_write || !is_write) &&
+        (entry->iotlb.perm & (1 << is_write)) &&
+        (addr & ~entry->iotlb.addr_mask) == entry->iotlb.iova) {
+        return entry->iotlb;
+    }
+
+    iotlb = imrc->translate(iommu_mr, addr, is_write ?
+                            IOMMU_WO : IOMMU_RO, iommu_idx);
+    if (iotlb.perm & (1 << is_write)) {
+        entry->iommu_mr = iommu_mr;
+        entry->gen = gen;
+        entry->is_write = is_write;
+        entry->iotlb = iotlb;
+        entry->iotlb.iova = addr & ~iotlb.addr_mask;
+    }
+    return iotlb;
+}
+
 /**
  * address_space_translate_iommu - translate an address through an IOMMU
  * memory region and then through the target address space.
@@ -439,8 +582,8 @@ static MemoryRegionSection address_space_translate_iommu(IOMMUMemoryRegion *iomm
             iommu_idx = imrc->attrs_to_index(iommu_mr, attrs);
         }
 
-        iotlb = imrc->translate(iommu_mr, addr, is_write ?
-                                IOMMU_WO : IOMMU_RO, iommu_idx);
+        iotlb = iommu_xlat_cache_translate(iommu_mr, imrc, addr, is_write,
+                                           iommu_idx);
 
         if (!(iotlb.perm & (1 << is_write))) {
             goto unassigned;
@@ -2303,6 +2446,7 @@ RAMBlock *qemu_ram_alloc_from_fd(ram_addr_t size, ram_addr_t max_size,
     RAMBlock *new_block;
     Error *local_err = NULL;
     int64_t file_size, file_align, share_flags;
+    int64_t start;
 
     share_flags = ram_flags & (RAM_PRIVATE | RAM_SHARED);
     assert(share_flags != (RAM_SHARED | RAM_PRIVATE));
@@ -2349,6 +2493,7 @@ RAMBlock *qemu_ram_alloc_from_fd(ram_addr_t size, ram_addr_t max_size,
         return NULL;
     }
 
+    start = startup_profile_begin();
     new_block = g_malloc0(sizeof(*new_block));
     new_block->mr = mr;
     new_block->used_length = size;
@@ -2370,6 +2515,8 @@ RAMBlock *qemu_ram_alloc_from_fd(ram_addr_t size, ram_addr_t max_size,
         error_propagate(errp, local_err);
         return NULL;
     }
+    startup_profile_end(start, "ram", "%s size=0x" RAM_ADDR_FMT,
+                        memory_region_name(mr), max_size);
     return new_block;
 
 }
@@ -2462,6 +2609,7 @@ RAMBlock *qemu_ram_alloc_internal(ram_addr_t size, ram_addr_t max_size,
     RAMBlock *new_block;
     Error *local_err = NULL;
     int align, share_flags;
+    int64_t start;
 
     share_flags = ram_flags & (RAM_PRIVATE | RAM_SHARED);
     assert(share_flags != (RAM_SHARED | RAM_PRIVATE));
@@ -2532,12 +2680,15 @@ RAMBlock *qemu_ram_alloc_internal(ram_addr_t size, ram_addr_t max_size,
     new_block->page_size = qemu_real_host_page_size();
     new_block->host = host;
     new_block->flags = ram_flags;
+    start = startup_profile_begin();
     ram_block_add(new_block, &local_err);
     if (local_err) {
         g_free(new_block);
         error_propagate(errp, local_err);
         return NULL;
     }
+    startup_profile_end(start, "ram", "%s size=0x" RAM_ADDR_FMT,
+                        memory_region_name(mr), max_size);
     return new_block;
 }
 
@@ -2690,6 +2841,57 @@ void qemu_ram_remap(ram_addr_t addr)
         }
     }
 }
+
+/*
+ * Apply the madvise() settings of ram_block_add() and of the anonymous RAM
+ * allocation again, after a range of a RAMBlock got a new mapping.
+ */
+static void qemu_ram_advise_remapped(void *host, size_t length)
+{
+    memory_try_enable_merging(host, length);
+    qemu_ram_setup_dump(host, length);
+    qemu_madvise(host, length, QEMU_MADV_HUGEPAGE);
+    if (!qtest_enabled()) {
+        qemu_madvise(host, length, QEMU_MADV_DONTFORK);
+    }
+}
+
+/*
+ * qemu_ram_map_private_file - map a range of anonymous RAM from a file
+ *
+ * Replace @length bytes of @block at @offset with a copy-on-write mapping
+ * of @fd at @fd_offset.  Only for private anonymous RAM whose NUMA policy
+ * and madvise() settings are the machine defaults, as only those are
+ * applied again.  Discarding the range later maps anonymous memory back.
+ *
+ * Returns 0 on success or a negative errno if mmap() failed, in which case
+ * the range is zero anonymous memory again.  Kills the VM if that fails.
+ */
+int qemu_ram_map_private_file(RAMBlock *block, ram_addr_t offset,
+                              size_t length, int fd, off_t fd_offset)
+{
+    void *host = ramblock_ptr(block, offset);
+    int flags = MAP_PRIVATE | MAP_FIXED;
+    void *area;
+    int ret = 0;
+
+    assert(block->fd < 0 && !qemu_ram_is_shared(block));
+    flags |= block->flags & RAM_NORESERVE ? MAP_NORESERVE : 0;
+    area = mmap(host, length, PROT_READ | PROT_WRITE, flags, fd, fd_offset);
+    if (area == host) {
+        block->private_file_mapped = true;
+    } else {
+        ret = -errno;
+        /* A failed MAP_FIXED mmap() may have unmapped the range already */
+        if (qemu_ram_remap_mmap(block, offset, length)) {
+            error_report("Could not remap RAM %s:" RAM_ADDR_FMT " +%zx",
+                         block->idstr, offset, length);
+            exit(1);
+        }
+    }
+    qemu_ram_advise_remapped(host, length);
+    return ret;
+}
 #endif /* !_WIN32 */
 
 /*
@@ -3592,14 +3794,106 @@ void address_space_flush_icache_range(AddressSpace *as,
  */
 #define BOUNCE_BUFFER_MAGIC 0xb4017ceb4ffe12ed
 
-typedef struct {
+/*
+ * Bounce buffers are allocated in power-of-two sizes, so that a buffer
+ * returned to the pool can serve later requests of similar size, for
+ * example the other entries of the same scatter-gather list.
+ */
+#define BOUNCE_BUFFER_MIN_SIZE 512
+
+typedef struct BounceBuffer {
     uint64_t magic;
     MemoryRegion *mr;
     hwaddr addr;
     size_t len;
+    size_t capacity;
+    QSLIST_ENTRY(BounceBuffer) next;
     uint8_t buffer[];
 } BounceBuffer;
 
+void address_space_bounce_pool_init(AddressSpace *as)
+{
+    qemu_mutex_init(&as->bounce_pool_lock);
+    QSLIST_INIT(&as->bounce_pool);
+    as->bounce_pool_size = 0;
+    as->bounce_maps = 0;
+    as->bounce_pool_hits = 0;
+    as->bounce_exhausted = 0;
+    as->bounce_peak_size = 0;
+}
+
+void address_space_bounce_pool_destroy(AddressSpace *as)
+{
+    BounceBuffer *bounce;
+
+    while ((bounce = QSLIST_FIRST(&as->bounce_pool))) {
+        QSLIST_REMOVE_HEAD(&as->bounce_pool, next);
+        g_free(bounce);
+    }
+    as->bounce_pool_size = 0;
+    qemu_mutex_destroy(&as->bounce_pool_lock);
+}
+
+static BounceBuffer *address_space_get_bounce_buffer(AddressSpace *as,
+                                                     size_t len)
+{
+    BounceBuffer *bounce = NULL, *b;
+    size_t capacity;
+
+    WITH_QEMU_LOCK_GUARD(&as->bounce_pool_lock) {
+        QSLIST_FOREACH(b, &as->bounce_pool, next) {
+            if (b->capacity >= len) {
+                QSLIST_REMOVE(&as->bounce_pool, b, BounceBuffer, next);
+                as->bounce_pool_size -= b->capacity;
+                bounce = b;
+                break;
+            }
+        }
+    }
+
+    if (bounce) {
+        qatomic_inc(&as->bounce_pool_hits);
+        memset(bounce->buffer, 0, len);
+    } else {
+        /* len never exceeds max_bounce_buffer_size, and neither does this */
+        capacity = MIN(MAX(pow2ceil(len), BOUNCE_BUFFER_MIN_SIZE),
+                       as->max_bounce_buffer_size);
+        bounce = g_malloc0(capacity + sizeof(BounceBuffer));
+        bounce->capacity = capacity;
+    }
+    bounce->magic = BOUNCE_BUFFER_MAGIC;
+    return bounce;
+}
+
+static void address_space_put_bounce_buffer(AddressSpace *as,
+                                            BounceBuffer *bounce)
+{
+    bounce->magic = ~BOUNCE_BUFFER_MAGIC;
+
+    WITH_QEMU_LOCK_GUARD(&as->bounce_pool_lock) {
+        if (as->bounce_pool_size + bounce->capacity <=
+            as->max_bounce_buffer_size) {
+            QSLIST_INSERT_HEAD(&as->bounce_pool, bounce, next);
+            as->bounce_pool_size += bounce->capacity;
+            return;
+        }
+    }
+    g_free(bounce);
+}
+
+static void address_space_update_bounce_peak(AddressSpace *as, size_t size)
+{
+    size_t peak = qatomic_read(&as->bounce_peak_size);
+
+    while (size > peak) {
+        size_t actual = qatomic_cmpxchg(&as->bounce_peak_size, peak, size);
+        if (actual == peak) {
+            break;
+        }
+        peak = actual;
+    }
+}
+
 static void
 address_space_unregister_map_client_do(AddressSpaceMapClient *client)
 {
@@ -3781,16 +4075,21 @@ void *address_space_map(AddressSpace *as,
         }
 
         if (l == 0) {
+            qatomic_inc(&as->bounce_exhausted);
+            trace_address_space_map_bounce_exhausted(as, addr, len, used);
             *plen = 0;
             return NULL;
         }
 
-        BounceBuffer *bounce = g_malloc0(l + sizeof(BounceBuffer));
-        bounce->magic = BOUNCE_BUFFER_MAGIC;
+        qatomic_inc(&as->bounce_maps);
+        address_space_update_bounce_peak(as, used + l);
+
+        BounceBuffer *bounce = address_space_get_bounce_buffer(as, l);
         memory_region_ref(mr);
         bounce->mr = mr;
         bounce->addr = addr;
         bounce->len = l;
+        trace_address_space_map_bounce(as, addr, l, bounce->capacity);
 
         if (!is_write) {
             flatview_read(fv, addr, attrs,
@@ -3840,9 +4139,8 @@ void address_space_unmap(AddressSpace *as, void *buffer, hwaddr len,
     }
 
     qatomic_sub(&as->bounce_buffer_size, bounce->len);
-    bounce->magic = ~BOUNCE_BUFFER_MAGIC;
     memory_region_unref(bounce->mr);
-    g_free(bounce);
+    address_space_put_bounce_buffer(as, bounce);
     /* Write bounce_buffer_size before reading map_client_list. */
     smp_mb();
     address_space_notify_map_clients(as);
@@ -4223,6 +4521,15 @@ int ram_block_discard_shared_range(RAMBlock *rb, uint64_t offset, size_t length)
 #if defined(CONFIG_MADVISE)
             if (qemu_ram_is_shared(rb) && rb->fd < 0) {
                 ret = madvise(host_startaddr, length, QEMU_MADV_REMOVE);
+            } else if (rb->private_file_mapped) {
+                /*
+                 * MADV_DONTNEED would read back the file that was mapped
+                 * by qemu_ram_map_private_file(), not zeroes.
+                 */
+                ret = qemu_ram_remap_mmap(rb, offset, length);
+                if (!ret) {
+                    qemu_ram_advise_remapped(host_startaddr, length);
+                }
             } else {
                 ret = madvise(host_startaddr, length, QEMU_MADV_DONTNEED);
             }
@@ -54,6 +54,7 @@
 #include "qemu/accel.h"
 #include "qemu/async-teardown.h"
 #include "qemu/exit-with-parent.h"
+#include "qemu/startup-profile.h"
 #include "hw/usb/usb.h"
 #include "hw/isa/isa.h"
 #include "hw/scsi/scsi.h"
@@ -2832,6 +2833,7 @@ void qmp_x_exit_preconfig(Error **errp)
     if (replay_mode != REPLAY_MODE_NONE) {
         replay_vmstate_init();
     }
+    startup_profile_finish();
 
     if (incoming) {
         Error *local_err = NULL;
@@ -2861,6 +2863,8 @@ void qemu_init(int argc, char **argv)
     bool userconfig = true;
     FILE *vmstate_dump_file = NULL;
 
+    startup_profile_init();
+
     qemu_add_opts(&qemu_drive_opts);
     qemu_add_drive_opts(&qemu_legacy_drive_opts);
     qemu_add_drive_opts(&qemu_common_drive_opts);
@@ -3267,7 +3271,7 @@ void qemu_init(int argc, char **argv)
                 QemuOpts *fsdev;
                 QemuOpts *device;
                 const char *writeout, *sock_fd, *socket, *path, *security_model,
-                           *multidevs, *max_xattr_str;
+                           *multidevs, *max_xattr_str, *cache_timeout;
 
                 olist = qemu_find_opts("virtfs");
                 if (!olist) {
@@ -3336,6 +3340,11 @@ void qemu_init(int argc, char **argv)
                     qemu_opt_set(fsdev, "max_xattr", max_xattr_str,
                                  &error_abort);
                 }
+                cache_timeout = qemu_opt_get(opts, "cache_timeout");
+                if (cache_timeout) {
+                    qemu_opt_set(fsdev, "cache_timeout", cache_timeout,
+                                 &error_abort);
+                }
                 device = qemu_opts_create(qemu_find_opts("device"), NULL, 0,
                                           &error_abort);
                 qemu_opt_set(device, "driver", "virtio-9p-pci", &error_abort);
@@ -3383,6 +3392,9 @@ void qemu_init(int argc, char **argv)
             case QEMU_OPTION_pidfile:
                 pid_file = optarg;
                 break;
+            case QEMU_OPTION_startup_profile:
+                startup_profile_set_output(optarg);
+                break;
             case QEMU_OPTION_win2k_hack:
                 object_register_sugar_prop("ide-device", "win2k-install-hack", "true", true);
                 break;
@@ -205,6 +205,21 @@ static inline int save_exception_flags(CPUX86State *env)
     return old_flags;
 }
 
+/*
+ * For the plain arithmetic helpers, leave inexact raised if the precision
+ * exception is both pending and masked (the mask bits in the control word
+ * line up with the status bits): raising it again cannot change the FPU
+ * state, and it lets softfloat use the host FPU for these operations.
+ */
+static inline int save_arith_exception_flags(CPUX86State *env)
+{
+    int old_flags = save_exception_flags(env);
+    if (env->fpus & env->fpuc & FPUS_PE) {
+        set_float_exception_flags(float_flag_inexact, &env->fp_status);
+    }
+    return old_flags;
+}
+
 static void merge_exception_flags(CPUX86State *env, int old_flags)
 {
     int new_flags = get_float_exception_flags(&env->fp_status);
@@ -220,7 +235,7 @@ static void merge_exception_flags(CPUX86State *env, int old_flags)
 
 static inline floatx80 helper_fdiv(CPUX86State *env, floatx80 a, floatx80 b)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     floatx80 ret = floatx80_div(a, b, &env->fp_status);
     merge_exception_flags(env, old_flags);
     return ret;
@@ -573,28 +588,28 @@ void helper_fucomi_ST0_FT0(CPUX86State *env)
 
 void helper_fadd_ST0_FT0(CPUX86State *env)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST0 = floatx80_add(ST0, FT0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
 
 void helper_fmul_ST0_FT0(CPUX86State *env)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST0 = floatx80_mul(ST0, FT0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
 
 void helper_fsub_ST0_FT0(CPUX86State *env)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST0 = floatx80_sub(ST0, FT0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
 
 void helper_fsubr_ST0_FT0(CPUX86State *env)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST0 = floatx80_sub(FT0, ST0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
@@ -613,28 +628,28 @@ void helper_fdivr_ST0_FT0(CPUX86State *env)
 
 void helper_fadd_STN_ST0(CPUX86State *env, int st_index)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST(st_index) = floatx80_add(ST(st_index), ST0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
 
 void helper_fmul_STN_ST0(CPUX86State *env, int st_index)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST(st_index) = floatx80_mul(ST(st_index), ST0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
 
 void helper_fsub_STN_ST0(CPUX86State *env, int st_index)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST(st_index) = floatx80_sub(ST(st_index), ST0, &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
 
 void helper_fsubr_STN_ST0(CPUX86State *env, int st_index)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     ST(st_index) = floatx80_sub(ST0, ST(st_index), &env->fp_status);
     merge_exception_flags(env, old_flags);
 }
@@ -2297,7 +2312,7 @@ void helper_fyl2x(CPUX86State *env)
 
 void helper_fsqrt(CPUX86State *env)
 {
-    int old_flags = save_exception_flags(env);
+    int old_flags = save_arith_exception_flags(env);
     if (floatx80_is_neg(ST0)) {
         env->fpus &= ~0x4700;  /* (C3,C2,C1,C0) <-- 0000 */
         env->fpus |= 0x400;
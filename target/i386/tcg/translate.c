@@ -169,6 +169,12 @@ typedef struct DisasContext {
  */
 #define DISAS_EOB_RECHECK_TF   DISAS_TARGET_4
 
+/*
+ * EIP has already been updated by a near return.  As for DISAS_JUMP,
+ * but check the prediction pushed by the matching call first.
+ */
+#define DISAS_JUMP_RET         DISAS_TARGET_5
+
 /* The environment in which user-only runs is constrained. */
 #ifdef CONFIG_USER_ONLY
 #define PE(S)     true
@@ -578,6 +584,25 @@ static TCGv eip_next_tl(DisasContext *s)
     }
 }
 
+/* The linear address of @eip, in the form used by x86_get_tb_cpu_state. */
+static TCGv_i64 gen_linear_pc(DisasContext *s, TCGv eip)
+{
+    TCGv_i64 pc = tcg_temp_new_i64();
+
+    tcg_gen_extu_tl_i64(pc, eip);
+    if (!CODE64(s)) {
+        tcg_gen_addi_i64(pc, pc, s->cs_base);
+        tcg_gen_ext32u_i64(pc, pc);
+    }
+    return pc;
+}
+
+/* Record the linear address of the next instruction as a return hint. */
+static void gen_push_return_hint(DisasContext *s)
+{
+    translator_push_return_hint(&s->base, gen_linear_pc(s, eip_next_tl(s)));
+}
+
 static TCGv eip_cur_tl(DisasContext *s)
 {
     assert(s->pc_save != -1);
@@ -2006,6 +2031,17 @@ gen_eob(DisasContext *s, int mode)
                /* give irqs a chance to happen */
                !inhibit_reset) {
         tcg_gen_lookup_and_goto_ptr();
+    } else if (mode == DISAS_JUMP_RET && !inhibit_reset) {
+        /*
+         * With jmp_opt a near return leaves the flags alone, unless
+         * gen_bnd_jmp may have cleared HF_MPX_IU_MASK.
+         */
+        if (s->jmp_opt && !(s->flags & HF_MPX_IU_MASK)) {
+            translator_lookup_and_goto_ptr_ret(&s->base,
+                                               gen_linear_pc(s, cpu_eip));
+        } else {
+            tcg_gen_lookup_and_goto_ptr_ret();
+        }
     } else {
         tcg_gen_exit_tb(NULL, 0);
     }
@@ -3595,6 +3631,7 @@ static void i386_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     case DISAS_EOB_ONLY:
     case DISAS_EOB_RECHECK_TF:
     case DISAS_JUMP:
+    case DISAS_JUMP_RET:
         gen_eob(dc, dc->base.is_jmp);
         break;
     default:
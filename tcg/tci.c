@@ -52,6 +52,9 @@ __thread uintptr_t tci_tb_ptr;
  *   n = immediate (call return length)
  *   r = register
  *   s = signed ldst offset
+ *
+ * A few fused instructions are followed by a second word holding
+ * a 32-bit displacement, relative to the end of that word.
  */
 
 static void tci_args_l(uint32_t insn, const void *tb_ptr, void **l0)
@@ -91,6 +94,13 @@ static void tci_args_ri(uint32_t insn, TCGReg *r0, tcg_target_ulong *i1)
     *i1 = sextract32(insn, 12, 20);
 }
 
+static void tci_args_rrc(uint32_t insn, TCGReg *r0, TCGReg *r1, TCGCond *c2)
+{
+    *r0 = extract32(insn, 8, 4);
+    *r1 = extract32(insn, 12, 4);
+    *c2 = extract32(insn, 16, 4);
+}
+
 static void tci_args_rrm(uint32_t insn, TCGReg *r0,
                          TCGReg *r1, MemOpIdx *m2)
 {
@@ -321,464 +331,564 @@ uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
     uint64_t stack[(TCG_STATIC_CALL_ARGS_SIZE + TCG_STATIC_FRAME_SIZE)
                    / sizeof(uint64_t)];
     bool carry = false;
+    uint32_t insn;
+    TCGReg r0, r1, r2, r3, r4;
+    tcg_target_ulong t1;
+    TCGCond condition;
+    uint8_t pos, len;
+    uint32_t tmp32;
+    uint64_t taddr;
+    MemOpIdx oi;
+    int32_t ofs;
+    void *ptr;
+
+    /*
+     * Threaded dispatch: each handler ends by fetching the next
+     * instruction and jumping directly to its handler, which gives
+     * the host branch predictor one indirect branch per opcode.
+     */
+    static const void * const dispatch[256] = {
+        [0 ... 255] = &&L_invalid,
+        [INDEX_op_call] = &&L_call,
+        [INDEX_op_br] = &&L_br,
+        [INDEX_op_setcond] = &&L_setcond,
+        [INDEX_op_movcond] = &&L_movcond,
+        [INDEX_op_mov] = &&L_mov,
+        [INDEX_op_tci_movi] = &&L_tci_movi,
+        [INDEX_op_tci_movl] = &&L_tci_movl,
+        [INDEX_op_tci_setcarry] = &&L_tci_setcarry,
+        [INDEX_op_ld8u] = &&L_ld8u,
+        [INDEX_op_ld8s] = &&L_ld8s,
+        [INDEX_op_ld16u] = &&L_ld16u,
+        [INDEX_op_ld16s] = &&L_ld16s,
+        [INDEX_op_ld] = &&L_ld,
+        [INDEX_op_st8] = &&L_st8,
+        [INDEX_op_st16] = &&L_st16,
+        [INDEX_op_st] = &&L_st,
+        [INDEX_op_add] = &&L_add,
+        [INDEX_op_sub] = &&L_sub,
+        [INDEX_op_mul] = &&L_mul,
+        [INDEX_op_and] = &&L_and,
+        [INDEX_op_or] = &&L_or,
+        [INDEX_op_xor] = &&L_xor,
+        [INDEX_op_andc] = &&L_andc,
+        [INDEX_op_orc] = &&L_orc,
+        [INDEX_op_eqv] = &&L_eqv,
+        [INDEX_op_nand] = &&L_nand,
+        [INDEX_op_nor] = &&L_nor,
+        [INDEX_op_neg] = &&L_neg,
+        [INDEX_op_not] = &&L_not,
+        [INDEX_op_ctpop] = &&L_ctpop,
+        [INDEX_op_addco] = &&L_addco,
+        [INDEX_op_addci] = &&L_addci,
+        [INDEX_op_addcio] = &&L_addcio,
+        [INDEX_op_subbo] = &&L_subbo,
+        [INDEX_op_subbi] = &&L_subbi,
+        [INDEX_op_subbio] = &&L_subbio,
+        [INDEX_op_muls2] = &&L_muls2,
+        [INDEX_op_mulu2] = &&L_mulu2,
+        [INDEX_op_tci_divs32] = &&L_tci_divs32,
+        [INDEX_op_tci_divu32] = &&L_tci_divu32,
+        [INDEX_op_tci_rems32] = &&L_tci_rems32,
+        [INDEX_op_tci_remu32] = &&L_tci_remu32,
+        [INDEX_op_tci_clz32] = &&L_tci_clz32,
+        [INDEX_op_tci_ctz32] = &&L_tci_ctz32,
+        [INDEX_op_tci_setcond32] = &&L_tci_setcond32,
+        [INDEX_op_tci_movcond32] = &&L_tci_movcond32,
+        [INDEX_op_shl] = &&L_shl,
+        [INDEX_op_shr] = &&L_shr,
+        [INDEX_op_sar] = &&L_sar,
+        [INDEX_op_tci_rotl32] = &&L_tci_rotl32,
+        [INDEX_op_tci_rotr32] = &&L_tci_rotr32,
+        [INDEX_op_deposit] = &&L_deposit,
+        [INDEX_op_extract] = &&L_extract,
+        [INDEX_op_sextract] = &&L_sextract,
+        [INDEX_op_tci_brcond] = &&L_tci_brcond,
+        [INDEX_op_tci_brcond32] = &&L_tci_brcond32,
+        [INDEX_op_bswap16] = &&L_bswap16,
+        [INDEX_op_bswap32] = &&L_bswap32,
+        [INDEX_op_ld32u] = &&L_ld32u,
+        [INDEX_op_ld32s] = &&L_ld32s,
+        [INDEX_op_st32] = &&L_st32,
+        [INDEX_op_divs] = &&L_divs,
+        [INDEX_op_divu] = &&L_divu,
+        [INDEX_op_rems] = &&L_rems,
+        [INDEX_op_remu] = &&L_remu,
+        [INDEX_op_clz] = &&L_clz,
+        [INDEX_op_ctz] = &&L_ctz,
+        [INDEX_op_rotl] = &&L_rotl,
+        [INDEX_op_rotr] = &&L_rotr,
+        [INDEX_op_ext_i32_i64] = &&L_ext_i32_i64,
+        [INDEX_op_extu_i32_i64] = &&L_extu_i32_i64,
+        [INDEX_op_bswap64] = &&L_bswap64,
+        [INDEX_op_exit_tb] = &&L_exit_tb,
+        [INDEX_op_goto_tb] = &&L_goto_tb,
+        [INDEX_op_goto_ptr] = &&L_goto_ptr,
+        [INDEX_op_qemu_ld] = &&L_qemu_ld,
+        [INDEX_op_tci_qemu_ld_rrr] = &&L_tci_qemu_ld_rrr,
+        [INDEX_op_qemu_st] = &&L_qemu_st,
+        [INDEX_op_tci_qemu_st_rrr] = &&L_tci_qemu_st_rrr,
+        [INDEX_op_mb] = &&L_mb,
+    };
+
+#define CASE(op)  L_##op
+#define NEXT()                                  \
+    do {                                        \
+        insn = *tb_ptr++;                       \
+        goto *dispatch[extract32(insn, 0, 8)];  \
+    } while (0)
 
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = (uintptr_t)stack;
     tci_assert(tb_ptr);
 
-    for (;;) {
-        uint32_t insn;
-        TCGOpcode opc;
-        TCGReg r0, r1, r2, r3, r4;
-        tcg_target_ulong t1;
-        TCGCond condition;
-        uint8_t pos, len;
-        uint32_t tmp32;
-        uint64_t taddr;
-        MemOpIdx oi;
-        int32_t ofs;
-        void *ptr;
-
-        insn = *tb_ptr++;
-        opc = extract32(insn, 0, 8);
-
-        switch (opc) {
-        case INDEX_op_call:
-            {
-                void *call_slots[MAX_CALL_IARGS];
-                ffi_cif *cif;
-                void *func;
-                unsigned i, s, n;
-
-                tci_args_nl(insn, tb_ptr, &len, &ptr);
-                func = ((void **)ptr)[0];
-                cif = ((void **)ptr)[1];
-
-                n = cif->nargs;
-                for (i = s = 0; i < n; ++i) {
-                    ffi_type *t = cif->arg_types[i];
-                    call_slots[i] = &stack[s];
-                    s += DIV_ROUND_UP(t->size, 8);
-                }
-
-                /* Helper functions may need to access the "return address" */
-                tci_tb_ptr = (uintptr_t)tb_ptr;
-                ffi_call(cif, func, stack, call_slots);
-            }
-
-            switch (len) {
-            case 0: /* void */
-                break;
-            case 1: /* uint32_t */
-                /*
-                 * The result winds up "left-aligned" in the stack[0] slot.
-                 * Note that libffi has an odd special case in that it will
-                 * always widen an integral result to ffi_arg.
-                 */
-                if (sizeof(ffi_arg) == 8) {
-                    regs[TCG_REG_R0] = (uint32_t)stack[0];
-                } else {
-                    regs[TCG_REG_R0] = *(uint32_t *)stack;
-                }
-                break;
-            case 2: /* uint64_t */
-                memcpy(&regs[TCG_REG_R0], stack, 8);
-                break;
-            case 3: /* Int128 */
-                memcpy(&regs[TCG_REG_R0], stack, 16);
-                break;
-            default:
-                g_assert_not_reached();
-            }
-            break;
-
-        case INDEX_op_br:
-            tci_args_l(insn, tb_ptr, &ptr);
-            tb_ptr = ptr;
-            continue;
-        case INDEX_op_setcond:
-            tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
-            regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
-            break;
-        case INDEX_op_movcond:
-            tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
-            tmp32 = tci_compare64(regs[r1], regs[r2], condition);
-            regs[r0] = regs[tmp32 ? r3 : r4];
-            break;
-        case INDEX_op_mov:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = regs[r1];
-            break;
-        case INDEX_op_tci_movi:
-            tci_args_ri(insn, &r0, &t1);
-            regs[r0] = t1;
-            break;
-        case INDEX_op_tci_movl:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            regs[r0] = *(tcg_target_ulong *)ptr;
-            break;
-        case INDEX_op_tci_setcarry:
-            carry = true;
-            break;
-
-            /* Load/store operations (32 bit). */
-
-        case INDEX_op_ld8u:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint8_t *)ptr;
-            break;
-        case INDEX_op_ld8s:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int8_t *)ptr;
-            break;
-        case INDEX_op_ld16u:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint16_t *)ptr;
-            break;
-        case INDEX_op_ld16s:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int16_t *)ptr;
-            break;
-        case INDEX_op_ld:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(tcg_target_ulong *)ptr;
-            break;
-        case INDEX_op_st8:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint8_t *)ptr = regs[r0];
-            break;
-        case INDEX_op_st16:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint16_t *)ptr = regs[r0];
-            break;
-        case INDEX_op_st:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(tcg_target_ulong *)ptr = regs[r0];
-            break;
-
-            /* Arithmetic operations (mixed 32/64 bit). */
-
-        case INDEX_op_add:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] + regs[r2];
-            break;
-        case INDEX_op_sub:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] - regs[r2];
-            break;
-        case INDEX_op_mul:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] * regs[r2];
-            break;
-        case INDEX_op_and:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] & regs[r2];
-            break;
-        case INDEX_op_or:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] | regs[r2];
-            break;
-        case INDEX_op_xor:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ^ regs[r2];
-            break;
-        case INDEX_op_andc:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] & ~regs[r2];
-            break;
-        case INDEX_op_orc:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] | ~regs[r2];
-            break;
-        case INDEX_op_eqv:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ~(regs[r1] ^ regs[r2]);
-            break;
-        case INDEX_op_nand:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ~(regs[r1] & regs[r2]);
-            break;
-        case INDEX_op_nor:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ~(regs[r1] | regs[r2]);
-            break;
-        case INDEX_op_neg:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = -regs[r1];
-            break;
-        case INDEX_op_not:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = ~regs[r1];
-            break;
-        case INDEX_op_ctpop:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = ctpop64(regs[r1]);
-            break;
-        case INDEX_op_addco:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            t1 = regs[r1] + regs[r2];
-            carry = t1 < regs[r1];
-            regs[r0] = t1;
-            break;
-        case INDEX_op_addci:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] + regs[r2] + carry;
-            break;
-        case INDEX_op_addcio:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            if (carry) {
-                t1 = regs[r1] + regs[r2] + 1;
-                carry = t1 <= regs[r1];
-            } else {
-                t1 = regs[r1] + regs[r2];
-                carry = t1 < regs[r1];
-            }
-            regs[r0] = t1;
-            break;
-        case INDEX_op_subbo:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            carry = regs[r1] < regs[r2];
-            regs[r0] = regs[r1] - regs[r2];
-            break;
-        case INDEX_op_subbi:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] - regs[r2] - carry;
-            break;
-        case INDEX_op_subbio:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            if (carry) {
-                carry = regs[r1] <= regs[r2];
-                regs[r0] = regs[r1] - regs[r2] - 1;
-            } else {
-                carry = regs[r1] < regs[r2];
-                regs[r0] = regs[r1] - regs[r2];
-            }
-            break;
-        case INDEX_op_muls2:
-            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-            muls64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
-            break;
-        case INDEX_op_mulu2:
-            tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
-            mulu64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
-            break;
-
-            /* Arithmetic operations (32 bit). */
-
-        case INDEX_op_tci_divs32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
-            break;
-        case INDEX_op_tci_divu32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
-            break;
-        case INDEX_op_tci_rems32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
-            break;
-        case INDEX_op_tci_remu32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
-            break;
-        case INDEX_op_tci_clz32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            tmp32 = regs[r1];
-            regs[r0] = tmp32 ? clz32(tmp32) : regs[r2];
-            break;
-        case INDEX_op_tci_ctz32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            tmp32 = regs[r1];
-            regs[r0] = tmp32 ? ctz32(tmp32) : regs[r2];
-            break;
-        case INDEX_op_tci_setcond32:
-            tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
-            regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
-            break;
-        case INDEX_op_tci_movcond32:
-            tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
-            tmp32 = tci_compare32(regs[r1], regs[r2], condition);
-            regs[r0] = regs[tmp32 ? r3 : r4];
-            break;
-
-            /* Shift/rotate operations. */
-
-        case INDEX_op_shl:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] << (regs[r2] % TCG_TARGET_REG_BITS);
-            break;
-        case INDEX_op_shr:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] >> (regs[r2] % TCG_TARGET_REG_BITS);
-            break;
-        case INDEX_op_sar:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ((tcg_target_long)regs[r1]
-                        >> (regs[r2] % TCG_TARGET_REG_BITS));
-            break;
-        case INDEX_op_tci_rotl32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = rol32(regs[r1], regs[r2] & 31);
-            break;
-        case INDEX_op_tci_rotr32:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ror32(regs[r1], regs[r2] & 31);
-            break;
-        case INDEX_op_deposit:
-            tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
-            regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
-            break;
-        case INDEX_op_extract:
-            tci_args_rrbb(insn, &r0, &r1, &pos, &len);
-            regs[r0] = extract64(regs[r1], pos, len);
-            break;
-        case INDEX_op_sextract:
-            tci_args_rrbb(insn, &r0, &r1, &pos, &len);
-            regs[r0] = sextract64(regs[r1], pos, len);
-            break;
-        case INDEX_op_brcond:
-            tci_args_rl(insn, tb_ptr, &r0, &ptr);
-            if (regs[r0]) {
-                tb_ptr = ptr;
-            }
-            break;
-        case INDEX_op_bswap16:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = bswap16(regs[r1]);
-            break;
-        case INDEX_op_bswap32:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = bswap32(regs[r1]);
-            break;
-
-            /* Load/store operations (64 bit). */
-
-        case INDEX_op_ld32u:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint32_t *)ptr;
-            break;
-        case INDEX_op_ld32s:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int32_t *)ptr;
-            break;
-        case INDEX_op_st32:
-            tci_args_rrs(insn, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint32_t *)ptr = regs[r0];
-            break;
-
-            /* Arithmetic operations (64 bit). */
-
-        case INDEX_op_divs:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
-            break;
-        case INDEX_op_divu:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
-            break;
-        case INDEX_op_rems:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
-            break;
-        case INDEX_op_remu:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
-            break;
-        case INDEX_op_clz:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ? clz64(regs[r1]) : regs[r2];
-            break;
-        case INDEX_op_ctz:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ? ctz64(regs[r1]) : regs[r2];
-            break;
+    NEXT();
 
-            /* Shift/rotate operations (64 bit). */
+CASE(call):
+    {
+        void *call_slots[MAX_CALL_IARGS];
+        ffi_cif *cif;
+        void *func;
+        unsigned i, s, n;
 
-        case INDEX_op_rotl:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = rol64(regs[r1], regs[r2] & 63);
-            break;
-        case INDEX_op_rotr:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            regs[r0] = ror64(regs[r1], regs[r2] & 63);
-            break;
-        case INDEX_op_ext_i32_i64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (int32_t)regs[r1];
-            break;
-        case INDEX_op_extu_i32_i64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = (uint32_t)regs[r1];
-            break;
-        case INDEX_op_bswap64:
-            tci_args_rr(insn, &r0, &r1);
-            regs[r0] = bswap64(regs[r1]);
-            break;
-
-            /* QEMU specific operations. */
-
-        case INDEX_op_exit_tb:
-            tci_args_l(insn, tb_ptr, &ptr);
-            return (uintptr_t)ptr;
-
-        case INDEX_op_goto_tb:
-            tci_args_l(insn, tb_ptr, &ptr);
-            tb_ptr = *(void **)ptr;
-            break;
-
-        case INDEX_op_goto_ptr:
-            tci_args_r(insn, &r0);
-            ptr = (void *)regs[r0];
-            if (!ptr) {
-                return 0;
-            }
-            tb_ptr = ptr;
-            break;
-
-        case INDEX_op_qemu_ld:
-            tci_args_rrm(insn, &r0, &r1, &oi);
-            taddr = regs[r1];
-            regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
-            break;
-        case INDEX_op_tci_qemu_ld_rrr:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            taddr = regs[r1];
-            oi = regs[r2];
-            regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
-            break;
+        tci_args_nl(insn, tb_ptr, &len, &ptr);
+        func = ((void **)ptr)[0];
+        cif = ((void **)ptr)[1];
+
+        n = cif->nargs;
+        for (i = s = 0; i < n; ++i) {
+            ffi_type *t = cif->arg_types[i];
+            call_slots[i] = &stack[s];
+            s += DIV_ROUND_UP(t->size, 8);
+        }
 
-        case INDEX_op_qemu_st:
-            tci_args_rrm(insn, &r0, &r1, &oi);
-            taddr = regs[r1];
-            tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
-            break;
-        case INDEX_op_tci_qemu_st_rrr:
-            tci_args_rrr(insn, &r0, &r1, &r2);
-            taddr = regs[r1];
-            oi = regs[r2];
-            tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
-            break;
+        /* Helper functions may need to access the "return address" */
+        tci_tb_ptr = (uintptr_t)tb_ptr;
+        ffi_call(cif, func, stack, call_slots);
+    }
 
-        case INDEX_op_mb:
-            /* Ensure ordering for all kinds */
-            smp_mb();
-            break;
-        default:
-            g_assert_not_reached();
+    switch (len) {
+    case 0: /* void */
+        break;
+    case 1: /* uint32_t */
+        /*
+         * The result winds up "left-aligned" in the stack[0] slot.
+         * Note that libffi has an odd special case in that it will
+         * always widen an integral result to ffi_arg.
+         */
+        if (sizeof(ffi_arg) == 8) {
+            regs[TCG_REG_R0] = (uint32_t)stack[0];
+        } else {
+            regs[TCG_REG_R0] = *(uint32_t *)stack;
         }
+        break;
+    case 2: /* uint64_t */
+        memcpy(&regs[TCG_REG_R0], stack, 8);
+        break;
+    case 3: /* Int128 */
+        memcpy(&regs[TCG_REG_R0], stack, 16);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    NEXT();
+
+CASE(br):
+    tci_args_l(insn, tb_ptr, &ptr);
+    tb_ptr = ptr;
+    NEXT();
+CASE(setcond):
+    tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
+    regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
+    NEXT();
+CASE(movcond):
+    tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
+    tmp32 = tci_compare64(regs[r1], regs[r2], condition);
+    regs[r0] = regs[tmp32 ? r3 : r4];
+    NEXT();
+CASE(mov):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = regs[r1];
+    NEXT();
+CASE(tci_movi):
+    tci_args_ri(insn, &r0, &t1);
+    regs[r0] = t1;
+    NEXT();
+CASE(tci_movl):
+    tci_args_rl(insn, tb_ptr, &r0, &ptr);
+    regs[r0] = *(tcg_target_ulong *)ptr;
+    NEXT();
+CASE(tci_setcarry):
+    carry = true;
+    NEXT();
+
+    /* Load/store operations (32 bit). */
+
+CASE(ld8u):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(uint8_t *)ptr;
+    NEXT();
+CASE(ld8s):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(int8_t *)ptr;
+    NEXT();
+CASE(ld16u):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(uint16_t *)ptr;
+    NEXT();
+CASE(ld16s):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(int16_t *)ptr;
+    NEXT();
+CASE(ld):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(tcg_target_ulong *)ptr;
+    NEXT();
+CASE(st8):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    *(uint8_t *)ptr = regs[r0];
+    NEXT();
+CASE(st16):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    *(uint16_t *)ptr = regs[r0];
+    NEXT();
+CASE(st):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    *(tcg_target_ulong *)ptr = regs[r0];
+    NEXT();
+
+    /* Arithmetic operations (mixed 32/64 bit). */
+
+CASE(add):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] + regs[r2];
+    NEXT();
+CASE(sub):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] - regs[r2];
+    NEXT();
+CASE(mul):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] * regs[r2];
+    NEXT();
+CASE(and):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] & regs[r2];
+    NEXT();
+CASE(or):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] | regs[r2];
+    NEXT();
+CASE(xor):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] ^ regs[r2];
+    NEXT();
+CASE(andc):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] & ~regs[r2];
+    NEXT();
+CASE(orc):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] | ~regs[r2];
+    NEXT();
+CASE(eqv):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = ~(regs[r1] ^ regs[r2]);
+    NEXT();
+CASE(nand):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = ~(regs[r1] & regs[r2]);
+    NEXT();
+CASE(nor):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = ~(regs[r1] | regs[r2]);
+    NEXT();
+CASE(neg):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = -regs[r1];
+    NEXT();
+CASE(not):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = ~regs[r1];
+    NEXT();
+CASE(ctpop):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = ctpop64(regs[r1]);
+    NEXT();
+CASE(addco):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    t1 = regs[r1] + regs[r2];
+    carry = t1 < regs[r1];
+    regs[r0] = t1;
+    NEXT();
+CASE(addci):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] + regs[r2] + carry;
+    NEXT();
+CASE(addcio):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    if (carry) {
+        t1 = regs[r1] + regs[r2] + 1;
+        carry = t1 <= regs[r1];
+    } else {
+        t1 = regs[r1] + regs[r2];
+        carry = t1 < regs[r1];
     }
+    regs[r0] = t1;
+    NEXT();
+CASE(subbo):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    carry = regs[r1] < regs[r2];
+    regs[r0] = regs[r1] - regs[r2];
+    NEXT();
+CASE(subbi):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] - regs[r2] - carry;
+    NEXT();
+CASE(subbio):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    if (carry) {
+        carry = regs[r1] <= regs[r2];
+        regs[r0] = regs[r1] - regs[r2] - 1;
+    } else {
+        carry = regs[r1] < regs[r2];
+        regs[r0] = regs[r1] - regs[r2];
+    }
+    NEXT();
+CASE(muls2):
+    tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+    muls64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
+    NEXT();
+CASE(mulu2):
+    tci_args_rrrr(insn, &r0, &r1, &r2, &r3);
+    mulu64(&regs[r0], &regs[r1], regs[r2], regs[r3]);
+    NEXT();
+
+    /* Arithmetic operations (32 bit). */
+
+CASE(tci_divs32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
+    NEXT();
+CASE(tci_divu32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
+    NEXT();
+CASE(tci_rems32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
+    NEXT();
+CASE(tci_remu32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
+    NEXT();
+CASE(tci_clz32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    tmp32 = regs[r1];
+    regs[r0] = tmp32 ? clz32(tmp32) : regs[r2];
+    NEXT();
+CASE(tci_ctz32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    tmp32 = regs[r1];
+    regs[r0] = tmp32 ? ctz32(tmp32) : regs[r2];
+    NEXT();
+CASE(tci_setcond32):
+    tci_args_rrrc(insn, &r0, &r1, &r2, &condition);
+    regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
+    NEXT();
+CASE(tci_movcond32):
+    tci_args_rrrrrc(insn, &r0, &r1, &r2, &r3, &r4, &condition);
+    tmp32 = tci_compare32(regs[r1], regs[r2], condition);
+    regs[r0] = regs[tmp32 ? r3 : r4];
+    NEXT();
+
+    /* Shift/rotate operations. */
+
+CASE(shl):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] << (regs[r2] % TCG_TARGET_REG_BITS);
+    NEXT();
+CASE(shr):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] >> (regs[r2] % TCG_TARGET_REG_BITS);
+    NEXT();
+CASE(sar):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = ((tcg_target_long)regs[r1]
+                >> (regs[r2] % TCG_TARGET_REG_BITS));
+    NEXT();
+CASE(tci_rotl32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = rol32(regs[r1], regs[r2] & 31);
+    NEXT();
+CASE(tci_rotr32):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = ror32(regs[r1], regs[r2] & 31);
+    NEXT();
+CASE(deposit):
+    tci_args_rrrbb(insn, &r0, &r1, &r2, &pos, &len);
+    regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
+    NEXT();
+CASE(extract):
+    tci_args_rrbb(insn, &r0, &r1, &pos, &len);
+    regs[r0] = extract64(regs[r1], pos, len);
+    NEXT();
+CASE(sextract):
+    tci_args_rrbb(insn, &r0, &r1, &pos, &len);
+    regs[r0] = sextract64(regs[r1], pos, len);
+    NEXT();
+CASE(tci_brcond):
+    tci_args_rrc(insn, &r0, &r1, &condition);
+    ofs = *tb_ptr++;
+    if (tci_compare64(regs[r0], regs[r1], condition)) {
+        tb_ptr = (const void *)tb_ptr + ofs;
+    }
+    NEXT();
+CASE(tci_brcond32):
+    tci_args_rrc(insn, &r0, &r1, &condition);
+    ofs = *tb_ptr++;
+    if (tci_compare32(regs[r0], regs[r1], condition)) {
+        tb_ptr = (const void *)tb_ptr + ofs;
+    }
+    NEXT();
+CASE(bswap16):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = bswap16(regs[r1]);
+    NEXT();
+CASE(bswap32):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = bswap32(regs[r1]);
+    NEXT();
+
+    /* Load/store operations (64 bit). */
+
+CASE(ld32u):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(uint32_t *)ptr;
+    NEXT();
+CASE(ld32s):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    regs[r0] = *(int32_t *)ptr;
+    NEXT();
+CASE(st32):
+    tci_args_rrs(insn, &r0, &r1, &ofs);
+    ptr = (void *)(regs[r1] + ofs);
+    *(uint32_t *)ptr = regs[r0];
+    NEXT();
+
+    /* Arithmetic operations (64 bit). */
+
+CASE(divs):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
+    NEXT();
+CASE(divu):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
+    NEXT();
+CASE(rems):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
+    NEXT();
+CASE(remu):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
+    NEXT();
+CASE(clz):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] ? clz64(regs[r1]) : regs[r2];
+    NEXT();
+CASE(ctz):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = regs[r1] ? ctz64(regs[r1]) : regs[r2];
+    NEXT();
+
+    /* Shift/rotate operations (64 bit). */
+
+CASE(rotl):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = rol64(regs[r1], regs[r2] & 63);
+    NEXT();
+CASE(rotr):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    regs[r0] = ror64(regs[r1], regs[r2] & 63);
+    NEXT();
+CASE(ext_i32_i64):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = (int32_t)regs[r1];
+    NEXT();
+CASE(extu_i32_i64):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = (uint32_t)regs[r1];
+    NEXT();
+CASE(bswap64):
+    tci_args_rr(insn, &r0, &r1);
+    regs[r0] = bswap64(regs[r1]);
+    NEXT();
+
+    /* QEMU specific operations. */
+
+CASE(exit_tb):
+    tci_args_l(insn, tb_ptr, &ptr);
+    return (uintptr_t)ptr;
+
+CASE(goto_tb):
+    tci_args_l(insn, tb_ptr, &ptr);
+    tb_ptr = *(void **)ptr;
+    NEXT();
+
+CASE(goto_ptr):
+    tci_args_r(insn, &r0);
+    ptr = (void *)regs[r0];
+    if (!ptr) {
+        return 0;
+    }
+    tb_ptr = ptr;
+    NEXT();
+
+CASE(qemu_ld):
+    tci_args_rrm(insn, &r0, &r1, &oi);
+    taddr = regs[r1];
+    regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
+    NEXT();
+CASE(tci_qemu_ld_rrr):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    taddr = regs[r1];
+    oi = regs[r2];
+    regs[r0] = tci_qemu_ld(env, taddr, oi, tb_ptr);
+    NEXT();
+
+CASE(qemu_st):
+    tci_args_rrm(insn, &r0, &r1, &oi);
+    taddr = regs[r1];
+    tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
+    NEXT();
+CASE(tci_qemu_st_rrr):
+    tci_args_rrr(insn, &r0, &r1, &r2);
+    taddr = regs[r1];
+    oi = regs[r2];
+    tci_qemu_st(env, taddr, regs[r0], oi, tb_ptr);
+    NEXT();
+
+CASE(mb):
+    /* Ensure ordering for all kinds */
+    smp_mb();
+    NEXT();
+L_invalid:
+    g_assert_not_reached();
+
+#undef CASE
+#undef NEXT
 }
 
 /*
@@ -866,11 +976,14 @@ int print_insn_tci(bfd_vma addr, disassemble_info *info)
         info->fprintf_func(info->stream, "%-12s  %d, %p", op_name, len, ptr);
         break;
 
-    case INDEX_op_brcond:
-        tci_args_rl(insn, tb_ptr, &r0, &ptr);
-        info->fprintf_func(info->stream, "%-12s  %s, 0, ne, %p",
-                           op_name, str_r(r0), ptr);
-        break;
+    case INDEX_op_tci_brcond:
+    case INDEX_op_tci_brcond32:
+        tci_args_rrc(insn, &r0, &r1, &c);
+        s2 = *tb_ptr++;
+        info->fprintf_func(info->stream, "%-12s  %s, %s, %s, %p",
+                           op_name, str_r(r0), str_r(r1), str_c(c),
+                           (void *)tb_ptr + s2);
+        return 2 * sizeof(insn);
 
     case INDEX_op_setcond:
     case INDEX_op_tci_setcond32:
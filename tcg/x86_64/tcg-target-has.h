@@ -37,6 +37,15 @@
 #define TCG_TARGET_HAS_v64              have_avx1
 #define TCG_TARGET_HAS_v128             have_avx1
 #define TCG_TARGET_HAS_v256             have_avx2
+/*
+ * For 512-bit vectors, every insn must have an EVEX encoding, which
+ * requires AVX512BW for byte and word elements and AVX512DQ for some
+ * quadword operations and for moving masks of dwords and qwords.
+ * The zmm forms of VPTERNLOGQ and VPROLV only need AVX512F; AVX512VL
+ * is implied by have_avx512bw, because the *_vec flags below apply to
+ * all vector sizes.
+ */
+#define TCG_TARGET_HAS_v512             (have_avx512bw && have_avx512dq)
 
 #define TCG_TARGET_HAS_andc_vec         1
 #define TCG_TARGET_HAS_orc_vec          have_avx512vl
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Arm, re-arm and cancel many timers on a single QEMUTimerList
+ */
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+
+enum timer_op {
+    OP_ARM,
+    OP_REARM,
+    OP_CANCEL,
+};
+
+struct benchmark {
+    const char * const name;
+    enum timer_op op;
+    bool arm_on_init;
+};
+
+static const struct benchmark benchmarks[] = {
+    {
+        .name = "Arm",
+        .op = OP_ARM,
+        .arm_on_init = false,
+    },
+    {
+        .name = "Rearm",
+        .op = OP_REARM,
+        .arm_on_init = true,
+    },
+    {
+        .name = "Cancel",
+        .op = OP_CANCEL,
+        .arm_on_init = true,
+    },
+};
+
+static QEMUTimerListGroup tlg;
+
+static void timer_cb(void *opaque)
+{
+}
+
+static void notify_cb(void *opaque, QEMUClockType type)
+{
+}
+
+static int64_t run_benchmark(const struct benchmark *bench, size_t n_timers)
+{
+    QEMUTimer *timers = g_new0(QEMUTimer, n_timers);
+    int64_t *expire = g_new(int64_t, n_timers);
+    size_t *order = g_new(size_t, n_timers);
+    GRand *rand = g_rand_new_with_seed(n_timers);
+
+    for (size_t i = 0; i < n_timers; i++) {
+        timer_init_full(&timers[i], &tlg, QEMU_CLOCK_VIRTUAL, SCALE_NS, 0,
+                        timer_cb, NULL);
+        expire[i] = g_rand_int_range(rand, 1, INT32_MAX);
+        order[i] = i;
+    }
+    for (size_t i = n_timers - 1; i > 0; i--) {
+        size_t j = g_rand_int_range(rand, 0, i + 1);
+        size_t tmp = order[i];
+
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    if (bench->arm_on_init) {
+        for (size_t i = 0; i < n_timers; i++) {
+            timer_mod_ns(&timers[i], expire[i]);
+        }
+    }
+
+    int64_t start_ns = get_clock();
+    switch (bench->op) {
+    case OP_ARM:
+        for (size_t i = 0; i < n_timers; i++) {
+            timer_mod_ns(&timers[i], expire[i]);
+        }
+        break;
+    case OP_REARM:
+        for (size_t i = 0; i < n_timers; i++) {
+            timer_mod_ns(&timers[order[i]], expire[i]);
+        }
+        break;
+    case OP_CANCEL:
+        for (size_t i = 0; i < n_timers; i++) {
+            timer_del(&timers[order[i]]);
+        }
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    int64_t ns = get_clock() - start_ns;
+
+    for (size_t i = 0; i < n_timers; i++) {
+        timer_del(&timers[i]);
+        timer_deinit(&timers[i]);
+    }
+    g_rand_free(rand);
+    g_free(order);
+    g_free(expire);
+    g_free(timers);
+
+    return ns;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizes[] = {
+        32,
+        1000,
+        10000,
+        100000,
+    };
+
+    timerlistgroup_init(&tlg, notify_cb, NULL);
+
+    double res[ARRAY_SIZE(benchmarks)][ARRAY_SIZE(sizes)];
+    for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+        size_t size = sizes[i];
+        for (int k = 0; k < ARRAY_SIZE(benchmarks); k++) {
+            const struct benchmark *bench = &benchmarks[k];
+
+            /* warm-up run */
+            run_benchmark(bench, size);
+
+            int64_t total_ns = 0;
+            int64_t n_runs = 0;
+            while (total_ns < 2e8 || n_runs < 5) {
+                total_ns += run_benchmark(bench, size);
+                n_runs++;
+            }
+            double ns_per_run = (double)total_ns / n_runs;
+
+            /* Throughput, in Mops/s */
+            res[k][i] = size / ns_per_run * 1e3;
+        }
+    }
+
+    printf("# Results' breakdown: Op and #Timers. Units: Mops/s\n");
+    printf("%10s ", "Op");
+    for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+        printf("%8zu ", sizes[i]);
+    }
+    printf("\n");
+    for (int k = 0; k < ARRAY_SIZE(benchmarks); k++) {
+        printf("%10s ", benchmarks[k].name);
+        for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+            printf("%8.2f ", res[k][i]);
+        }
+        printf("\n");
+    }
+
+    timerlistgroup_deinit(&tlg);
+    return 0;
+}
@@ -52,9 +52,11 @@ enum precision {
     PREC_SINGLE,
     PREC_DOUBLE,
     PREC_QUAD,
+    PREC_EXTENDED,
     PREC_FLOAT32,
     PREC_FLOAT64,
     PREC_FLOAT128,
+    PREC_FLOATX80,
     PREC_MAX_NR,
 };
 
@@ -93,6 +95,7 @@ union fp {
     float32 f32;
     float64 f64;
     float128 f128;
+    floatx80 fx80;
     uint64_t u64;
 };
 
@@ -121,6 +124,10 @@ static uint64_t random_ops[MAX_OPERANDS] = {
 static float128 random_quad_ops[MAX_OPERANDS] = {
     {SEED_A, SEED_B}, {SEED_B, SEED_C}, {SEED_C, SEED_A},
 };
+
+static floatx80 random_x80_ops[MAX_OPERANDS] = {
+    {SEED_A, SEED_B >> 48}, {SEED_B, SEED_C >> 48}, {SEED_C, SEED_A >> 48},
+};
 static float_status soft_status;
 static enum precision precision;
 static enum op operation;
@@ -185,6 +192,23 @@ static void update_random_ops(int n_ops, enum precision prec)
             random_quad_ops[i] = r;
             break;
         }
+        case PREC_EXTENDED:
+        case PREC_FLOATX80:
+        {
+            floatx80 r = random_x80_ops[i];
+            uint64_t hi = r.high;
+            uint64_t lo = r.low;
+            int exp;
+            do {
+                hi = xorshift64star(hi);
+                lo = xorshift64star(lo);
+                /* only normals, so the explicit integer bit must be set */
+                r = make_floatx80(hi & 0xffff, lo | (1ULL << 63));
+                exp = r.high & 0x7fff;
+            } while (exp == 0 || exp == 0x7fff);
+            random_x80_ops[i] = r;
+            break;
+        }
         default:
             g_assert_not_reached();
         }
@@ -219,6 +243,13 @@ static void fill_random(union fp *ops, int n_ops, enum precision prec,
                 ops[i].f128 = float128_chs(ops[i].f128);
             }
             break;
+        case PREC_EXTENDED:
+        case PREC_FLOATX80:
+            ops[i].fx80 = random_x80_ops[i];
+            if (no_neg && floatx80_is_neg(ops[i].fx80)) {
+                ops[i].fx80 = floatx80_chs(ops[i].fx80);
+            }
+            break;
         default:
             g_assert_not_reached();
         }
@@ -415,6 +446,37 @@ static void bench(enum precision prec, enum op op, int n_ops, bool no_neg)
                 }
             }
             break;
+        case PREC_FLOATX80:
+            fill_random(ops, n_ops, prec, no_neg);
+            t0 = get_clock();
+            for (i = 0; i < OPS_PER_ITER; i++) {
+                floatx80 a = ops[0].fx80;
+                floatx80 b = ops[1].fx80;
+
+                switch (op) {
+                case OP_ADD:
+                    res.fx80 = floatx80_add(a, b, &soft_status);
+                    break;
+                case OP_SUB:
+                    res.fx80 = floatx80_sub(a, b, &soft_status);
+                    break;
+                case OP_MUL:
+                    res.fx80 = floatx80_mul(a, b, &soft_status);
+                    break;
+                case OP_DIV:
+                    res.fx80 = floatx80_div(a, b, &soft_status);
+                    break;
+                case OP_SQRT:
+                    res.fx80 = floatx80_sqrt(a, &soft_status);
+                    break;
+                case OP_CMP:
+                    res.u64 = floatx80_compare_quiet(a, b, &soft_status);
+                    break;
+                default:
+                    g_assert_not_reached();
+                }
+            }
+            break;
         default:
             g_assert_not_reached();
         }
@@ -450,6 +512,17 @@ GEN_BENCH_ALL_TYPES(fma, OP_FMA, 3)
 GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
 #undef GEN_BENCH_ALL_TYPES
 
+/* there is no floatx80_muladd, so floatx80 gets its own list */
+#define GEN_BENCH_FLOATX80(opname, op, n_ops)                           \
+    GEN_BENCH(bench_ ## opname ## _floatx80, floatx80, PREC_FLOATX80, op, n_ops)
+
+GEN_BENCH_FLOATX80(add, OP_ADD, 2)
+GEN_BENCH_FLOATX80(sub, OP_SUB, 2)
+GEN_BENCH_FLOATX80(mul, OP_MUL, 2)
+GEN_BENCH_FLOATX80(div, OP_DIV, 2)
+GEN_BENCH_FLOATX80(cmp, OP_CMP, 2)
+#undef GEN_BENCH_FLOATX80
+
 #define GEN_BENCH_ALL_TYPES_NO_NEG(name, op, n)                         \
     GEN_BENCH_NO_NEG(bench_ ## name ## _float, float, PREC_SINGLE, op, n) \
     GEN_BENCH_NO_NEG(bench_ ## name ## _double, double, PREC_DOUBLE, op, n) \
@@ -460,6 +533,8 @@ GEN_BENCH_ALL_TYPES(cmp, OP_CMP, 2)
 GEN_BENCH_ALL_TYPES_NO_NEG(sqrt, OP_SQRT, 1)
 #undef GEN_BENCH_ALL_TYPES_NO_NEG
 
+GEN_BENCH_NO_NEG(bench_sqrt_floatx80, floatx80, PREC_FLOATX80, OP_SQRT, 1)
+
 #undef GEN_BENCH_NO_NEG
 #undef GEN_BENCH
 
@@ -472,16 +547,28 @@ GEN_BENCH_ALL_TYPES_NO_NEG(sqrt, OP_SQRT, 1)
         [PREC_FLOAT128]   = bench_ ## opname ## _float128,      \
     }
 
+#define GEN_BENCH_FUNCS_X80(opname, op)                         \
+    [op] = {                                                    \
+        [PREC_SINGLE]    = bench_ ## opname ## _float,          \
+        [PREC_DOUBLE]    = bench_ ## opname ## _double,         \
+        [PREC_FLOAT32]   = bench_ ## opname ## _float32,        \
+        [PREC_FLOAT64]   = bench_ ## opname ## _float64,        \
+        [PREC_FLOAT128]   = bench_ ## opname ## _float128,      \
+        [PREC_FLOATX80]  = bench_ ## opname ## _floatx80,       \
+    }
+
 static const bench_func_t bench_funcs[OP_MAX_NR][PREC_MAX_NR] = {
-    GEN_BENCH_FUNCS(add, OP_ADD),
-    GEN_BENCH_FUNCS(sub, OP_SUB),
-    GEN_BENCH_FUNCS(mul, OP_MUL),
-    GEN_BENCH_FUNCS(div, OP_DIV),
+    GEN_BENCH_FUNCS_X80(add, OP_ADD),
+    GEN_BENCH_FUNCS_X80(sub, OP_SUB),
+    GEN_BENCH_FUNCS_X80(mul, OP_MUL),
+    GEN_BENCH_FUNCS_X80(div, OP_DIV),
     GEN_BENCH_FUNCS(fma, OP_FMA),
-    GEN_BENCH_FUNCS(sqrt, OP_SQRT),
-    GEN_BENCH_FUNCS(cmp, OP_CMP),
+    GEN_BENCH_FUNCS_X80(sqrt, OP_SQRT),
+    GEN_BENCH_FUNCS_X80(cmp, OP_CMP),
 };
 
+#undef GEN_BENCH_FUNCS_X80
+
 #undef GEN_BENCH_FUNCS
 
 static void run_bench(void)
@@ -528,8 +615,8 @@ static void usage_complete(int argc, char *argv[])
     fprintf(stderr, " -h = show this help message.\n");
     fprintf(stderr, " -o = floating point operation (%s). Default: %s\n",
             op_list, op_names[0]);
-    fprintf(stderr, " -p = floating point precision (single, double, quad[soft only]). "
-            "Default: single\n");
+    fprintf(stderr, " -p = floating point precision (single, double, quad[soft only], "
+            "extended[soft only]). Default: single\n");
     fprintf(stderr, " -r = rounding mode (even, zero, down, up, tieaway). "
             "Default: even\n");
     fprintf(stderr, " -t = tester (%s). Default: %s\n",
@@ -651,6 +738,8 @@ static void parse_args(int argc, char *argv[])
                 precision = PREC_DOUBLE;
             } else if (!strcmp(optarg, "quad")) {
                 precision = PREC_QUAD;
+            } else if (!strcmp(optarg, "extended")) {
+                precision = PREC_EXTENDED;
             } else {
                 fprintf(stderr, "Unsupported precision '%s'\n", optarg);
                 exit(EXIT_FAILURE);
@@ -697,6 +786,9 @@ static void parse_args(int argc, char *argv[])
         case PREC_QUAD:
             precision = PREC_FLOAT128;
             break;
+        case PREC_EXTENDED:
+            precision = PREC_FLOATX80;
+            break;
         default:
             g_assert_not_reached();
         }
@@ -264,6 +264,70 @@ static void run_page_selectivity_test(QVTDTransMode mode)
     qtest_quit(qts);
 }
 
+/*
+ * Unmap test: clearing a leaf PTE and invalidating the page must make DMA to
+ * that IOVA fault, even though it was translated successfully before.  Besides
+ * the IOTLB this covers the per-thread DMA translation cache in physmem, which
+ * must drop its entry when the IOMMU sends the unmap notification.  The first
+ * DMA only arms that cache (its notifier is registered from a BH), so DMA
+ * twice to be sure that the translation is cached.
+ */
+static void run_unmap_test(QVTDTransMode mode)
+{
+    QTestState *qts;
+    QPCIBus *pcibus;
+    QPCIDevice *dev;
+    QPCIBar bar;
+    uint32_t tail = 0;
+    uint32_t result;
+    uint64_t pa_a;
+    int i;
+
+    if (!qtest_has_machine("q35")) {
+        g_test_skip("q35 machine not available");
+        return;
+    }
+
+    qts = qtest_initf("-machine q35 -smp 1 -m 512 -net none "
+                      "%s -device iommu-testdev",
+                      qvtd_iommu_args(mode));
+
+    if (!qvtd_check_caps(qts, mode)) {
+        qtest_quit(qts);
+        return;
+    }
+
+    dev = qvtd_setup_qtest_pci_device(qts, &pcibus, &bar);
+
+    pa_a = (QVTD_PT_VAL & VTD_PAGE_MASK_4K) + (QVTD_IOVA & 0xfff);
+
+    qvtd_build_translation(qts, mode, dev->devfn);
+    qvtd_program_regs(qts, Q35_HOST_BRIDGE_IOMMU_ADDR, mode);
+
+    for (i = 0; i < 2; i++) {
+        qtest_memset(qts, pa_a, 0, DMA_LEN);
+        result = qos_iommu_testdev_trigger_dma(dev, bar, QVTD_IOVA, pa_a,
+                                               DMA_LEN, 0);
+        g_assert_cmpuint(result, ==, 0);
+    }
+
+    /* Unmap the IOVA and invalidate it */
+    qtest_writeq(qts, qvtd_leaf_pte_addr(QVTD_IOVA), 0);
+    tail = qvtd_submit_iotlb_page_inv(qts, Q35_HOST_BRIDGE_IOMMU_ADDR,
+                                      QVTD_DOMAIN_ID, QVTD_IOVA, 0, tail);
+    tail = qvtd_submit_inv_wait_and_poll(qts, Q35_HOST_BRIDGE_IOMMU_ADDR,
+                                         tail);
+
+    qtest_memset(qts, pa_a, 0, DMA_LEN);
+    result = qos_iommu_testdev_trigger_dma(dev, bar, QVTD_IOVA, pa_a,
+                                           DMA_LEN, 0);
+    g_assert_cmpuint(result, ==, ITD_DMA_ERR_TX_FAIL);
+
+    g_free(dev);
+    qpci_free_pc(pcibus);
+    qtest_quit(qts);
+}
+
 /*
  * scalable-flt is covered here even though, per the VT-d spec, first-level
  * mappings are invalidated with the PASID-based descriptor
@@ -310,6 +374,13 @@ static void test_page_selectivity(const void *opaque)
     run_page_selectivity_test(*mode);
 }
 
+static void test_unmap(const void *opaque)
+{
+    const QVTDTransMode *mode = opaque;
+
+    run_unmap_test(*mode);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
@@ -342,5 +413,16 @@ int main(int argc, char **argv)
         g_free(path);
     }
 
+    for (size_t m = 0; m < ARRAY_SIZE(trans_modes); m++) {
+        QVTDTransMode *mode = g_new(QVTDTransMode, 1);
+        char *path;
+
+        *mode = trans_modes[m].mode;
+        path = g_strdup_printf("/iommu-testdev/intel/iotlb-inv/unmap/%s",
+                               trans_modes[m].name);
+        qtest_add_data_func_full(path, mode, test_unmap, g_free);
+        g_free(path);
+    }
+
     return g_test_run();
 }
@@ -150,6 +150,14 @@ static void test_precopy_file_mapped_ram(char *name, MigrateCommon *args)
     test_file_common(args, true);
 }
 
+static void test_precopy_file_mapped_ram_mmap(char *name, MigrateCommon *args)
+{
+    args->start.caps[MIGRATION_CAPABILITY_MAPPED_RAM] = true;
+    args->start.caps[MIGRATION_CAPABILITY_X_MAPPED_RAM_MMAP] = true;
+
+    test_file_common(args, true);
+}
+
 static void test_multifd_file_mapped_ram_live(char *name, MigrateCommon *args)
 {
     args->start.caps[MIGRATION_CAPABILITY_MULTIFD] = true;
@@ -322,6 +330,10 @@ void migration_test_add_file(MigrationTestEnv *env)
                        test_precopy_file_mapped_ram);
     migration_test_add("/migration/precopy/file/mapped-ram/live",
                        test_precopy_file_mapped_ram_live);
+#ifndef _WIN32
+    migration_test_add("/migration/precopy/file/mapped-ram/mmap",
+                       test_precopy_file_mapped_ram_mmap);
+#endif
 
     migration_test_add("/migration/multifd/file/mapped-ram",
                        test_multifd_file_mapped_ram);
@@ -13,7 +13,9 @@
 #include "libqtest.h"
 #include "libqos/pci.h"
 #include "libqos/pci-pc.h"
+#include "hw/pci/pci_regs.h"
 #include "hw/pci-host/q35.h"
+#include "hw/southbridge/ich9.h"
 #include "qobject/qdict.h"
 
 #define TSEG_SIZE_TEST_GUEST_RAM_MBYTES 128
@@ -240,6 +242,119 @@ static void test_smram_smbase_lock(void)
     qtest_quit(qts);
 }
 
+static gint flatview_dump_compare(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/*
+ * "info mtree -f" with the FlatView numbers stripped and the FlatViews
+ * sorted, as their order depends on a hash table.
+ */
+static char *flatview_dump(QTestState *qts)
+{
+    g_autofree char *out = qtest_hmp(qts, "info mtree -f");
+    g_auto(GStrv) views = g_strsplit(out, "FlatView #", -1);
+    g_autoptr(GPtrArray) sorted = g_ptr_array_new();
+    guint i;
+
+    /* views[0] is whatever comes before the first FlatView */
+    for (i = 1; views[i]; i++) {
+        char *eol = strchr(views[i], '\n');
+
+        g_ptr_array_add(sorted, eol ? eol + 1 : views[i]);
+    }
+    g_ptr_array_sort(sorted, flatview_dump_compare);
+    g_ptr_array_add(sorted, NULL);
+    return g_strjoinv("", (char **)sorted->pdata);
+}
+
+/*
+ * Compare the FlatViews after the incremental updates done so far with a
+ * rendering from scratch.  Starting and stopping global dirty logging
+ * regenerates all FlatViews, so let calc-dirty-rate do that.
+ */
+static void flatview_check(QTestState *qts)
+{
+    g_autofree char *incremental = flatview_dump(qts);
+    g_autofree char *full = NULL;
+    QDict *rsp;
+    bool measured;
+
+    qtest_qmp_assert_success(qts,
+                             "{ 'execute': 'calc-dirty-rate',"
+                             "  'arguments': { 'calc-time': 50,"
+                             "                 'calc-time-unit': 'millisecond',"
+                             "                 'mode': 'dirty-bitmap' } }");
+    do {
+        g_usleep(10 * 1000);
+        rsp = qtest_qmp_assert_success_ref(qts,
+                                           "{ 'execute': 'query-dirty-rate' }");
+        measured = !strcmp(qdict_get_str(rsp, "status"), "measured");
+        qobject_unref(rsp);
+    } while (!measured);
+
+    full = flatview_dump(qts);
+    g_assert_cmpstr(incremental, ==, full);
+}
+
+#define FLATVIEW_FLASH_SIZE (128 * 1024)
+
+static void test_flatview_incremental(void)
+{
+    g_autofree char *flash = NULL;
+    g_autofree uint8_t *buf = g_malloc0(FLATVIEW_FLASH_SIZE);
+    uint64_t flash_base = 0x100000000ULL - FLATVIEW_FLASH_SIZE;
+    QPCIBus *pcibus;
+    QPCIDevice *lpc, *testdev;
+    QTestState *qts;
+    int fd;
+
+    fd = g_file_open_tmp("q35-test-flash-XXXXXX", &flash, NULL);
+    g_assert(fd >= 0);
+    g_assert_cmpint(write(fd, buf, FLATVIEW_FLASH_SIZE), ==,
+                    FLATVIEW_FLASH_SIZE);
+    close(fd);
+
+    qts = qtest_initf("-M q35 -drive if=pflash,format=raw,file=%s "
+                      "-device pci-testdev,addr=4.0", flash);
+    pcibus = qpci_new_pc(qts, NULL);
+    lpc = qpci_device_find(pcibus, QPCI_DEVFN(ICH9_LPC_DEV, ICH9_LPC_FUNC));
+    g_assert(lpc != NULL);
+    testdev = qpci_device_find(pcibus, QPCI_DEVFN(4, 0));
+    g_assert(testdev != NULL);
+
+    /* The flash leaves ROMD mode; it is also mapped through isa-bios */
+    qtest_writeb(qts, flash_base, 0x90);
+    flatview_check(qts);
+    qtest_writeb(qts, flash_base, 0xff);
+    flatview_check(qts);
+
+    /* ACPI PM I/O space is moved with memory_region_set_address() */
+    qpci_config_writel(lpc, ICH9_LPC_PMBASE, 0x600 | 1);
+    qpci_config_writeb(lpc, ICH9_LPC_ACPI_CTRL, ICH9_LPC_ACPI_CTRL_ACPI_EN);
+    flatview_check(qts);
+    qpci_config_writel(lpc, ICH9_LPC_PMBASE, 0x700 | 1);
+    flatview_check(qts);
+    qpci_config_writeb(lpc, ICH9_LPC_ACPI_CTRL, 0);
+    flatview_check(qts);
+
+    /* Map, move and unmap a BAR */
+    qpci_config_writel(testdev, PCI_BASE_ADDRESS_0, 0xfe000000);
+    qpci_config_writew(testdev, PCI_COMMAND, PCI_COMMAND_MEMORY);
+    flatview_check(qts);
+    qpci_config_writel(testdev, PCI_BASE_ADDRESS_0, 0xfe100000);
+    flatview_check(qts);
+    qpci_config_writew(testdev, PCI_COMMAND, 0);
+    flatview_check(qts);
+
+    g_free(testdev);
+    g_free(lpc);
+    qpci_free_pc(pcibus);
+    qtest_quit(qts);
+    unlink(flash);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
@@ -252,6 +367,7 @@ int main(int argc, char **argv)
     qtest_add_data_func("/q35/tseg-size/ext/16mb", &tseg_ext_16mb,
                         test_tseg_size);
     qtest_add_func("/q35/smram/smbase_lock", test_smram_smbase_lock);
+    qtest_add_func("/q35/flatview/incremental", test_flatview_incremental);
 
     return g_test_run();
 }
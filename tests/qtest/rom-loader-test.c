@@ -0,0 +1,105 @@
+/*
+ * QTest testcase for ROM images that are read in the background
+ *
+ * ROM files of at least 1 MiB are read on a worker thread by rom_add_file(),
+ * while the machine is being created.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qemu/units.h"
+
+#define ROM_ADDR    0x100000
+#define ROM_SIZE    (2 * MiB + 3)
+
+static uint8_t *rom_pattern(void)
+{
+    uint8_t *data = g_malloc(ROM_SIZE);
+
+    for (size_t i = 0; i < ROM_SIZE; i++) {
+        data[i] = i ^ (i >> 12);
+    }
+    return data;
+}
+
+/* Returns a temporary file with the ROM pattern */
+static char *rom_file(void)
+{
+    g_autofree uint8_t *data = rom_pattern();
+    GError *err = NULL;
+    char *path;
+    int fd;
+
+    fd = g_file_open_tmp("rom-loader-XXXXXX", &path, &err);
+    g_assert_no_error(err);
+    g_assert_cmpint(qemu_write_full(fd, data, ROM_SIZE), ==, ROM_SIZE);
+    close(fd);
+    return path;
+}
+
+static void test_async_load(void)
+{
+    g_autofree char *path = rom_file();
+    g_autofree uint8_t *expected = rom_pattern();
+    g_autofree uint8_t *data = g_malloc(ROM_SIZE);
+    QTestState *qts;
+
+    qts = qtest_initf("-machine none -m 16M"
+                      " -device loader,file=%s,addr=0x%x,force-raw=on",
+                      path, ROM_ADDR);
+    qtest_bufread(qts, ROM_ADDR, data, ROM_SIZE);
+    g_assert(memcmp(data, expected, ROM_SIZE) == 0);
+
+    qtest_quit(qts);
+    unlink(path);
+}
+
+/* A ROM that cannot be read in full makes QEMU exit */
+static void test_read_error(void)
+{
+    g_autofree char *path = NULL;
+    g_autofree char *args = NULL;
+    QTestState *qts;
+    int fd;
+
+    /* Run in a subprocess to catch the error message */
+    if (!g_test_subprocess()) {
+        g_test_trap_subprocess(NULL, 0, 0);
+        g_test_trap_assert_passed();
+        g_test_trap_assert_stderr("*rom: file /dev/fdset/1*: error "
+                                  "file size changed while loading*");
+        return;
+    }
+
+    /*
+     * The file cannot be truncated between QEMU's open() and the worker's
+     * read() from here, so hand QEMU a descriptor positioned at the end of
+     * the file: the read comes up short in the same way.
+     */
+    path = rom_file();
+    fd = open(path, O_RDONLY);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(lseek(fd, 0, SEEK_END), ==, ROM_SIZE);
+    unlink(path);
+
+    args = g_strdup_printf("-machine none -m 16M -add-fd fd=%d,set=1"
+                           " -device loader,file=/dev/fdset/1,addr=0x%x,"
+                           "force-raw=on", fd, ROM_ADDR);
+    qts = qtest_init_ext(NULL, args, NULL, false);
+    qtest_set_expected_status(qts, 1);
+    qtest_wait_qemu(qts);
+    qtest_quit(qts);
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/rom-loader/async", test_async_load);
+    qtest_add_func("/rom-loader/read-error", test_read_error);
+
+    return g_test_run();
+}
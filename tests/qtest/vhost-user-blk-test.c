@@ -764,6 +764,123 @@ static void multiqueue(void *obj, void *data, QGuestAllocator *t_alloc)
     qpci_unplug_acpi_device_test(qts, "drv1", PCI_SLOT_HP);
 }
 
+static void multi_iothread_request(QTestState *qts, QVirtioDevice *dev,
+                                   QGuestAllocator *alloc, QVirtQueue *vq,
+                                   uint32_t type, uint64_t sector, char *buf)
+{
+    QVirtioBlkReq req;
+    uint64_t req_addr;
+    uint32_t free_head;
+    uint8_t status;
+
+    req.type = type;
+    req.ioprio = 1;
+    req.sector = sector;
+    req.data = g_malloc0(512);
+    if (type == VIRTIO_BLK_T_OUT) {
+        memcpy(req.data, buf, 512);
+    }
+
+    req_addr = virtio_blk_request(alloc, dev, &req, 512);
+
+    g_free(req.data);
+
+    free_head = qvirtqueue_add(qts, vq, req_addr, 16, false, true);
+    qvirtqueue_add(qts, vq, req_addr + 16, 512,
+                   type == VIRTIO_BLK_T_IN, true);
+    qvirtqueue_add(qts, vq, req_addr + 528, 1, true, false);
+
+    qvirtqueue_kick(qts, dev, vq, free_head);
+
+    qvirtio_wait_used_elem(qts, dev, vq, free_head, NULL,
+                           QVIRTIO_BLK_TIMEOUT_US);
+    status = readb(req_addr + 528);
+    g_assert_cmpint(status, ==, 0);
+
+    if (type == VIRTIO_BLK_T_IN) {
+        qtest_memread(qts, req_addr + 16, buf, 512);
+    }
+
+    guest_free(alloc, req_addr);
+}
+
+/*
+ * The export of the secondary disk spreads its 4 virtqueues over 2
+ * IOThreads.  Write a sector through each virtqueue and read it back
+ * through a virtqueue that is serviced by the other IOThread.
+ */
+static void multi_iothread(void *obj, void *data, QGuestAllocator *t_alloc)
+{
+    QVirtioPCIDevice *pdev1 = obj;
+    QVirtioPCIDevice *pdev;
+    QVirtioDevice *dev;
+    QTestState *qts = pdev1->pdev->bus->qts;
+    QVirtQueue *vqs[4];
+    uint64_t features;
+    char buf[512];
+    int i;
+
+    if (pdev1->pdev->bus->not_hotpluggable) {
+        g_test_skip("bus pci.0 does not support hotplug");
+        return;
+    }
+
+    qtest_qmp_device_add(qts, "vhost-user-blk-pci", "drv1",
+                         "{'addr': %s, 'chardev': 'char2', 'num-queues': 4}",
+                         stringify(PCI_SLOT_HP) ".0");
+
+    pdev = virtio_pci_new(pdev1->pdev->bus,
+                          &(QPCIAddress) {
+                              .devfn = QPCI_DEVFN(PCI_SLOT_HP, 0)
+                          });
+    g_assert_nonnull(pdev);
+    g_assert_cmpint(pdev->vdev.device_type, ==, VIRTIO_ID_BLOCK);
+
+    qos_object_start_hw(&pdev->obj);
+
+    dev = &pdev->vdev;
+    features = qvirtio_get_features(dev);
+    g_assert_cmpint(features & (1u << VIRTIO_BLK_F_MQ),
+                    ==,
+                    (1u << VIRTIO_BLK_F_MQ));
+    features = features & ~(QVIRTIO_F_BAD_FEATURE |
+                            (1u << VIRTIO_RING_F_INDIRECT_DESC) |
+                            (1u << VIRTIO_RING_F_EVENT_IDX) |
+                            (1u << VIRTIO_BLK_F_SCSI));
+    qvirtio_set_features(dev, features);
+
+    for (i = 0; i < ARRAY_SIZE(vqs); i++) {
+        vqs[i] = qvirtqueue_setup(dev, t_alloc, i);
+    }
+    qvirtio_set_driver_ok(dev);
+
+    for (i = 0; i < ARRAY_SIZE(vqs); i++) {
+        memset(buf, 0, sizeof(buf));
+        snprintf(buf, sizeof(buf), "TEST%d", i);
+        multi_iothread_request(qts, dev, t_alloc, vqs[i],
+                               VIRTIO_BLK_T_OUT, i, buf);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(vqs); i++) {
+        g_autofree char *expected = g_strdup_printf("TEST%d", i);
+
+        /* Virtqueue i + 1 is processed in the other IOThread */
+        multi_iothread_request(qts, dev, t_alloc,
+                               vqs[(i + 1) % ARRAY_SIZE(vqs)],
+                               VIRTIO_BLK_T_IN, i, buf);
+        g_assert_cmpstr(buf, ==, expected);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(vqs); i++) {
+        qvirtqueue_cleanup(dev->bus, vqs[i], t_alloc);
+    }
+    qvirtio_pci_device_disable(pdev);
+    qos_object_destroy(&pdev->obj);
+
+    /* unplug secondary disk */
+    qpci_unplug_acpi_device_test(qts, "drv1", PCI_SLOT_HP);
+}
+
 /*
  * Check that setting the vring addr on a non-existent virtqueue does
  * not crash.
@@ -893,10 +1010,10 @@ static void quit_storage_daemon(void *data)
 }
 
 static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
-                                 int num_queues)
+                                 int num_queues, int num_iothreads)
 {
     const char *vhost_user_blk_bin = qtest_qemu_storage_daemon_binary();
-    int i;
+    int i, j;
     gchar *img_path;
     GString *storage_daemon_command = g_string_new(NULL);
     QemuStorageDaemonState *qsd;
@@ -905,6 +1022,11 @@ static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
                            "exec %s ",
                            vhost_user_blk_bin);
 
+    for (j = 0; j < num_iothreads; j++) {
+        g_string_append_printf(storage_daemon_command,
+                               "--object iothread,id=iothread%d ", j);
+    }
+
     g_string_append_printf(cmd_line,
             " -object memory-backend-shm,id=mem,size=256M "
             " -M memory-backend=mem -m 256M ");
@@ -918,8 +1040,13 @@ static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
         g_string_append_printf(storage_daemon_command,
             "--blockdev driver=file,node-name=disk%d,filename=%s "
             "--export type=vhost-user-blk,id=disk%d,addr.type=fd,addr.str=%d,"
-            "node-name=disk%i,writable=on,num-queues=%d ",
+            "node-name=disk%i,writable=on,num-queues=%d",
             i, img_path, i, fd, i, num_queues);
+        for (j = 0; j < num_iothreads; j++) {
+            g_string_append_printf(storage_daemon_command,
+                                   ",iothread.%d=iothread%d", j, j);
+        }
+        g_string_append(storage_daemon_command, " ");
 
         g_string_append_printf(cmd_line, "-chardev socket,id=char%d,path=%s ",
                                i + 1, sock_path);
@@ -953,7 +1080,7 @@ static void start_vhost_user_blk(GString *cmd_line, int vus_instances,
 
 static void *vhost_user_blk_test_setup(GString *cmd_line, void *arg)
 {
-    start_vhost_user_blk(cmd_line, 1, 1);
+    start_vhost_user_blk(cmd_line, 1, 1, 0);
     return arg;
 }
 
@@ -967,13 +1094,20 @@ static void *vhost_user_blk_test_setup(GString *cmd_line, void *arg)
 static void *vhost_user_blk_hotplug_test_setup(GString *cmd_line, void *arg)
 {
     /* "-chardev socket,id=char2" is used for pci_hotplug*/
-    start_vhost_user_blk(cmd_line, 2, 1);
+    start_vhost_user_blk(cmd_line, 2, 1, 0);
     return arg;
 }
 
 static void *vhost_user_blk_multiqueue_test_setup(GString *cmd_line, void *arg)
 {
-    start_vhost_user_blk(cmd_line, 2, 8);
+    start_vhost_user_blk(cmd_line, 2, 8, 0);
+    return arg;
+}
+
+static void *vhost_user_blk_multi_iothread_test_setup(GString *cmd_line,
+                                                      void *arg)
+{
+    start_vhost_user_blk(cmd_line, 2, 4, 2);
     return arg;
 }
 
@@ -1009,6 +1143,10 @@ static void register_vhost_user_blk_test(void)
 
     opts.before = vhost_user_blk_multiqueue_test_setup;
     qos_add_test("multiqueue", "vhost-user-blk-pci", multiqueue, &opts);
+
+    opts.before = vhost_user_blk_multi_iothread_test_setup;
+    qos_add_test("multi-iothread", "vhost-user-blk-pci", multi_iothread,
+                 &opts);
 }
 
 libqos_init(register_vhost_user_blk_test);
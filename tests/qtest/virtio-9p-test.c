@@ -1030,6 +1030,31 @@ static void fs_local_xattr_limit_unlimited(void *obj, void *data,
     do_local_xattr_limit(obj, -1);
 }
 
+static void fs_local_cache(void *obj, void *data, QGuestAllocator *t_alloc)
+{
+    QVirtio9P *v9p = obj;
+    v9fs_set_allocator(t_alloc);
+    g_autofree char *host_dir = virtio_9p_test_path("10");
+
+    tattach({ .client = v9p });
+    tmkdir({ .client = v9p, .atPath = "/", .name = "10" });
+    tmkdir({ .client = v9p, .atPath = "/", .name = "11" });
+
+    /* populate the cache, then remove the directory behind QEMU's back */
+    twalk({ .client = v9p, .path = "10" });
+    g_assert(rmdir(host_dir) == 0);
+
+    /* still answered from the cache ... */
+    twalk({ .client = v9p, .path = "10" });
+
+    /* ... until the guest modifies the export itself */
+    tunlinkat({
+        .client = v9p, .atPath = "/", .name = "11",
+        .flags = P9_DOTL_AT_REMOVEDIR
+    });
+    twalk({ .client = v9p, .path = "10", .expectErr = ENOENT });
+}
+
 static void *synth_max_xattr_custom_opt(GString *cmd_line, void *arg)
 {
     virtio_9p_add_synth_driver_args(cmd_line, "max_xattr=100");
@@ -1082,6 +1107,12 @@ static void *local_max_xattr_unlimited_opt(GString *cmd_line, void *arg)
     return arg;
 }
 
+static void *local_cache_opt(GString *cmd_line, void *arg)
+{
+    assign_9p_local_driver_with_args(cmd_line, "cache_timeout=600000");
+    return arg;
+}
+
 static void register_virtio_9p_test(void)
 {
     QOSGraphTestOptions opts = {
@@ -1148,6 +1179,8 @@ static void register_virtio_9p_test(void)
     opts.before = local_max_xattr_unlimited_opt;
     qos_add_test("local/xattr_limit/unlimited", "virtio-9p",
                  fs_local_xattr_limit_unlimited, &opts);
+    opts.before = local_cache_opt;
+    qos_add_test("local/cache", "virtio-9p", fs_local_cache, &opts);
 }
 
 libqos_init(register_virtio_9p_test);
@@ -45,12 +45,40 @@ static void query_stats(void)
     qtest_quit(s);
 }
 
+static uint64_t completion_batch_age(const char *machine)
+{
+    QTestState *s = qtest_initf("-machine %s -device virtio-balloon,id=balloon"
+                                " -nodefaults", machine);
+    QDict *resp = qtest_qmp(
+        s,
+        "{ 'execute': 'qom-get', 'arguments': "                     \
+        "{ 'path': '/machine/peripheral/balloon/virtio-backend', "  \
+        "  'property': 'x-completion-batch-age-us' } }");
+    uint64_t ret;
+
+    g_assert(qdict_haskey(resp, "return"));
+    ret = qdict_get_int(resp, "return");
+
+    qobject_unref(resp);
+    qtest_quit(s);
+    return ret;
+}
+
+/* Completion batching is off for machine types older than 11.2 */
+static void completion_batching_compat(void)
+{
+    g_assert_cmpuint(completion_batch_age("q35"), ==, 50);
+    g_assert_cmpuint(completion_batch_age("pc-q35-11.1"), ==, 0);
+}
+
 int main(int argc, char **argv)
 {
     g_test_init(&argc, &argv, NULL);
 
     qtest_add_func("virtio-balloon/oss_fuzz_71649", oss_fuzz_71649);
     qtest_add_func("virtio-balloon/query-stats", query_stats);
+    qtest_add_func("virtio-balloon/completion-batching-compat",
+                   completion_batching_compat);
 
     return g_test_run();
 }
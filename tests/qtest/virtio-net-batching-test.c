@@ -0,0 +1,161 @@
+/*
+ * QTest testcase for virtio completion batching
+ *
+ * virtio-net flushes a TX burst inside a deferred section, so all of its
+ * completions are published with a single used index update.  The test
+ * makes the device transmit the used index itself: the payload of the
+ * second packet of a burst is the guest's view of used->idx while the
+ * device is still working on the burst.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qemu/bswap.h"
+#include "standard-headers/linux/virtio_ids.h"
+#include "standard-headers/linux/virtio_net.h"
+#include "libqos/libqos-pc.h"
+#include "libqos/virtio-pci.h"
+
+#define PCI_SLOT                0x04
+
+#define QVIRTIO_NET_TIMEOUT_US  (30 * 1000 * 1000)
+#define VNET_HDR_SIZE           sizeof(struct virtio_net_hdr_mrg_rxbuf)
+
+static const char payload[] = "TEST";
+
+/* Receive one packet from a stream socket netdev */
+static size_t recv_packet(int sock, void *buf, size_t size)
+{
+    uint32_t len;
+    int ret;
+
+    ret = recv(sock, &len, sizeof(len), MSG_WAITALL);
+    g_assert_cmpint(ret, ==, sizeof(len));
+    len = ntohl(len);
+    g_assert_cmpuint(len, <=, size);
+    ret = recv(sock, buf, len, MSG_WAITALL);
+    g_assert_cmpint(ret, ==, len);
+    return len;
+}
+
+static void wait_used(QTestState *qts, QVirtQueue *vq, uint32_t head)
+{
+    gint64 start_time = g_get_monotonic_time();
+    uint32_t got_head;
+
+    while (!qvirtqueue_get_buf(qts, vq, &got_head, NULL)) {
+        g_assert(g_get_monotonic_time() - start_time <=
+                 QVIRTIO_NET_TIMEOUT_US);
+    }
+    g_assert_cmpint(got_head, ==, head);
+}
+
+/*
+ * Transmit a burst of two packets and return used->idx as seen by the
+ * device when it sent the second one.
+ */
+static uint16_t used_idx_during_burst(const char *machine)
+{
+    QOSState *qs;
+    QTestState *qts;
+    QVirtioPCIDevice *dev;
+    QVirtioDevice *vdev;
+    QVirtQueue *vqs[2], *tx;
+    uint64_t features, hdr;
+    uint32_t head[2];
+    uint16_t used_idx;
+    char buffer[64];
+    int sv[2];
+
+    g_assert_cmpint(socketpair(PF_UNIX, SOCK_STREAM, 0, sv), !=, -1);
+    qs = qtest_pc_boot("-machine %s -netdev socket,fd=%d,id=hs0"
+                       " -device virtio-net-pci,netdev=hs0,addr=%x.0",
+                       machine, sv[1], PCI_SLOT);
+    qts = qs->qts;
+
+    dev = virtio_pci_new(qs->pcibus,
+                         &(QPCIAddress) { .devfn = QPCI_DEVFN(PCI_SLOT, 0) });
+    g_assert_nonnull(dev);
+    vdev = &dev->vdev;
+    g_assert_cmpint(vdev->device_type, ==, VIRTIO_ID_NET);
+    qvirtio_pci_device_enable(dev);
+    qvirtio_start_device(vdev);
+
+    features = qvirtio_get_features(vdev);
+    features &= ~(QVIRTIO_F_BAD_FEATURE |
+                  (1ull << VIRTIO_RING_F_INDIRECT_DESC) |
+                  (1ull << VIRTIO_RING_F_EVENT_IDX));
+    qvirtio_set_features(vdev, features);
+
+    for (int i = 0; i < ARRAY_SIZE(vqs); i++) {
+        vqs[i] = qvirtqueue_setup(vdev, &qs->alloc, i);
+    }
+    qvirtio_set_driver_ok(vdev);
+    tx = vqs[1];
+
+    hdr = guest_alloc(&qs->alloc, VNET_HDR_SIZE + sizeof(payload));
+    qtest_memset(qts, hdr, 0, VNET_HDR_SIZE);
+    qtest_memwrite(qts, hdr + VNET_HDR_SIZE, payload, sizeof(payload));
+
+    /* An ordinary packet... */
+    head[0] = qvirtqueue_add(qts, tx, hdr, VNET_HDR_SIZE + sizeof(payload),
+                             false, false);
+    /* ...and one whose payload is the used index of the TX queue */
+    head[1] = qvirtqueue_add(qts, tx, hdr, VNET_HDR_SIZE, false, true);
+    qvirtqueue_add(qts, tx, tx->used + 2, sizeof(used_idx), false, false);
+
+    /* Make both available before the device looks at the ring */
+    for (int i = 0; i < ARRAY_SIZE(head); i++) {
+        qtest_writew(qts, tx->avail + 4 + 2 * i, head[i]);
+    }
+    qvirtqueue_set_avail_idx(qts, vdev, tx, ARRAY_SIZE(head));
+    vdev->bus->virtqueue_kick(vdev, tx);
+
+    g_assert_cmpuint(recv_packet(sv[0], buffer, sizeof(buffer)), ==,
+                     sizeof(payload));
+    g_assert_cmpstr(buffer, ==, payload);
+    g_assert_cmpuint(recv_packet(sv[0], buffer, sizeof(buffer)), ==,
+                     sizeof(used_idx));
+    memcpy(&used_idx, buffer, sizeof(used_idx));
+
+    for (int i = 0; i < ARRAY_SIZE(head); i++) {
+        wait_used(qts, tx, head[i]);
+    }
+    g_assert_cmpint(qtest_readw(qts, tx->used + 2), ==, ARRAY_SIZE(head));
+
+    guest_free(&qs->alloc, hdr);
+    for (int i = 0; i < ARRAY_SIZE(vqs); i++) {
+        qvirtqueue_cleanup(vdev->bus, vqs[i], &qs->alloc);
+    }
+    qos_object_destroy((QOSGraphObject *)dev);
+    g_free(dev);
+    qtest_shutdown(qs);
+    close(sv[0]);
+    close(sv[1]);
+
+    return le16_to_cpu(used_idx);
+}
+
+/* The whole burst is published when the deferred section ends */
+static void test_batched(void)
+{
+    g_assert_cmpint(used_idx_during_burst("pc"), ==, 0);
+}
+
+/* Machine types older than 11.2 publish each completion on its own */
+static void test_compat(void)
+{
+    g_assert_cmpint(used_idx_during_burst("pc-i440fx-11.1"), ==, 1);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("virtio-net/completion-batching/batched", test_batched);
+    qtest_add_func("virtio-net/completion-batching/compat", test_compat);
+
+    return g_test_run();
+}
@@ -0,0 +1,385 @@
+/*
+ * QTest testcase for virtio-net with iothread-vq-mapping
+ *
+ * The traffic tests need a multiqueue tap device, so they are skipped
+ * unless the test may create one.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include <net/if.h>
+#include <netpacket/packet.h>
+#include <linux/if_tun.h>
+#include "libqtest.h"
+#include "qemu/bswap.h"
+#include "qemu/cutils.h"
+#include "qobject/qdict.h"
+#include "standard-headers/linux/virtio_ids.h"
+#include "standard-headers/linux/virtio_net.h"
+#include "libqos/libqos-pc.h"
+#include "libqos/virtio-pci.h"
+
+#define PCI_SLOT                0x04
+
+#define QVIRTIO_NET_TIMEOUT_US  (30 * 1000 * 1000)
+#define VNET_HDR_SIZE           sizeof(struct virtio_net_hdr_mrg_rxbuf)
+#define RX_BUF_SIZE             2048
+
+#define TEST_QUEUE_PAIRS        2
+/* IEEE 802 local experimental ethertype, the host stack ignores it */
+#define TEST_ETH_P              0x88b5
+#define TEST_FRAME_LEN          60
+
+#ifndef ETH_P_RARP
+#define ETH_P_RARP 0x8035
+#endif
+
+#define IOTHREADS " -object iothread,id=t0 -object iothread,id=t1 "
+
+typedef struct TestTap {
+    char ifname[IFNAMSIZ];
+    int fds[TEST_QUEUE_PAIRS];
+} TestTap;
+
+static void test_tap_close(TestTap *tap)
+{
+    for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+        if (tap->fds[i] >= 0) {
+            close(tap->fds[i]);
+        }
+    }
+}
+
+/* Create a multiqueue tap device and bring its link up */
+static bool test_tap_open(TestTap *tap)
+{
+    struct ifreq ifr = { 0 };
+    int s, ret;
+
+    for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+        tap->fds[i] = -1;
+    }
+
+    pstrcpy(ifr.ifr_name, IFNAMSIZ, "qtest%d");
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_MULTI_QUEUE;
+    for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+        /* The first TUNSETIFF fills in the name the others attach to */
+        tap->fds[i] = open("/dev/net/tun", O_RDWR);
+        if (tap->fds[i] < 0 || ioctl(tap->fds[i], TUNSETIFF, &ifr) < 0) {
+            test_tap_close(tap);
+            return false;
+        }
+    }
+    pstrcpy(tap->ifname, sizeof(tap->ifname), ifr.ifr_name);
+
+    s = socket(AF_INET, SOCK_DGRAM, 0);
+    g_assert_cmpint(s, >=, 0);
+    ret = ioctl(s, SIOCGIFFLAGS, &ifr);
+    if (!ret) {
+        ifr.ifr_flags |= IFF_UP;
+        ret = ioctl(s, SIOCSIFFLAGS, &ifr);
+    }
+    close(s);
+    if (ret < 0) {
+        test_tap_close(tap);
+        return false;
+    }
+    return true;
+}
+
+/* A packet socket on the host side of the tap that only sees @proto */
+static int test_tap_socket(TestTap *tap, uint16_t proto)
+{
+    struct sockaddr_ll sll = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(proto),
+        .sll_ifindex = if_nametoindex(tap->ifname),
+    };
+    struct timeval tv = { .tv_sec = QVIRTIO_NET_TIMEOUT_US / 1000000 };
+    int s;
+
+    s = socket(AF_PACKET, SOCK_RAW, htons(proto));
+    g_assert_cmpint(s, >=, 0);
+    g_assert_cmpint(bind(s, (struct sockaddr *)&sll, sizeof(sll)), ==, 0);
+    g_assert_cmpint(setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)),
+                    ==, 0);
+    return s;
+}
+
+/* Pass the tap queues to QEMU as netdev "n0" */
+static void test_tap_add_netdev(TestTap *tap, QTestState *qts, bool vhost)
+{
+    g_autoptr(GString) fds = g_string_new(NULL);
+
+    for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+        g_autofree char *name = g_strdup_printf("tap%d", i);
+
+        qtest_qmp_fds_assert_success(qts, &tap->fds[i], 1,
+                                     "{'execute': 'getfd',"
+                                     " 'arguments': {'fdname': %s}}", name);
+        g_string_append_printf(fds, "%s%s", i ? ":" : "", name);
+    }
+
+    qtest_qmp_assert_success(qts,
+                             "{'execute': 'netdev_add', 'arguments': {"
+                             " 'type': 'tap', 'id': 'n0', 'fds': %s,"
+                             " 'vhost': %i}}", fds->str, vhost);
+}
+
+static void test_frame(uint8_t *frame, const char *payload)
+{
+    static const uint8_t hdr[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x52, 0x54, 0x00, 0x12, 0x34, 0x56,
+        TEST_ETH_P >> 8, TEST_ETH_P & 0xff,
+    };
+
+    memset(frame, 0, TEST_FRAME_LEN);
+    memcpy(frame, hdr, sizeof(hdr));
+    pstrcpy((char *)frame + sizeof(hdr), TEST_FRAME_LEN - sizeof(hdr),
+            payload);
+}
+
+static void set_queue_pairs(QOSState *qs, QVirtioDevice *vdev,
+                            QVirtQueue *ctrl, uint16_t pairs)
+{
+    QTestState *qts = qs->qts;
+    struct virtio_net_ctrl_hdr hdr = {
+        .class = VIRTIO_NET_CTRL_MQ,
+        .cmd = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET,
+    };
+    uint16_t data = cpu_to_le16(pairs);
+    uint64_t addr;
+    uint32_t free_head;
+
+    addr = guest_alloc(&qs->alloc, sizeof(hdr) + sizeof(data) + 1);
+    qtest_memwrite(qts, addr, &hdr, sizeof(hdr));
+    qtest_memwrite(qts, addr + sizeof(hdr), &data, sizeof(data));
+
+    free_head = qvirtqueue_add(qts, ctrl, addr, sizeof(hdr) + sizeof(data),
+                               false, true);
+    qvirtqueue_add(qts, ctrl, addr + sizeof(hdr) + sizeof(data), 1,
+                   true, false);
+    qvirtqueue_kick(qts, vdev, ctrl, free_head);
+
+    qvirtio_wait_used_elem(qts, vdev, ctrl, free_head, NULL,
+                           QVIRTIO_NET_TIMEOUT_US);
+    g_assert_cmpint(qtest_readb(qts, addr + sizeof(hdr) + sizeof(data)), ==,
+                    VIRTIO_NET_OK);
+
+    guest_free(&qs->alloc, addr);
+}
+
+/*
+ * The tap device picks the queue for a frame from the host, so give every
+ * queue pair a receive buffer.  The host stack may send its own frames
+ * (e.g. IPv6 neighbour discovery) first; those buffers are given back.
+ */
+static void rx_test(QOSState *qs, QVirtioDevice *vdev, QVirtQueue **vqs,
+                    int sock)
+{
+    QTestState *qts = qs->qts;
+    uint8_t frame[TEST_FRAME_LEN];
+    uint8_t buffer[TEST_FRAME_LEN];
+    uint64_t req_addr[TEST_QUEUE_PAIRS];
+    uint32_t free_head[TEST_QUEUE_PAIRS];
+    gint64 start_time = g_get_monotonic_time();
+    bool received = false;
+
+    for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+        req_addr[i] = guest_alloc(&qs->alloc, RX_BUF_SIZE);
+        free_head[i] = qvirtqueue_add(qts, vqs[i * 2], req_addr[i],
+                                      RX_BUF_SIZE, true, false);
+        qvirtqueue_kick(qts, vdev, vqs[i * 2], free_head[i]);
+    }
+
+    test_frame(frame, "RX");
+    g_assert_cmpint(send(sock, frame, sizeof(frame), 0), ==, sizeof(frame));
+
+    while (!received) {
+        for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+            QVirtQueue *rx = vqs[i * 2];
+            uint32_t desc_idx, len;
+
+            if (!qvirtqueue_get_buf(qts, rx, &desc_idx, &len)) {
+                continue;
+            }
+            g_assert_cmpint(desc_idx, ==, free_head[i]);
+
+            qtest_memread(qts, req_addr[i] + VNET_HDR_SIZE, buffer,
+                          sizeof(buffer));
+            if (len == VNET_HDR_SIZE + sizeof(frame) &&
+                !memcmp(buffer, frame, sizeof(frame))) {
+                received = true;
+                break;
+            }
+
+            free_head[i] = qvirtqueue_add(qts, rx, req_addr[i], RX_BUF_SIZE,
+                                          true, false);
+            qvirtqueue_kick(qts, vdev, rx, free_head[i]);
+        }
+        g_assert(g_get_monotonic_time() - start_time <= QVIRTIO_NET_TIMEOUT_US);
+    }
+
+    for (int i = 0; i < TEST_QUEUE_PAIRS; i++) {
+        guest_free(&qs->alloc, req_addr[i]);
+    }
+}
+
+static void tx_test(QOSState *qs, QVirtioDevice *vdev, QVirtQueue *tx,
+                    int sock, const char *payload)
+{
+    QTestState *qts = qs->qts;
+    uint8_t frame[TEST_FRAME_LEN];
+    uint8_t buffer[RX_BUF_SIZE];
+    uint64_t req_addr;
+    uint32_t free_head;
+
+    test_frame(frame, payload);
+    req_addr = guest_alloc(&qs->alloc, VNET_HDR_SIZE + sizeof(frame));
+    qtest_memset(qts, req_addr, 0, VNET_HDR_SIZE);
+    qtest_memwrite(qts, req_addr + VNET_HDR_SIZE, frame, sizeof(frame));
+
+    free_head = qvirtqueue_add(qts, tx, req_addr,
+                               VNET_HDR_SIZE + sizeof(frame), false, false);
+    qvirtqueue_kick(qts, vdev, tx, free_head);
+
+    qvirtio_wait_used_elem(qts, vdev, tx, free_head, NULL,
+                           QVIRTIO_NET_TIMEOUT_US);
+    guest_free(&qs->alloc, req_addr);
+
+    g_assert_cmpint(recv(sock, buffer, sizeof(buffer), 0), ==, sizeof(frame));
+    g_assert_cmpmem(buffer, sizeof(frame), frame, sizeof(frame));
+}
+
+/* Every queue pair is serviced by its own IOThread */
+static void test_traffic(void)
+{
+    TestTap tap;
+    QOSState *qs;
+    QVirtioPCIDevice *dev;
+    QVirtioDevice *vdev;
+    QVirtQueue *vqs[TEST_QUEUE_PAIRS * 2 + 1];
+    uint64_t features;
+    uint8_t buffer[RX_BUF_SIZE];
+    int sock, rarp;
+
+    if (!test_tap_open(&tap)) {
+        g_test_skip("cannot create a multiqueue tap device");
+        return;
+    }
+    sock = test_tap_socket(&tap, TEST_ETH_P);
+    rarp = test_tap_socket(&tap, ETH_P_RARP);
+
+    qs = qtest_pc_boot(IOTHREADS);
+    test_tap_add_netdev(&tap, qs->qts, false);
+    qtest_qmp_device_add(qs->qts, "virtio-net-pci", "net0",
+                         "{'addr': %s, 'netdev': 'n0', 'mq': true,"
+                         " 'iothread-vq-mapping': [{'iothread': 't0'},"
+                         "                         {'iothread': 't1'}]}",
+                         stringify(PCI_SLOT) ".0");
+
+    dev = virtio_pci_new(qs->pcibus,
+                         &(QPCIAddress) { .devfn = QPCI_DEVFN(PCI_SLOT, 0) });
+    g_assert_nonnull(dev);
+    vdev = &dev->vdev;
+    g_assert_cmpint(vdev->device_type, ==, VIRTIO_ID_NET);
+    qvirtio_pci_device_enable(dev);
+    qvirtio_start_device(vdev);
+
+    features = qvirtio_get_features(vdev);
+    g_assert(features & (1ull << VIRTIO_NET_F_MQ));
+    features &= ~(QVIRTIO_F_BAD_FEATURE |
+                  (1ull << VIRTIO_RING_F_INDIRECT_DESC) |
+                  (1ull << VIRTIO_RING_F_EVENT_IDX));
+    qvirtio_set_features(vdev, features);
+    g_assert_cmpint(qvirtio_config_readw(vdev, 8), ==, TEST_QUEUE_PAIRS);
+
+    for (int i = 0; i < ARRAY_SIZE(vqs); i++) {
+        vqs[i] = qvirtqueue_setup(vdev, &qs->alloc, i);
+    }
+    qvirtio_set_driver_ok(vdev);
+    set_queue_pairs(qs, vdev, vqs[TEST_QUEUE_PAIRS * 2], TEST_QUEUE_PAIRS);
+
+    rx_test(qs, vdev, vqs, sock);
+    tx_test(qs, vdev, vqs[1], sock, "TX0");
+    tx_test(qs, vdev, vqs[3], sock, "TX1");
+
+    /* The self-announcement goes out through the IOThread of queue pair 0 */
+    qtest_qmp_assert_success(qs->qts,
+                             "{'execute': 'announce-self', 'arguments': {"
+                             " 'initial': 50, 'max': 550, 'rounds': 1,"
+                             " 'step': 50}}");
+    g_assert_cmpint(recv(rarp, buffer, sizeof(buffer), 0), ==, 60);
+
+    for (int i = 0; i < ARRAY_SIZE(vqs); i++) {
+        qvirtqueue_cleanup(vdev->bus, vqs[i], &qs->alloc);
+    }
+    qos_object_destroy((QOSGraphObject *)dev);
+    g_free(dev);
+    qtest_shutdown(qs);
+    close(rarp);
+    close(sock);
+    test_tap_close(&tap);
+}
+
+static void device_add_error(QTestState *qts, const char *netdev,
+                             const char *tx, const char *expected)
+{
+    QDict *err = qtest_qmp_assert_failure_ref(
+        qts,
+        "{'execute': 'device_add', 'arguments': {"
+        " 'driver': 'virtio-net-pci', 'netdev': %s, 'tx': %s,"
+        " 'iothread-vq-mapping': [{'iothread': 't0'}]}}", netdev, tx);
+
+    g_assert_nonnull(strstr(qdict_get_str(err, "desc"), expected));
+    qobject_unref(err);
+}
+
+static void test_realize_errors(void)
+{
+    QTestState *qts = qtest_init(IOTHREADS
+                                 "-netdev hubport,hubid=0,id=n0 "
+                                 "-netdev hubport,hubid=0,id=n1 "
+                                 "-object filter-buffer,id=f1,netdev=n1,"
+                                 "interval=1000");
+
+    device_add_error(qts, "n0", "timer", "iothread-vq-mapping requires tx=bh");
+    device_add_error(qts, "n0", "bh", "requires a netdev that can run in an "
+                     "IOThread");
+    device_add_error(qts, "n1", "bh", "cannot be used with net filters");
+
+    qtest_quit(qts);
+}
+
+static void test_realize_error_vhost(void)
+{
+    TestTap tap;
+    QTestState *qts;
+
+    if (access("/dev/vhost-net", R_OK | W_OK) || !test_tap_open(&tap)) {
+        g_test_skip("cannot create a tap device with vhost-net");
+        return;
+    }
+
+    qts = qtest_init(IOTHREADS);
+    test_tap_add_netdev(&tap, qts, true);
+    device_add_error(qts, "n0", "bh", "cannot be used with vhost");
+
+    qtest_quit(qts);
+    test_tap_close(&tap);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("virtio-net/iothread-vq-mapping/traffic", test_traffic);
+    qtest_add_func("virtio-net/iothread-vq-mapping/realize-errors",
+                   test_realize_errors);
+    qtest_add_func("virtio-net/iothread-vq-mapping/realize-error-vhost",
+                   test_realize_error_vhost);
+
+    return g_test_run();
+}
@@ -0,0 +1,174 @@
+/*
+ * SVE unpredicated integer operations at every vector length
+ *
+ * These are expanded with the generic vector ops, so vector lengths of
+ * 64 bytes and more use 512-bit host vectors where the host has them.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/prctl.h>
+
+#define MAX_VL 256
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+static uint8_t a[MAX_VL], b[MAX_VL], d[MAX_VL];
+
+enum { ADD, SUB, UQADD, UQSUB, SQADD, AND, ORR, EOR, BIC, LSL, LSR, ASR, ONES };
+
+#define SVE_OP(NAME, INSN)                          \
+static void NAME(void)                              \
+{                                                   \
+    asm volatile("ldr z0, [%1]\n\t"                 \
+                 "ldr z1, [%2]\n\t"                 \
+                 INSN "\n\t"                        \
+                 "str z2, [%0]"                     \
+                 : : "r"(d), "r"(a), "r"(b)         \
+                 : "z0", "z1", "z2", "memory");     \
+}
+
+SVE_OP(add_b, "add z2.b, z0.b, z1.b")
+SVE_OP(add_d, "add z2.d, z0.d, z1.d")
+SVE_OP(sub_h, "sub z2.h, z0.h, z1.h")
+SVE_OP(uqadd_b, "uqadd z2.b, z0.b, z1.b")
+SVE_OP(uqsub_h, "uqsub z2.h, z0.h, z1.h")
+SVE_OP(sqadd_s, "sqadd z2.s, z0.s, z1.s")
+SVE_OP(and_d, "and z2.d, z0.d, z1.d")
+SVE_OP(orr_d, "orr z2.d, z0.d, z1.d")
+SVE_OP(eor_d, "eor z2.d, z0.d, z1.d")
+SVE_OP(bic_d, "bic z2.d, z0.d, z1.d")
+SVE_OP(lsl_h, "lsl z2.h, z0.h, #3")
+SVE_OP(lsr_s, "lsr z2.s, z0.s, #7")
+SVE_OP(asr_d, "asr z2.d, z0.d, #13")
+SVE_OP(ones_b, "mov z2.b, #-1")
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+    int op;
+    int esize;
+} tests[] = {
+    { "add.b", add_b, ADD, 1 },
+    { "add.d", add_d, ADD, 8 },
+    { "sub.h", sub_h, SUB, 2 },
+    { "uqadd.b", uqadd_b, UQADD, 1 },
+    { "uqsub.h", uqsub_h, UQSUB, 2 },
+    { "sqadd.s", sqadd_s, SQADD, 4 },
+    { "and.d", and_d, AND, 8 },
+    { "orr.d", orr_d, ORR, 8 },
+    { "eor.d", eor_d, EOR, 8 },
+    { "bic.d", bic_d, BIC, 8 },
+    { "lsl.h", lsl_h, LSL, 2 },
+    { "lsr.s", lsr_s, LSR, 4 },
+    { "asr.d", asr_d, ASR, 8 },
+    { "mov.b", ones_b, ONES, 1 },
+};
+
+static uint64_t get_elem(const uint8_t *buf, int esize, int i)
+{
+    uint64_t val = 0;
+
+    memcpy(&val, buf + i * esize, esize);
+    return val;
+}
+
+static int64_t sext(uint64_t val, int esize)
+{
+    int shift = 64 - esize * 8;
+
+    return (int64_t)(val << shift) >> shift;
+}
+
+static uint64_t expected(int op, int esize, uint64_t x, uint64_t y)
+{
+    uint64_t mask = esize == 8 ? UINT64_MAX : (1ull << (esize * 8)) - 1;
+    int64_t smax = mask >> 1, smin = -smax - 1;
+    int64_t s;
+
+    switch (op) {
+    case ADD:
+        return (x + y) & mask;
+    case SUB:
+        return (x - y) & mask;
+    case UQADD:
+        return x + y > mask ? mask : x + y;
+    case UQSUB:
+        return x < y ? 0 : x - y;
+    case SQADD:
+        s = sext(x, esize) + sext(y, esize);
+        s = s > smax ? smax : s < smin ? smin : s;
+        return s & mask;
+    case AND:
+        return x & y;
+    case ORR:
+        return x | y;
+    case EOR:
+        return x ^ y;
+    case BIC:
+        return x & ~y;
+    case LSL:
+        return (x << 3) & mask;
+    case LSR:
+        return x >> 7;
+    case ASR:
+        return (sext(x, esize) >> 13) & mask;
+    case ONES:
+        return mask;
+    }
+    return 0;
+}
+
+static int test(int vl)
+{
+    int err = 0;
+
+    for (unsigned t = 0; t < ARRAY_SIZE(tests); t++) {
+        int esize = tests[t].esize;
+
+        memset(d, 0x5a, sizeof(d));
+        tests[t].fn();
+
+        for (int i = 0; i < vl / esize; i++) {
+            uint64_t x = get_elem(a, esize, i);
+            uint64_t y = get_elem(b, esize, i);
+            uint64_t want = expected(tests[t].op, esize, x, y);
+            uint64_t got = get_elem(d, esize, i);
+
+            if (got != want) {
+                fprintf(stderr, "vl %d, %s, element %d: "
+                        "expected 0x%llx, got 0x%llx\n",
+                        vl, tests[t].name, i,
+                        (unsigned long long)want, (unsigned long long)got);
+                err = 1;
+            }
+        }
+        for (int i = vl; i < MAX_VL; i++) {
+            if (d[i] != 0x5a) {
+                fprintf(stderr, "vl %d, %s, byte %d written past the "
+                        "vector\n", vl, tests[t].name, i);
+                err = 1;
+                break;
+            }
+        }
+    }
+    return err;
+}
+
+int main()
+{
+    int err = 0;
+
+    for (int i = 0; i < MAX_VL; i++) {
+        a[i] = i * 37 + 11;
+        b[i] = (i & 1 ? 0x80 : 0) | (i * 13);
+    }
+
+    for (int i = 16; i <= MAX_VL; i += 16) {
+        if (prctl(PR_SVE_SET_VL, i, 0, 0, 0, 0) == i) {
+            err |= test(i);
+        }
+    }
+    return err;
+}
@@ -27,18 +27,33 @@ static void ptimer_test_expire_qemu_timers(int64_t expire_time,
                                            QEMUClockType type)
 {
     QEMUTimerList *timer_list = main_loop_tlg.tl[type];
-    QEMUTimer *t = timer_list->active_timers.next;
+    g_autoptr(GPtrArray) expired = g_ptr_array_new();
+
+    if (!timer_list->active_timers) {
+        return;
+    }
+
+    /* The callbacks may modify the timers, so collect them first */
+    for (guint i = 0; i < timer_list->active_timers->len; i++) {
+        QEMUTimer *t = g_ptr_array_index(timer_list->active_timers, i);
 
-    while (t != NULL) {
         if (t->expire_time == expire_time) {
-            timer_del(t);
+            g_ptr_array_add(expired, t);
+        }
+    }
+
+    for (guint i = 0; i < expired->len; i++) {
+        QEMUTimer *t = g_ptr_array_index(expired, i);
 
-            if (t->cb != NULL) {
-                t->cb(t->opaque);
-            }
+        if (!g_ptr_array_find(timer_list->active_timers, t, NULL) ||
+            t->expire_time != expire_time) {
+            continue;
         }
+        timer_del(t);
 
-        t = t->next;
+        if (t->cb != NULL) {
+            t->cb(t->opaque);
+        }
     }
 }
 
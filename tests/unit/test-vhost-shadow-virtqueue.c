@@ -0,0 +1,242 @@
+/*
+ * Packed vring of the vhost shadow virtqueue
+ *
+ * The test plays the device role on the shadow vring: it checks the
+ * descriptors the SVQ exposes, returns them as used and checks the event
+ * suppression the SVQ honours when kicking the device.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "hw/virtio/vhost-shadow-virtqueue.h"
+
+#define TEST_IOVA 0x100000
+
+#define F_AVAIL (1 << VRING_PACKED_DESC_F_AVAIL)
+#define F_USED (1 << VRING_PACKED_DESC_F_USED)
+
+typedef struct TestSVQ {
+    VirtIODevice vdev;
+    DMAMap map;
+    VhostShadowVirtqueue *svq;
+
+    /* Device side used position and wrap counter */
+    uint16_t used_idx;
+    bool used_wrap;
+} TestSVQ;
+
+static uint8_t buf[4096];
+static uint8_t fake_vq;
+
+static TestSVQ *test_svq_new(void)
+{
+    TestSVQ *t = g_new0(TestSVQ, 1);
+
+    t->vdev.guest_features = BIT_ULL(VIRTIO_F_VERSION_1) |
+                             BIT_ULL(VIRTIO_F_RING_PACKED);
+    t->map = (DMAMap) {
+        .iova = TEST_IOVA,
+        .translated_addr = (hwaddr)(uintptr_t)buf,
+        .size = sizeof(buf) - 1,
+        .perm = IOMMU_RW,
+    };
+    t->used_wrap = true;
+
+    t->svq = vhost_svq_new(NULL, NULL);
+    g_assert_cmpint(event_notifier_init(&t->svq->hdev_kick, false), ==, 0);
+    g_assert_cmpint(event_notifier_init(&t->svq->hdev_call, false), ==, 0);
+    vhost_svq_start(t->svq, &t->vdev, (VirtQueue *)&fake_vq,
+                    (VhostIOVATree *)&t->map);
+    return t;
+}
+
+static void test_svq_free(TestSVQ *t)
+{
+    vhost_svq_stop(t->svq);
+    event_notifier_cleanup(&t->svq->hdev_kick);
+    event_notifier_cleanup(&t->svq->hdev_call);
+    vhost_svq_free(t->svq);
+    g_free(t);
+}
+
+/*
+ * Make available a buffer of @out_num device readable and @in_num device
+ * writable descriptors.  Descriptor n is 16 * (n + 1) bytes at buf + n * 64.
+ *
+ * Returns the ring position of the head descriptor.
+ */
+static uint16_t test_svq_add(TestSVQ *t, size_t out_num, size_t in_num)
+{
+    struct iovec iov[4];
+    uint16_t head = t->svq->shadow_avail_idx;
+    int r;
+
+    g_assert(out_num + in_num <= ARRAY_SIZE(iov));
+    for (size_t n = 0; n < out_num + in_num; n++) {
+        iov[n].iov_base = buf + n * 64;
+        iov[n].iov_len = 16 * (n + 1);
+    }
+
+    r = vhost_svq_add(t->svq, iov, out_num, NULL, iov + out_num, in_num, NULL,
+                      g_new0(VirtQueueElement, 1));
+    g_assert_cmpint(r, ==, 0);
+    return head;
+}
+
+static void test_svq_check_descs(TestSVQ *t, uint16_t head, size_t out_num,
+                                 size_t in_num, bool wrap)
+{
+    const struct vring_packed_desc *descs = t->svq->vring_packed.desc;
+    uint16_t id = le16_to_cpu(descs[head].id);
+    uint16_t i = head;
+
+    for (size_t n = 0; n < out_num + in_num; n++) {
+        uint16_t flags = wrap ? F_AVAIL : F_USED;
+
+        if (n >= out_num) {
+            flags |= VRING_DESC_F_WRITE;
+        }
+        if (n + 1 < out_num + in_num) {
+            flags |= VRING_DESC_F_NEXT;
+        }
+
+        g_assert_cmphex(le64_to_cpu(descs[i].addr), ==, TEST_IOVA + n * 64);
+        g_assert_cmpuint(le32_to_cpu(descs[i].len), ==, 16 * (n + 1));
+        g_assert_cmpuint(le16_to_cpu(descs[i].id), ==, id);
+        g_assert_cmphex(le16_to_cpu(descs[i].flags), ==, flags);
+
+        if (++i == t->svq->vring.num) {
+            i = 0;
+            wrap = !wrap;
+        }
+    }
+}
+
+/* Device side: mark the @ndescs buffer whose head is at @head as used */
+static void test_svq_use(TestSVQ *t, uint16_t head, uint16_t ndescs,
+                         uint32_t len)
+{
+    struct vring_packed_desc *descs = t->svq->vring_packed.desc;
+    struct vring_packed_desc *used = &descs[t->used_idx];
+    uint16_t id = le16_to_cpu(descs[head].id);
+
+    used->id = cpu_to_le16(id);
+    used->len = cpu_to_le32(len);
+    smp_wmb();
+    used->flags = cpu_to_le16(t->used_wrap ? F_AVAIL | F_USED : 0);
+
+    t->used_idx += ndescs;
+    if (t->used_idx >= t->svq->vring.num) {
+        t->used_idx -= t->svq->vring.num;
+        t->used_wrap = !t->used_wrap;
+    }
+}
+
+static void test_packed_add(void)
+{
+    TestSVQ *t = test_svq_new();
+    uint16_t num = t->svq->vring.num;
+    uint16_t head;
+
+    head = test_svq_add(t, 1, 2);
+    g_assert_cmpuint(head, ==, 0);
+    test_svq_check_descs(t, head, 1, 2, true);
+    g_assert_cmpuint(t->svq->shadow_avail_idx, ==, 3);
+    g_assert_cmpuint(vhost_svq_available_slots(t->svq), ==, num - 3);
+
+    /* The device event suppression area starts zeroed, so enabled */
+    g_assert_true(event_notifier_test_and_clear(&t->svq->hdev_kick));
+
+    test_svq_use(t, head, 3, 96);
+    g_assert_cmpuint(vhost_svq_poll(t->svq, 1), ==, 96);
+    g_assert_cmpuint(t->svq->last_used_idx, ==, 3);
+    g_assert_cmpuint(vhost_svq_available_slots(t->svq), ==, num);
+
+    test_svq_free(t);
+}
+
+static void test_packed_wrap(void)
+{
+    TestSVQ *t = test_svq_new();
+    uint16_t num = t->svq->vring.num;
+    bool wrap = true;
+
+    /* Chains of 3 descriptors wrap in the middle of a chain every 8 slots */
+    for (unsigned k = 0; k < 2 * num; k++) {
+        uint16_t head = test_svq_add(t, 1, 2);
+
+        g_assert_cmpuint(head, ==, (3 * k) % num);
+        test_svq_check_descs(t, head, 1, 2, wrap);
+        if (head + 3 >= num) {
+            wrap = !wrap;
+        }
+        g_assert_cmpint(t->svq->avail_wrap_counter, ==, wrap);
+
+        test_svq_use(t, head, 3, k);
+        g_assert_cmpuint(vhost_svq_poll(t->svq, 1), ==, k);
+        g_assert_cmpint(t->svq->used_wrap_counter, ==, wrap);
+        g_assert_cmpuint(t->svq->last_used_idx, ==, t->svq->shadow_avail_idx);
+        g_assert_cmpuint(vhost_svq_available_slots(t->svq), ==, num);
+    }
+
+    test_svq_free(t);
+}
+
+static void test_packed_kick(void)
+{
+    TestSVQ *t = test_svq_new();
+    struct vring_packed_desc_event *device = t->svq->vring_packed.device;
+    EventNotifier *kick = &t->svq->hdev_kick;
+    uint16_t num = t->svq->vring.num;
+
+    device->flags = cpu_to_le16(VRING_PACKED_EVENT_FLAG_DISABLE);
+    test_svq_add(t, 1, 0);
+    g_assert_false(event_notifier_test_and_clear(kick));
+
+    device->flags = cpu_to_le16(VRING_PACKED_EVENT_FLAG_ENABLE);
+    test_svq_add(t, 1, 0);
+    g_assert_true(event_notifier_test_and_clear(kick));
+
+    /* Kick only when descriptor 5 of the first lap is made available */
+    device->off_wrap = cpu_to_le16(5 | 1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+    device->flags = cpu_to_le16(VRING_PACKED_EVENT_FLAG_DESC);
+    for (uint16_t i = 2; i < num - 1; i++) {
+        test_svq_add(t, 1, 0);
+        g_assert_cmpint(event_notifier_test_and_clear(kick), ==, i == 5);
+    }
+
+    for (uint16_t i = 0; i < num - 1; i++) {
+        test_svq_use(t, i, 1, 0);
+    }
+    g_assert_cmpuint(vhost_svq_poll(t->svq, num - 1), ==, 0);
+
+    /*
+     * The last descriptor of the first lap flips the driver wrap counter, so
+     * the event index of the previous lap must still be honoured.
+     */
+    device->off_wrap = cpu_to_le16((num - 1) |
+                                   1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+    test_svq_add(t, 1, 0);
+    g_assert_false(t->svq->avail_wrap_counter);
+    g_assert_true(event_notifier_test_and_clear(kick));
+
+    /* Descriptor 1 of the second lap */
+    device->off_wrap = cpu_to_le16(1);
+    test_svq_add(t, 1, 0);
+    g_assert_false(event_notifier_test_and_clear(kick));
+    test_svq_add(t, 1, 0);
+    g_assert_true(event_notifier_test_and_clear(kick));
+
+    test_svq_free(t);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/vhost-shadow-virtqueue/packed/add", test_packed_add);
+    g_test_add_func("/vhost-shadow-virtqueue/packed/wrap", test_packed_wrap);
+    g_test_add_func("/vhost-shadow-virtqueue/packed/kick", test_packed_kick);
+
+    return g_test_run();
+}
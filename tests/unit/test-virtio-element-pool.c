@@ -0,0 +1,117 @@
+/*
+ * Virtqueue element pool
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "hw/virtio/virtio.h"
+
+#define TEST_MAX_SG 4
+
+typedef struct TestReq {
+    VirtQueueElement elem;
+    uint64_t data;
+} TestReq;
+
+static TestReq *test_alloc(VirtQueueElementPool *pool, size_t sz,
+                           unsigned int out_num, unsigned int in_num)
+{
+    TestReq *req = virtqueue_element_alloc(pool, sz, out_num, in_num);
+    VirtQueueElement *elem = &req->elem;
+
+    g_assert_cmpuint(elem->out_num, ==, out_num);
+    g_assert_cmpuint(elem->in_num, ==, in_num);
+
+    /* Touch everything, so that a short slot shows up under ASan */
+    memset((void *)req + sizeof(req->elem), 0xff, sz - sizeof(req->elem));
+    for (unsigned int i = 0; i < out_num; i++) {
+        elem->out_addr[i] = i;
+        elem->out_sg[i] = (struct iovec) { .iov_base = req, .iov_len = i };
+    }
+    for (unsigned int i = 0; i < in_num; i++) {
+        elem->in_addr[i] = i;
+        elem->in_sg[i] = (struct iovec) { .iov_base = req, .iov_len = i };
+    }
+    return req;
+}
+
+static void test_reuse(void)
+{
+    VirtQueueElementPool *pool =
+        virtqueue_element_pool_new(sizeof(TestReq), TEST_MAX_SG);
+    TestReq *a, *b, *c;
+
+    a = test_alloc(pool, sizeof(TestReq), 1, 1);
+    g_assert(a->elem.pool == pool);
+    b = test_alloc(pool, sizeof(TestReq), 2, 2);
+    g_assert(b->elem.pool == pool);
+    g_assert(a != b);
+
+    /* Freed elements are handed out again, whatever their shape */
+    virtqueue_element_free(b);
+    c = test_alloc(pool, sizeof(TestReq), 0, TEST_MAX_SG);
+    g_assert(c == b);
+    virtqueue_element_free(a);
+    virtqueue_element_free(c);
+    b = test_alloc(pool, sizeof(TestReq), TEST_MAX_SG, 0);
+    g_assert(b == a || b == c);
+
+    virtqueue_element_free(b);
+    virtqueue_element_pool_disable(pool);
+}
+
+static void test_oversized(void)
+{
+    VirtQueueElementPool *pool =
+        virtqueue_element_pool_new(sizeof(TestReq), TEST_MAX_SG);
+    TestReq *req;
+
+    /* Too many descriptors */
+    req = test_alloc(pool, sizeof(TestReq), TEST_MAX_SG, 1);
+    g_assert_null(req->elem.pool);
+    virtqueue_element_free(req);
+
+    /* A different request size */
+    req = test_alloc(pool, sizeof(TestReq) + 64, 1, 1);
+    g_assert_null(req->elem.pool);
+    virtqueue_element_free(req);
+
+    /* No pool at all */
+    req = test_alloc(NULL, sizeof(TestReq), 1, 1);
+    g_assert_null(req->elem.pool);
+    virtqueue_element_free(req);
+
+    virtqueue_element_pool_disable(pool);
+}
+
+static void test_free_after_disable(void)
+{
+    VirtQueueElementPool *pool =
+        virtqueue_element_pool_new(sizeof(TestReq), TEST_MAX_SG);
+    TestReq *a, *b, *c;
+
+    a = test_alloc(pool, sizeof(TestReq), 1, 1);
+    b = test_alloc(pool, sizeof(TestReq), 1, 1);
+    c = test_alloc(pool, sizeof(TestReq), 1, 1);
+    virtqueue_element_free(c);
+
+    /*
+     * The free element goes away now, the ones in use when they are
+     * freed, and the pool itself with the last of them.
+     */
+    virtqueue_element_pool_disable(pool);
+    virtqueue_element_free(a);
+    virtqueue_element_free(b);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/virtio/element-pool/reuse", test_reuse);
+    g_test_add_func("/virtio/element-pool/oversized", test_oversized);
+    g_test_add_func("/virtio/element-pool/free-after-disable",
+                    test_free_after_disable);
+
+    return g_test_run();
+}
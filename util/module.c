@@ -22,6 +22,7 @@
 #include "qemu/cutils.h"
 #include "qemu/config-file.h"
 #include "qapi/error.h"
+#include "qemu/startup-profile.h"
 #ifdef CONFIG_MODULE_UPGRADES
 #include "qemu-version.h"
 #endif
@@ -160,6 +161,7 @@ static bool module_load_dso(const char *fname, bool export_symbols,
     GModule *g_module;
     void (*sym)(void);
     ModuleEntry *e, *next;
+    int64_t start = startup_profile_begin();
     int flags;
 
     assert(QTAILQ_EMPTY(&dso_init_list));
@@ -192,6 +194,7 @@ static bool module_load_dso(const char *fname, bool export_symbols,
         register_module_init(e->init, e->type);
     }
     trace_module_load_module(fname);
+    startup_profile_end(start, "module", "%s", fname);
     QTAILQ_FOREACH_SAFE(e, &dso_init_list, node, next) {
         QTAILQ_REMOVE(&dso_init_list, e, node);
         g_free(e);
@@ -42,6 +42,7 @@
 #include "qemu/cutils.h"
 #include "qemu/units.h"
 #include "qemu/thread-context.h"
+#include "qemu/timer.h"
 #include "qemu/main-loop.h"
 
 #ifdef CONFIG_LINUX
@@ -73,6 +74,10 @@ typedef struct MemsetContext {
     bool any_thread_failed;
     struct MemsetThread *threads;
     int num_threads;
+    char *area;
+    size_t size;
+    /* When the threads were allowed to start touching pages */
+    int64_t start;
     QLIST_ENTRY(MemsetContext) next;
 } MemsetContext;
 
@@ -462,6 +467,7 @@ static inline int get_memset_num_threads(size_t hpagesize, size_t numpages,
 static int wait_and_free_mem_prealloc_context(MemsetContext *context)
 {
     int i, ret = 0, tmp;
+    int64_t ns;
 
     for (i = 0; i < context->num_threads; i++) {
         tmp = (uintptr_t)qemu_thread_join(&context->threads[i].pgthread);
@@ -470,6 +476,11 @@ static int wait_and_free_mem_prealloc_context(MemsetContext *context)
             ret = tmp;
         }
     }
+
+    ns = MAX(get_clock() - context->start, 1);
+    trace_qemu_prealloc_mem_done(context->area, context->size,
+                                 context->num_threads, ns / SCALE_MS,
+                                 (uint64_t)context->size * 1000 / ns);
     g_free(context->threads);
     g_free(context);
     return ret;
@@ -509,11 +520,16 @@ static int touch_all_pages(char *area, size_t hpagesize, size_t numpages,
          * preallocating synchronously.
          */
         if (context->num_threads == 1 && !async) {
+            int64_t start = get_clock(), ns;
+            size_t size = hpagesize * numpages;
+
             ret = 0;
-            if (qemu_madvise(area, hpagesize * numpages,
-                             QEMU_MADV_POPULATE_WRITE)) {
+            if (qemu_madvise(area, size, QEMU_MADV_POPULATE_WRITE)) {
                 ret = -errno;
             }
+            ns = MAX(get_clock() - start, 1);
+            trace_qemu_prealloc_mem_done(area, size, 1, ns / SCALE_MS,
+                                         (uint64_t)size * 1000 / ns);
             g_free(context);
             return ret;
         }
@@ -522,6 +538,8 @@ static int touch_all_pages(char *area, size_t hpagesize, size_t numpages,
         touch_fn = do_touch_pages;
     }
 
+    context->area = area;
+    context->size = hpagesize * numpages;
     context->threads = g_new0(MemsetThread, context->num_threads);
     numpages_per_thread = numpages / context->num_threads;
     leftover = numpages % context->num_threads;
@@ -559,6 +577,7 @@ static int touch_all_pages(char *area, size_t hpagesize, size_t numpages,
 
     qemu_mutex_lock(&page_mutex);
     context->all_threads_created = true;
+    context->start = get_clock();
     qemu_cond_broadcast(&page_cond);
     qemu_mutex_unlock(&page_mutex);
 
@@ -584,6 +603,7 @@ bool qemu_finish_async_prealloc_mem(Error **errp)
     qemu_mutex_lock(&page_mutex);
     QLIST_FOREACH(context, &memset_contexts, next) {
         context->all_threads_created = true;
+        context->start = get_clock();
     }
     qemu_cond_broadcast(&page_cond);
     qemu_mutex_unlock(&page_mutex);
@@ -54,6 +54,13 @@ static int rcu_call_count;
 static QemuMutex rcu_registry_lock;
 static QemuMutex rcu_sync_lock;
 
+/* Statistics for rcu_get_stats(), accessed with atomics.  */
+static int rcu_call_count_max;
+static int rcu_ready_count;
+static uint64_t rcu_callbacks_done;
+static uint64_t rcu_grace_periods;
+static uint64_t rcu_forced_grace_periods;
+
 /*
  * Check whether a quiescent state was crossed between the beginning of
  * update_counter_and_wait and now.
@@ -98,6 +105,7 @@ static void wait_for_readers(void)
             (qatomic_read(&rcu_call_count) >= RCU_CALL_MIN_SIZE ||
              sleeps >= 5 || qatomic_read(&in_drain_call_rcu))) {
             forced = true;
+            qatomic_inc(&rcu_forced_grace_periods);
 
             QLIST_FOREACH(index, &registry, node) {
                 notifier_list_notify(&index->force_rcu, NULL);
@@ -201,6 +209,7 @@ void synchronize_rcu(void)
 
         wait_for_readers();
     }
+    qatomic_inc(&rcu_grace_periods);
 }
 
 /* Multi-producer, single-consumer queue based on urcu/static/wfqueue.h
@@ -278,7 +287,17 @@ retry:
     return node;
 }
 
-static void *call_rcu_thread(void *opaque)
+/*
+ * Callbacks whose grace period has elapsed, in the order in which they
+ * were queued.  The list is handed from rcu_gp_thread to call_rcu_thread
+ * so that the next grace period can already be waited for while the
+ * callbacks of the previous one run.
+ */
+static QemuMutex rcu_ready_lock;
+static struct rcu_head *ready_head, **ready_tail = &ready_head;
+static QemuEvent rcu_ready_event;
+
+static void *rcu_gp_thread(void *opaque)
 {
     struct rcu_head *node;
 
@@ -298,44 +317,106 @@ static void *call_rcu_thread(void *opaque)
                 break;
             }
 
-#if defined(CONFIG_MALLOC_TRIM)
-            malloc_trim(4 * 1024 * 1024);
-#endif
             qemu_event_wait(&rcu_call_ready_event);
         }
 
         synchronize_rcu();
+
+        /*
+         * Move the callbacks to the ready list with rcu_ready_lock held, so
+         * that fork() does not see them half-way.
+         */
+        qemu_mutex_lock(&rcu_ready_lock);
         qatomic_sub(&rcu_call_count, n);
-        bql_lock();
+        qatomic_add(&rcu_ready_count, n);
         while (n > 0) {
             node = try_dequeue();
             while (!node) {
-                bql_unlock();
                 qemu_event_reset(&rcu_call_ready_event);
                 node = try_dequeue();
                 if (!node) {
                     qemu_event_wait(&rcu_call_ready_event);
                     node = try_dequeue();
                 }
-                bql_lock();
             }
 
+            /* try_dequeue() does not look at node->next anymore.  */
             n--;
+            qatomic_set(ready_tail, node);
+            ready_tail = &node->next;
+        }
+        *ready_tail = NULL;
+        qemu_mutex_unlock(&rcu_ready_lock);
+        qemu_event_set(&rcu_ready_event);
+    }
+    abort();
+}
+
+static void *call_rcu_thread(void *opaque)
+{
+    struct rcu_head *node, *batch;
+
+    rcu_register_thread();
+
+    for (;;) {
+        int n = 0;
+
+        for (;;) {
+            qemu_event_reset(&rcu_ready_event);
+            if (qatomic_read(&ready_head)) {
+                break;
+            }
+
+#if defined(CONFIG_MALLOC_TRIM)
+            malloc_trim(4 * 1024 * 1024);
+#endif
+            qemu_event_wait(&rcu_ready_event);
+        }
+
+        /* Take the list with BQL held, so that fork() does not lose it.  */
+        bql_lock();
+        WITH_QEMU_LOCK_GUARD(&rcu_ready_lock) {
+            batch = ready_head;
+            ready_head = NULL;
+            ready_tail = &ready_head;
+        }
+        while (batch) {
+            node = batch;
+            batch = node->next;
             node->func(node);
+            n++;
         }
         bql_unlock();
+
+        qatomic_sub(&rcu_ready_count, n);
+        qatomic_add(&rcu_callbacks_done, n);
     }
     abort();
 }
 
 void call_rcu1(struct rcu_head *node, void (*func)(struct rcu_head *node))
 {
+    int n;
+
     node->func = func;
     enqueue(node);
-    qatomic_inc(&rcu_call_count);
+    n = qatomic_fetch_inc(&rcu_call_count) + 1;
+    if (n > qatomic_read(&rcu_call_count_max)) {
+        qatomic_set(&rcu_call_count_max, n);
+    }
     qemu_event_set(&rcu_call_ready_event);
 }
 
+void rcu_get_stats(RCUStats *stats)
+{
+    stats->pending = qatomic_read(&rcu_call_count);
+    stats->pending_max = qatomic_read(&rcu_call_count_max);
+    stats->ready = qatomic_read(&rcu_ready_count);
+    stats->callbacks = qatomic_read(&rcu_callbacks_done);
+    stats->grace_periods = qatomic_read(&rcu_grace_periods);
+    stats->forced_grace_periods = qatomic_read(&rcu_forced_grace_periods);
+}
+
 
 struct rcu_drain {
     struct rcu_head rcu;
@@ -431,10 +512,16 @@ static void rcu_init_complete(void)
     qemu_event_init(&rcu_gp_event, true);
 
     qemu_event_init(&rcu_call_ready_event, false);
+    qemu_mutex_init(&rcu_ready_lock);
+    qemu_event_init(&rcu_ready_event, false);
 
     /* The caller is assumed to have BQL, so the call_rcu thread
      * must have been quiescent even after forking, just recreate it.
+     * The grace period thread only takes rcu_sync_lock and
+     * rcu_ready_lock, which are held across fork.
      */
+    qemu_thread_create(&thread, "rcu_gp", rcu_gp_thread,
+                       NULL, QEMU_THREAD_DETACHED);
     qemu_thread_create(&thread, "call_rcu", call_rcu_thread,
                        NULL, QEMU_THREAD_DETACHED);
 
@@ -462,6 +549,7 @@ static void rcu_init_lock(void)
 
     qemu_mutex_lock(&rcu_sync_lock);
     qemu_mutex_lock(&rcu_registry_lock);
+    qemu_mutex_lock(&rcu_ready_lock);
 }
 
 static void rcu_init_unlock(void)
@@ -470,6 +558,7 @@ static void rcu_init_unlock(void)
         return;
     }
 
+    qemu_mutex_unlock(&rcu_ready_lock);
     qemu_mutex_unlock(&rcu_registry_lock);
     qemu_mutex_unlock(&rcu_sync_lock);
 }
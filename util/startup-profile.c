@@ -0,0 +1,203 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Startup time profiling
+ *
+ * The system emulator records how long the parts of its startup take:
+ * machine init phases, QOM class_init, device realize, module loading,
+ * RAMBlock allocation, ROM loading and ACPI table generation.  Recording
+ * starts with startup_profile_init() at the beginning of qemu_init() and
+ * stops with startup_profile_finish() once the machine is ready; other
+ * programs never start it, and then the hooks cost a single load.
+ *
+ * A hook brackets the work it measures:
+ *
+ *   int64_t start = startup_profile_begin();
+ *   ...
+ *   startup_profile_end(start, "realize", "%s", object_get_typename(obj));
+ *
+ * The events can be retrieved with the query-startup-profile QMP command,
+ * and are written in Chrome trace event format to the file given with
+ * -startup-profile.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "qemu/startup-profile.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qobject/qdict.h"
+#include "qobject/qjson.h"
+#include "qobject/qlist.h"
+#include "qobject/qnum.h"
+
+static bool recording;
+static bool finished;
+static int64_t origin;
+static int64_t last_mark;
+static char *output;
+static QemuMutex lock;
+static GArray *events;
+
+void startup_profile_init(void)
+{
+    assert(!recording && !finished);
+    qemu_mutex_init(&lock);
+    events = g_array_new(false, false, sizeof(StartupProfileRecord));
+    origin = last_mark = get_clock();
+    qatomic_set(&recording, true);
+}
+
+void startup_profile_set_output(const char *filename)
+{
+    g_free(output);
+    output = g_strdup(filename);
+}
+
+/*
+ * Returns the start time to pass to startup_profile_end(), or 0 if
+ * nothing is being recorded.
+ */
+int64_t startup_profile_begin(void)
+{
+    if (!qatomic_read(&recording)) {
+        return 0;
+    }
+    return get_clock();
+}
+
+static void startup_profile_add(int64_t start, int64_t end,
+                                const char *category, char *name)
+{
+    StartupProfileRecord ev = {
+        .category = category,
+        .name = name,
+        .thread_id = qemu_get_thread_id(),
+        .start = start - origin,
+        .duration = end - start,
+    };
+
+    WITH_QEMU_LOCK_GUARD(&lock) {
+        if (!finished) {
+            g_array_append_val(events, ev);
+            return;
+        }
+    }
+    g_free(name);
+}
+
+void startup_profile_end(int64_t start, const char *category,
+                         const char *fmt, ...)
+{
+    int64_t end;
+    va_list ap;
+    char *name;
+
+    if (!start) {
+        return;
+    }
+    end = get_clock();
+
+    va_start(ap, fmt);
+    name = g_strdup_vprintf(fmt, ap);
+    va_end(ap);
+
+    startup_profile_add(start, end, category, name);
+}
+
+/*
+ * Record an event that covers the time since the previous mark, or since
+ * startup_profile_init() for the first one.  Used for the machine init
+ * phases, which follow each other.
+ */
+void startup_profile_mark(const char *category, const char *name)
+{
+    int64_t start, end;
+
+    if (!qatomic_read(&recording)) {
+        return;
+    }
+    end = get_clock();
+    start = last_mark;
+    last_mark = end;
+
+    startup_profile_add(start, end, category, g_strdup(name));
+}
+
+static void startup_profile_write_event(const StartupProfileRecord *ev,
+                                        void *opaque)
+{
+    QList *list = opaque;
+    QDict *dict = qdict_new();
+
+    qdict_put_str(dict, "name", ev->name);
+    qdict_put_str(dict, "cat", ev->category);
+    qdict_put_str(dict, "ph", "X");
+    /* Chrome trace timestamps are in microseconds */
+    qdict_put(dict, "ts", qnum_from_double(ev->start / 1000.0));
+    qdict_put(dict, "dur", qnum_from_double(ev->duration / 1000.0));
+    qdict_put_int(dict, "pid", getpid());
+    qdict_put_int(dict, "tid", ev->thread_id);
+    qlist_append(list, dict);
+}
+
+static void startup_profile_write(const char *filename)
+{
+    g_autoptr(GError) err = NULL;
+    g_autoptr(GString) json = NULL;
+    QDict *trace = qdict_new();
+    QList *list = qlist_new();
+
+    startup_profile_foreach(startup_profile_write_event, list);
+    qdict_put(trace, "traceEvents", list);
+    qdict_put_str(trace, "displayTimeUnit", "ms");
+
+    json = qobject_to_json_pretty(QOBJECT(trace), true);
+    qobject_unref(trace);
+
+    if (!g_file_set_contents(filename, json->str, json->len, &err)) {
+        error_report("failed to write startup profile: %s", err->message);
+    }
+}
+
+/*
+ * Stop recording.  The events recorded so far stay available to
+ * startup_profile_foreach().
+ */
+void startup_profile_finish(void)
+{
+    int64_t end;
+
+    if (!qatomic_read(&recording)) {
+        return;
+    }
+    end = get_clock();
+    startup_profile_add(origin, end, "startup", g_strdup("startup"));
+
+    qatomic_set(&recording, false);
+    WITH_QEMU_LOCK_GUARD(&lock) {
+        finished = true;
+    }
+
+    if (output) {
+        startup_profile_write(output);
+    }
+}
+
+bool startup_profile_finished(void)
+{
+    return finished;
+}
+
+void startup_profile_foreach(void (*fn)(const StartupProfileRecord *ev,
+                                        void *opaque),
+                             void *opaque)
+{
+    if (!events) {
+        return;
+    }
+
+    QEMU_LOCK_GUARD(&lock);
+    for (guint i = 0; i < events->len; i++) {
+        fn(&g_array_index(events, StartupProfileRecord, i), opaque);
+    }
+}
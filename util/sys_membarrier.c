@@ -7,6 +7,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/atomic.h"
 #include "qemu/sys_membarrier.h"
 #include "qemu/error-report.h"
 
@@ -19,6 +20,23 @@ membarrier(int cmd, int flags)
 {
     return syscall(__NR_membarrier, cmd, flags);
 }
+
+/*
+ * MEMBARRIER_CMD_SHARED waits for a scheduler grace period, which takes
+ * milliseconds.  The private expedited command only interrupts the CPUs
+ * that are running threads of this process, and is much faster.
+ */
+static int membarrier_cmd = MEMBARRIER_CMD_SHARED;
+
+#ifdef CONFIG_MEMBARRIER_PRIVATE_EXPEDITED
+static void membarrier_register_expedited(int supported)
+{
+    if ((supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+        membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0) {
+        qatomic_set(&membarrier_cmd, MEMBARRIER_CMD_PRIVATE_EXPEDITED);
+    }
+}
+#endif
 #endif
 
 void smp_mb_global(void)
@@ -26,7 +44,17 @@ void smp_mb_global(void)
 #if defined CONFIG_WIN32
     FlushProcessWriteBuffers();
 #elif defined CONFIG_LINUX
-    membarrier(MEMBARRIER_CMD_SHARED, 0);
+    int cmd = qatomic_read(&membarrier_cmd);
+
+    if (membarrier(cmd, 0) < 0) {
+        /*
+         * The registration for expedited barriers is not inherited across
+         * fork(); fall back to the shared command.
+         */
+        assert(cmd != MEMBARRIER_CMD_SHARED);
+        qatomic_set(&membarrier_cmd, MEMBARRIER_CMD_SHARED);
+        membarrier(MEMBARRIER_CMD_SHARED, 0);
+    }
 #else
 #error --enable-membarrier is not supported on this operating system.
 #endif
@@ -46,5 +74,8 @@ void smp_mb_global_init(void)
         error_report("Please upgrade your system to a newer version of Linux");
         exit(1);
     }
+#ifdef CONFIG_MEMBARRIER_PRIVATE_EXPEDITED
+    membarrier_register_expedited(ret);
+#endif
 #endif
 }
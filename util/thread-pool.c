@@ -26,7 +26,16 @@
 
 static void do_spawn_thread(ThreadPoolAio *pool);
 
+/*
+ * Requests are spread over several queues, each with its own lock, so that
+ * submitting a request and picking it up in a worker thread do not serialize
+ * on a single lock.  Each worker has a home queue but steals from the others
+ * when its own is empty.
+ */
+#define THREAD_POOL_NR_QUEUES   8
+
 typedef struct ThreadPoolElementAio ThreadPoolElementAio;
+typedef struct ThreadPoolQueue ThreadPoolQueue;
 
 enum ThreadState {
     THREAD_QUEUED,
@@ -37,12 +46,13 @@ enum ThreadState {
 struct ThreadPoolElementAio {
     BlockAIOCB common;
     ThreadPoolAio *pool;
+    ThreadPoolQueue *queue;
     ThreadPoolFunc *func;
     void *arg;
 
     /*
      * Accessed with atomics.  Moving state out of THREAD_QUEUED is
-     * protected by pool->lock and only the worker thread can move
+     * protected by queue->lock and only the worker thread can move
      * the state from THREAD_ACTIVE to THREAD_DONE.
      *
      * When state is THREAD_DONE, ret must have been written already.
@@ -51,13 +61,24 @@ struct ThreadPoolElementAio {
     enum ThreadState state;
     int ret;
 
-    /* Access to this list is protected by lock.  */
+    /* Access to this list is protected by queue->lock.  */
     QTAILQ_ENTRY(ThreadPoolElementAio) reqs;
 
+    /* Linked into pool->completed, then into pool->ready.  */
+    QSLIST_ENTRY(ThreadPoolElementAio) done;
+
     /* This list is only written by the thread pool's mother thread.  */
     QLIST_ENTRY(ThreadPoolElementAio) all;
 };
 
+struct ThreadPoolQueue {
+    QemuMutex lock;
+    QTAILQ_HEAD(, ThreadPoolElementAio) request_list;
+
+    /* Written under lock, read with atomics to skip empty queues.  */
+    int depth;
+};
+
 struct ThreadPoolAio {
     AioContext *ctx;
     QEMUBH *completion_bh;
@@ -66,64 +87,156 @@ struct ThreadPoolAio {
     QemuCond request_cond;
     QEMUBH *new_thread_bh;
 
+    ThreadPoolQueue queues[THREAD_POOL_NR_QUEUES];
+
+    /* Completed requests, pushed by the worker threads with atomics.  */
+    QSLIST_HEAD(, ThreadPoolElementAio) completed;
+
     /* The following variables are only accessed from one AioContext. */
     QLIST_HEAD(, ThreadPoolElementAio) head;
+    QSLIST_HEAD(, ThreadPoolElementAio) ready;
+    unsigned next_queue;
 
-    /* The following variables are protected by lock.  */
-    QTAILQ_HEAD(, ThreadPoolElementAio) request_list;
+    /*
+     * The following variables are protected by lock.  cur_threads,
+     * idle_threads and max_threads are also read without it, so they
+     * are written with atomics.
+     */
     int cur_threads;
     int idle_threads;
     int new_threads;     /* backlog of threads we need to create */
     int pending_threads; /* threads created but not running yet */
     int min_threads;
     int max_threads;
+    unsigned next_home;
 };
 
+/* Number of queues that requests are submitted to */
+static unsigned thread_pool_nr_queues(ThreadPoolAio *pool)
+{
+    return MAX(MIN(qatomic_read(&pool->max_threads), THREAD_POOL_NR_QUEUES),
+               1);
+}
+
+static bool thread_pool_has_work(ThreadPoolAio *pool)
+{
+    for (int i = 0; i < THREAD_POOL_NR_QUEUES; i++) {
+        if (qatomic_read(&pool->queues[i].depth)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Take the oldest request from the @home queue or, if it is empty, from
+ * another queue.
+ */
+static ThreadPoolElementAio *thread_pool_dequeue(ThreadPoolAio *pool,
+                                                 unsigned home)
+{
+    for (unsigned i = 0; i < THREAD_POOL_NR_QUEUES; i++) {
+        unsigned idx = (home + i) % THREAD_POOL_NR_QUEUES;
+        ThreadPoolQueue *queue = &pool->queues[idx];
+        ThreadPoolElementAio *req;
+
+        if (!qatomic_read(&queue->depth)) {
+            continue;
+        }
+
+        qemu_mutex_lock(&queue->lock);
+        req = QTAILQ_FIRST(&queue->request_list);
+        if (!req) {
+            qemu_mutex_unlock(&queue->lock);
+            continue;
+        }
+        QTAILQ_REMOVE(&queue->request_list, req, reqs);
+        qatomic_set(&queue->depth, queue->depth - 1);
+        qatomic_set(&req->state, THREAD_ACTIVE);
+        qemu_mutex_unlock(&queue->lock);
+
+        if (idx != home) {
+            trace_thread_pool_steal(pool, req, idx, home);
+        }
+        return req;
+    }
+    return NULL;
+}
+
+static void thread_pool_complete(ThreadPoolAio *pool,
+                                 ThreadPoolElementAio *req, int ret)
+{
+    qatomic_set(&req->ret, ret);
+    /* _release to write ret before state.  */
+    qatomic_store_release(&req->state, THREAD_DONE);
+
+    QSLIST_INSERT_HEAD_ATOMIC(&pool->completed, req, done);
+    qemu_bh_schedule(pool->completion_bh);
+}
+
 static void *worker_thread(void *opaque)
 {
     ThreadPoolAio *pool = opaque;
+    unsigned home;
 
     qemu_mutex_lock(&pool->lock);
     pool->pending_threads--;
+    home = pool->next_home++ % thread_pool_nr_queues(pool);
     do_spawn_thread(pool);
+    qemu_mutex_unlock(&pool->lock);
 
-    while (pool->cur_threads <= pool->max_threads) {
+    for (;;) {
         ThreadPoolElementAio *req;
-        int ret;
-
-        if (QTAILQ_EMPTY(&pool->request_list)) {
-            pool->idle_threads++;
-            ret = qemu_cond_timedwait(&pool->request_cond, &pool->lock, 10000);
-            pool->idle_threads--;
-            if (ret == 0 &&
-                QTAILQ_EMPTY(&pool->request_list) &&
-                pool->cur_threads > pool->min_threads) {
-                /* Timed out + no work to do + no need for warm threads = exit.  */
-                break;
+        bool timed_out = false;
+
+        req = thread_pool_dequeue(pool, home);
+        if (req) {
+            thread_pool_complete(pool, req, req->func(req->arg));
+            if (qatomic_read(&pool->cur_threads) <=
+                qatomic_read(&pool->max_threads)) {
+                continue;
             }
-            /*
-             * Even if there was some work to do, check if there aren't
-             * too many worker threads before picking it up.
-             */
+        }
+
+        qemu_mutex_lock(&pool->lock);
+        if (pool->cur_threads > pool->max_threads) {
+            break;
+        }
+        if (req) {
+            qemu_mutex_unlock(&pool->lock);
             continue;
         }
 
-        req = QTAILQ_FIRST(&pool->request_list);
-        QTAILQ_REMOVE(&pool->request_list, req, reqs);
-        qatomic_set(&req->state, THREAD_ACTIVE);
+        /*
+         * Pairs with the barrier in thread_pool_submit_aio(): either the
+         * submitter sees idle_threads != 0 and signals request_cond (which
+         * it can only do after we started waiting, since it needs the lock)
+         * or we see the new request here.
+         */
+        qatomic_set(&pool->idle_threads, pool->idle_threads + 1);
+        smp_mb();
+        if (!thread_pool_has_work(pool)) {
+            timed_out = !qemu_cond_timedwait(&pool->request_cond, &pool->lock,
+                                             10000);
+        }
+        qatomic_set(&pool->idle_threads, pool->idle_threads - 1);
+        if (timed_out &&
+            !thread_pool_has_work(pool) &&
+            pool->cur_threads > pool->min_threads) {
+            /* Timed out + no work to do + no need for warm threads = exit.  */
+            break;
+        }
+        /*
+         * Even if there was some work to do, check if there aren't
+         * too many worker threads before picking it up.
+         */
+        if (pool->cur_threads > pool->max_threads) {
+            break;
+        }
         qemu_mutex_unlock(&pool->lock);
-
-        ret = req->func(req->arg);
-
-        qatomic_set(&req->ret, ret);
-        /* _release to write ret before state.  */
-        qatomic_store_release(&req->state, THREAD_DONE);
-
-        qemu_bh_schedule(pool->completion_bh);
-        qemu_mutex_lock(&pool->lock);
     }
 
-    pool->cur_threads--;
+    qatomic_set(&pool->cur_threads, pool->cur_threads - 1);
     qemu_cond_signal(&pool->worker_stopped);
 
     /*
@@ -161,7 +274,7 @@ static void spawn_thread_bh_fn(void *opaque)
 
 static void spawn_thread(ThreadPoolAio *pool)
 {
-    pool->cur_threads++;
+    qatomic_set(&pool->cur_threads, pool->cur_threads + 1);
     pool->new_threads++;
     /* If there are threads being created, they will spawn new workers, so
      * we don't spend time creating many threads in a loop holding a mutex or
@@ -178,19 +291,36 @@ static void spawn_thread(ThreadPoolAio *pool)
 static void thread_pool_completion_bh(void *opaque)
 {
     ThreadPoolAio *pool = opaque;
-    ThreadPoolElementAio *elem, *next;
+    ThreadPoolElementAio *elem;
 
     defer_call_begin(); /* cb() may use defer_call() to coalesce work */
 
-restart:
-    QLIST_FOREACH_SAFE(elem, &pool->head, all, next) {
-        /* _acquire to read state before ret.  */
-        if (qatomic_load_acquire(&elem->state) != THREAD_DONE) {
+    for (;;) {
+        elem = QSLIST_FIRST(&pool->ready);
+        if (!elem) {
+            QSLIST_HEAD(, ThreadPoolElementAio) batch;
+            unsigned n = 0;
+
+            /* Reverse the batch, so that requests complete in order */
+            QSLIST_MOVE_ATOMIC(&batch, &pool->completed);
+            while ((elem = QSLIST_FIRST(&batch))) {
+                QSLIST_REMOVE_HEAD(&batch, done);
+                QSLIST_INSERT_HEAD(&pool->ready, elem, done);
+                n++;
+            }
+            if (!n) {
+                break;
+            }
+            trace_thread_pool_complete_batch(pool, n);
             continue;
         }
 
+        /* _acquire to read state before ret.  */
+        assert(qatomic_load_acquire(&elem->state) == THREAD_DONE);
+
         trace_thread_pool_complete_aio(pool, elem, elem->common.opaque,
                                        elem->ret);
+        QSLIST_REMOVE_HEAD(&pool->ready, done);
         QLIST_REMOVE(elem, all);
 
         if (elem->common.cb) {
@@ -202,16 +332,12 @@ restart:
             elem->common.cb(elem->common.opaque, elem->ret);
 
             /* We can safely cancel the completion_bh here regardless of someone
-             * else having scheduled it meanwhile because we reenter the
-             * completion function anyway (goto restart).
+             * else having scheduled it meanwhile because we look at
+             * pool->completed again before returning.
              */
             qemu_bh_cancel(pool->completion_bh);
-
-            qemu_aio_unref(elem);
-            goto restart;
-        } else {
-            qemu_aio_unref(elem);
         }
+        qemu_aio_unref(elem);
     }
 
     defer_call_end();
@@ -220,17 +346,15 @@ restart:
 static void thread_pool_cancel(BlockAIOCB *acb)
 {
     ThreadPoolElementAio *elem = (ThreadPoolElementAio *)acb;
-    ThreadPoolAio *pool = elem->pool;
+    ThreadPoolQueue *queue = elem->queue;
 
     trace_thread_pool_cancel_aio(elem, elem->common.opaque);
 
-    QEMU_LOCK_GUARD(&pool->lock);
+    QEMU_LOCK_GUARD(&queue->lock);
     if (qatomic_read(&elem->state) == THREAD_QUEUED) {
-        QTAILQ_REMOVE(&pool->request_list, elem, reqs);
-        qemu_bh_schedule(pool->completion_bh);
-
-        qatomic_set(&elem->ret, -ECANCELED);
-        qatomic_store_release(&elem->state, THREAD_DONE);
+        QTAILQ_REMOVE(&queue->request_list, elem, reqs);
+        qatomic_set(&queue->depth, queue->depth - 1);
+        thread_pool_complete(elem->pool, elem, -ECANCELED);
     }
 
 }
@@ -246,27 +370,45 @@ BlockAIOCB *thread_pool_submit_aio(ThreadPoolFunc *func, void *arg,
     ThreadPoolElementAio *req;
     AioContext *ctx = qemu_get_current_aio_context();
     ThreadPoolAio *pool = aio_get_thread_pool(ctx);
+    ThreadPoolQueue *queue;
+    unsigned idx;
+    int depth;
 
     /* Assert that the thread submitting work is the same running the pool */
     assert(pool->ctx == qemu_get_current_aio_context());
 
+    idx = pool->next_queue++ % thread_pool_nr_queues(pool);
+    queue = &pool->queues[idx];
+
     req = qemu_aio_get(&thread_pool_aiocb_info, NULL, cb, opaque);
     req->func = func;
     req->arg = arg;
     req->state = THREAD_QUEUED;
     req->pool = pool;
+    req->queue = queue;
 
     QLIST_INSERT_HEAD(&pool->head, req, all);
 
-    trace_thread_pool_submit_aio(pool, req, arg);
+    WITH_QEMU_LOCK_GUARD(&queue->lock) {
+        QTAILQ_INSERT_TAIL(&queue->request_list, req, reqs);
+        depth = queue->depth + 1;
+        qatomic_set(&queue->depth, depth);
+    }
 
-    qemu_mutex_lock(&pool->lock);
-    if (pool->idle_threads == 0 && pool->cur_threads < pool->max_threads) {
-        spawn_thread(pool);
+    trace_thread_pool_submit_aio(pool, req, arg, idx, depth);
+
+    /* Pairs with the barrier in worker_thread().  */
+    smp_mb();
+    if (qatomic_read(&pool->idle_threads)) {
+        QEMU_LOCK_GUARD(&pool->lock);
+        qemu_cond_signal(&pool->request_cond);
+    } else if (qatomic_read(&pool->cur_threads) <
+               qatomic_read(&pool->max_threads)) {
+        QEMU_LOCK_GUARD(&pool->lock);
+        if (pool->idle_threads == 0 && pool->cur_threads < pool->max_threads) {
+            spawn_thread(pool);
+        }
     }
-    QTAILQ_INSERT_TAIL(&pool->request_list, req, reqs);
-    qemu_mutex_unlock(&pool->lock);
-    qemu_cond_signal(&pool->request_cond);
     return &req->common;
 }
 
@@ -296,8 +438,8 @@ void thread_pool_update_params(ThreadPoolAio *pool, AioContext *ctx)
 {
     qemu_mutex_lock(&pool->lock);
 
-    pool->min_threads = ctx->thread_pool_min;
-    pool->max_threads = ctx->thread_pool_max;
+    qatomic_set(&pool->min_threads, ctx->thread_pool_min);
+    qatomic_set(&pool->max_threads, ctx->thread_pool_max);
 
     /*
      * We either have to:
@@ -333,8 +475,13 @@ static void thread_pool_init_one(ThreadPoolAio *pool, AioContext *ctx)
     qemu_cond_init(&pool->request_cond);
     pool->new_thread_bh = aio_bh_new(ctx, spawn_thread_bh_fn, pool);
 
+    for (int i = 0; i < THREAD_POOL_NR_QUEUES; i++) {
+        qemu_mutex_init(&pool->queues[i].lock);
+        QTAILQ_INIT(&pool->queues[i].request_list);
+    }
+    QSLIST_INIT(&pool->completed);
+    QSLIST_INIT(&pool->ready);
     QLIST_INIT(&pool->head);
-    QTAILQ_INIT(&pool->request_list);
 
     thread_pool_update_params(pool, ctx);
 }
@@ -358,11 +505,11 @@ void thread_pool_free_aio(ThreadPoolAio *pool)
 
     /* Stop new threads from spawning */
     qemu_bh_delete(pool->new_thread_bh);
-    pool->cur_threads -= pool->new_threads;
+    qatomic_set(&pool->cur_threads, pool->cur_threads - pool->new_threads);
     pool->new_threads = 0;
 
     /* Wait for worker threads to terminate */
-    pool->max_threads = 0;
+    qatomic_set(&pool->max_threads, 0);
     qemu_cond_broadcast(&pool->request_cond);
     while (pool->cur_threads > 0) {
         qemu_cond_wait(&pool->worker_stopped, &pool->lock);
@@ -371,6 +518,9 @@ void thread_pool_free_aio(ThreadPoolAio *pool)
     qemu_mutex_unlock(&pool->lock);
 
     qemu_bh_delete(pool->completion_bh);
+    for (int i = 0; i < THREAD_POOL_NR_QUEUES; i++) {
+        qemu_mutex_destroy(&pool->queues[i].lock);
+    }
     qemu_cond_destroy(&pool->request_cond);
     qemu_cond_destroy(&pool->worker_stopped);
     qemu_mutex_destroy(&pool->lock);
@@ -29,6 +29,15 @@
  * When virtqueues are set up libvhost-user calls set_watch() to monitor kick
  * fds. These fds are also handled in the VuServer->ctx AioContext.
  *
+ * Alternatively, vhost_user_server_set_queue_ctxs() can assign a list of
+ * AioContexts to the virtqueues (round-robin by queue index), so that each
+ * virtqueue is processed in its own thread. libvhost-user's device state is
+ * not thread-safe, so vhost-user messages must not be handled while virtqueues
+ * are processed: vu_message_read() only monitors the kick fds of such queues
+ * while it waits for the next message and removes the fd handlers again (from
+ * within each queue's AioContext) and waits for in-flight requests to complete
+ * before the message is processed.
+ *
  * Both vu_client_trip() and kick fd monitoring can be stopped by shutting down
  * the socket connection. Shutting down the socket connection causes
  * vu_message_read() to fail since no more data can be received from the socket.
@@ -93,14 +102,27 @@ static void panic_cb(VuDev *vu_dev, const char *buf)
 
 void vhost_user_server_inc_in_flight(VuServer *server)
 {
-    assert(!server->wait_idle);
+    assert(!qatomic_read(&server->wait_idle));
     qatomic_inc(&server->in_flight);
 }
 
 void vhost_user_server_dec_in_flight(VuServer *server)
 {
     if (qatomic_fetch_dec(&server->in_flight) == 1) {
-        if (server->wait_idle) {
+        if (!qatomic_read(&server->wait_idle)) {
+            return;
+        }
+        if (server->queue_ctxs) {
+            /*
+             * Requests complete in the queue threads.  Pairs with the barrier
+             * in vu_wait_idle(): either it sees in_flight == 0 or we see
+             * wait_idle, and idle_lock is held from setting wait_idle until
+             * the coroutine is queued.
+             */
+            qemu_mutex_lock(&server->idle_lock);
+            qemu_co_enter_all(&server->idle_queue, &server->idle_lock);
+            qemu_mutex_unlock(&server->idle_lock);
+        } else {
             aio_co_wake(server->co_trip);
         }
     }
@@ -111,6 +133,85 @@ bool vhost_user_server_has_in_flight(VuServer *server)
     return qatomic_load_acquire(&server->in_flight) > 0;
 }
 
+static void coroutine_fn vu_wait_idle(VuServer *server)
+{
+    if (server->queue_ctxs) {
+        qemu_mutex_lock(&server->idle_lock);
+        qatomic_set(&server->wait_idle, true);
+        smp_mb();
+        while (vhost_user_server_has_in_flight(server)) {
+            qemu_co_queue_wait(&server->idle_queue, &server->idle_lock);
+        }
+        qatomic_set(&server->wait_idle, false);
+        qemu_mutex_unlock(&server->idle_lock);
+    } else if (vhost_user_server_has_in_flight(server)) {
+        server->wait_idle = true;
+        qemu_coroutine_yield();
+        server->wait_idle = false;
+    }
+    assert(!vhost_user_server_has_in_flight(server));
+}
+
+static void kick_handler(void *opaque);
+
+/*
+ * Start monitoring the kick fds of virtqueues with their own AioContext.
+ * Called again after each yield in vu_message_read(), where it only has
+ * work to do if vhost_user_server_detach_aio_context() stopped the queues.
+ */
+static void vu_queues_resume(VuServer *server)
+{
+    VuFdWatch *vu_fd_watch;
+
+    if (!server->queue_ctxs || !server->ctx || server->queues_running) {
+        return;
+    }
+    server->queues_running = true;
+
+    QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+        if (vu_fd_watch->ctx) {
+            aio_set_fd_handler(vu_fd_watch->ctx, vu_fd_watch->fd, kick_handler,
+                               NULL, NULL, NULL, vu_fd_watch);
+        }
+    }
+}
+
+/*
+ * Stop virtqueue processing in the queue AioContexts so that the vhost-user
+ * message that is about to be handled can safely access the device state.
+ */
+static void coroutine_fn vu_queues_pause(VuServer *server)
+{
+    AioContext *home_ctx = qemu_get_current_aio_context();
+    VuFdWatch *vu_fd_watch;
+    size_t i;
+
+    if (!server->queue_ctxs) {
+        return;
+    }
+    server->queues_running = false;
+
+    /*
+     * Removing the fd handlers from within their AioContext guarantees that
+     * kick_handler() is not running concurrently anymore.
+     */
+    for (i = 0; i < server->num_queue_ctxs; i++) {
+        AioContext *ctx = server->queue_ctxs[i];
+
+        aio_co_reschedule_self(ctx);
+        QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
+            if (vu_fd_watch->ctx == ctx) {
+                aio_set_fd_handler(ctx, vu_fd_watch->fd,
+                                   NULL, NULL, NULL, NULL, NULL);
+            }
+        }
+    }
+    aio_co_reschedule_self(home_ctx);
+
+    /* Requests that are still in flight access the virtqueues on completion */
+    vu_wait_idle(server);
+}
+
 static bool coroutine_fn
 vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
 {
@@ -130,6 +231,7 @@ vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
     }
 
     assert(qemu_in_coroutine());
+    vu_queues_resume(server);
     do {
         size_t nfds = 0;
         int *fds = NULL;
@@ -146,6 +248,7 @@ vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
                     server->in_qio_channel_yield = true;
                     qio_channel_yield(ioc, G_IO_IN);
                     server->in_qio_channel_yield = false;
+                    vu_queues_resume(server);
                 } else {
                     return false;
                 }
@@ -178,6 +281,8 @@ vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
         read_bytes += rc;
     } while (read_bytes != VHOST_USER_HDR_SIZE);
 
+    vu_queues_pause(server);
+
     /* qio_channel_readv_full will make socket fds blocking, unblock them */
     if (!vmsg_unblock_fds(vmsg, &local_err)) {
         error_report_err(local_err);
@@ -208,6 +313,7 @@ vu_message_read(VuDev *vu_dev, int conn_fd, VhostUserMsg *vmsg)
     return true;
 
 fail:
+    vu_queues_pause(server);
     vmsg_close_fds(vmsg);
 
     return false;
@@ -230,13 +336,8 @@ static coroutine_fn void vu_client_trip(void *opaque)
         }
     }
 
-    if (vhost_user_server_has_in_flight(server)) {
-        /* Wait for requests to complete before we can unmap the memory */
-        server->wait_idle = true;
-        qemu_coroutine_yield();
-        server->wait_idle = false;
-    }
-    assert(!vhost_user_server_has_in_flight(server));
+    /* Wait for requests to complete before we can unmap the memory */
+    vu_wait_idle(server);
 
     vu_deinit(vu_dev);
 
@@ -278,6 +379,28 @@ static void kick_handler(void *opaque)
     }
 }
 
+static AioContext *vu_fd_watch_ctx(VuServer *server, VuFdWatch *vu_fd_watch)
+{
+    return vu_fd_watch->ctx ?: server->ctx;
+}
+
+/* Returns the AioContext of the virtqueue with kick fd @fd, if any */
+static AioContext *vu_queue_ctx(VuServer *server, int fd)
+{
+    int i;
+
+    if (!server->queue_ctxs) {
+        return NULL;
+    }
+
+    for (i = 0; i < server->vu_dev.max_queues; i++) {
+        if (server->vu_dev.vq[i].kick_fd == fd) {
+            return server->queue_ctxs[i % server->num_queue_ctxs];
+        }
+    }
+    return NULL;
+}
+
 static VuFdWatch *find_vu_fd_watch(VuServer *server, int fd)
 {
 
@@ -309,10 +432,14 @@ set_watch(VuDev *vu_dev, int fd, int vu_evt,
 
         vu_fd_watch->fd = fd;
         vu_fd_watch->cb = cb;
+        vu_fd_watch->ctx = vu_queue_ctx(server, fd);
         /* TODO: handle error more gracefully than aborting */
         qemu_set_blocking(fd, false, &error_abort);
-        aio_set_fd_handler(server->ctx, fd, kick_handler,
-                           NULL, NULL, NULL, vu_fd_watch);
+        /* Queues with their own AioContext are started by vu_queues_resume() */
+        if (!vu_fd_watch->ctx) {
+            aio_set_fd_handler(server->ctx, fd, kick_handler,
+                               NULL, NULL, NULL, vu_fd_watch);
+        }
         vu_fd_watch->vu_dev = vu_dev;
         vu_fd_watch->pvt = pvt;
     }
@@ -332,7 +459,8 @@ static void remove_watch(VuDev *vu_dev, int fd)
     if (!vu_fd_watch) {
         return;
     }
-    aio_set_fd_handler(server->ctx, fd, NULL, NULL, NULL, NULL, NULL);
+    aio_set_fd_handler(vu_fd_watch_ctx(server, vu_fd_watch), fd,
+                       NULL, NULL, NULL, NULL, NULL);
 
     QTAILQ_REMOVE(&server->vu_fd_watches, vu_fd_watch, next);
     g_free(vu_fd_watch);
@@ -397,7 +525,8 @@ void vhost_user_server_stop(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd,
+            aio_set_fd_handler(vu_fd_watch_ctx(server, vu_fd_watch),
+                               vu_fd_watch->fd,
                                NULL, NULL, NULL, NULL, vu_fd_watch);
         }
 
@@ -406,6 +535,13 @@ void vhost_user_server_stop(VuServer *server)
         AIO_WAIT_WHILE(server->ctx, server->co_trip);
     }
 
+    if (server->queue_ctxs) {
+        g_free(server->queue_ctxs);
+        server->queue_ctxs = NULL;
+        server->num_queue_ctxs = 0;
+        qemu_mutex_destroy(&server->idle_lock);
+    }
+
     if (server->listener) {
         qio_net_listener_disconnect(server->listener);
         object_unref(OBJECT(server->listener));
@@ -436,8 +572,11 @@ void vhost_user_server_attach_aio_context(VuServer *server, AioContext *ctx)
     }
 
     QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-        aio_set_fd_handler(ctx, vu_fd_watch->fd, kick_handler, NULL,
-                           NULL, NULL, vu_fd_watch);
+        /* Queues with their own AioContext are started by vu_queues_resume() */
+        if (!vu_fd_watch->ctx) {
+            aio_set_fd_handler(ctx, vu_fd_watch->fd, kick_handler, NULL,
+                               NULL, NULL, vu_fd_watch);
+        }
     }
 
     if (server->co_trip) {
@@ -468,9 +607,11 @@ void vhost_user_server_detach_aio_context(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd,
+            aio_set_fd_handler(vu_fd_watch_ctx(server, vu_fd_watch),
+                               vu_fd_watch->fd,
                                NULL, NULL, NULL, NULL, vu_fd_watch);
         }
+        server->queues_running = false;
     }
 
     server->ctx = NULL;
@@ -527,3 +668,19 @@ bool vhost_user_server_start(VuServer *server,
     QTAILQ_INIT(&server->vu_fd_watches);
     return true;
 }
+
+/*
+ * Process virtqueue i in ctxs[i % count] instead of the server's AioContext.
+ * Must be called after vhost_user_server_start() and before a client connects.
+ */
+void vhost_user_server_set_queue_ctxs(VuServer *server,
+                                      AioContext *const *ctxs, size_t count)
+{
+    assert(count > 0);
+    assert(!server->sioc && !server->queue_ctxs);
+
+    server->queue_ctxs = g_memdup2(ctxs, count * sizeof(ctxs[0]));
+    server->num_queue_ctxs = count;
+    qemu_mutex_init(&server->idle_lock);
+    qemu_co_queue_init(&server->idle_queue);
+}